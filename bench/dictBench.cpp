@@ -0,0 +1,85 @@
+// Dict vs std::map on the keyspace's access pattern: insert N keys in random order, look each up once,
+// and track the slowest single insert (what a resize costs one unlucky client).
+//
+//   g++ -std=c++20 -O2 -Iinclude bench/dictBench.cpp -o dictBench
+//   ./dictBench 1000000 10000000 50000000
+#include "dict.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start){
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Result {
+  double insert;
+  double lookup;
+  double worstInsertUs;
+};
+
+template <typename Insert, typename Lookup>
+static Result run(const std::vector<std::string>& keys, const std::vector<uint32_t>& insertOrder,
+                  const std::vector<uint32_t>& order, Insert insert, Lookup lookup){
+  Result r{};
+  auto start = Clock::now();
+  for (uint32_t i : insertOrder){
+    auto t = Clock::now();
+    insert(keys[i], i);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - t).count();
+    if (us > r.worstInsertUs) r.worstInsertUs = us;
+  }
+  r.insert = seconds_since(start);
+
+  start = Clock::now();
+  uint64_t sum = 0;
+  for (uint32_t i : order) sum += lookup(keys[i]);
+  r.lookup = seconds_since(start);
+  if (sum == 42) std::puts(""); // keep the lookups alive
+  return r;
+}
+
+static void print(const char* name, size_t n, const Result& r){
+  std::printf("%-8s %10zu keys  insert %6.0f ns/op  lookup %6.0f ns/op  worst insert %8.0f us\n",
+              name, n, r.insert * 1e9 / n, r.lookup * 1e9 / n, r.worstInsertUs);
+}
+
+int main(int argc, char** argv){
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; i++) sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+  if (sizes.empty()) sizes = {1000000, 10000000, 50000000};
+
+  for (size_t n : sizes){
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; i++) keys.push_back("key:" + std::to_string(i));
+    std::vector<uint32_t> insertOrder(n);
+    for (size_t i = 0; i < n; i++) insertOrder[i] = i;
+    std::vector<uint32_t> order = insertOrder;
+    std::shuffle(insertOrder.begin(), insertOrder.end(), std::mt19937(7));
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    {
+      Dict<uint64_t> dict;
+      Result r = run(keys, insertOrder, order,
+        [&](const std::string& k, uint64_t v){ dict.insert_or_assign(k, v); },
+        [&](const std::string& k){ return *dict.find(k); });
+      print("Dict", n, r);
+    }
+    {
+      std::map<std::string, uint64_t, std::less<>> map;
+      Result r = run(keys, insertOrder, order,
+        [&](const std::string& k, uint64_t v){ map.insert_or_assign(k, v); },
+        [&](const std::string& k){ return map.find(k)->second; });
+      print("std::map", n, r);
+    }
+  }
+}
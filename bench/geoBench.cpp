@@ -0,0 +1,149 @@
+// GEOSEARCH's candidate filter: N geohash scores scattered over a few degrees, tested
+// against a circle and a box the way geo_search feeds them (blocks of 256), with each
+// kernel the CPU runs, next to the one-at-a-time decode + libm haversine it replaced.
+// "differ" counts candidates a kernel decides differently from that reference, or whose
+// distance (geo_distance on the decoded cell, as geo_search replies it) is more than a
+// micrometer off. The "member" run is centered on a candidate's own cell, like
+// FROMMEMBER: that candidate must come out exactly 0 m away.
+//
+//   g++ -std=c++20 -O2 -Iinclude bench/geoBench.cpp src/geoDistance.cpp -o geoBench
+//   ./geoBench 1000000
+#include "geoDistance.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start){
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static uint64_t spread(uint32_t v){
+  uint64_t r = v;
+  r = (r | (r << 16)) & 0x0000FFFF0000FFFF;
+  r = (r | (r << 8)) & 0x00FF00FF00FF00FF;
+  r = (r | (r << 4)) & 0x0F0F0F0F0F0F0F0F;
+  r = (r | (r << 2)) & 0x3333333333333333;
+  r = (r | (r << 1)) & 0x5555555555555555;
+  return r;
+}
+
+static uint32_t compact(uint64_t v){
+  v &= 0x5555555555555555;
+  v = (v | (v >> 1)) & 0x3333333333333333;
+  v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0F;
+  v = (v | (v >> 4)) & 0x00FF00FF00FF00FF;
+  v = (v | (v >> 8)) & 0x0000FFFF0000FFFF;
+  v = (v | (v >> 16)) & 0x00000000FFFFFFFF;
+  return static_cast<uint32_t>(v);
+}
+
+static double encode(double lat, double lon){
+  uint32_t la = static_cast<uint32_t>((1 << 26) * (lat - MIN_LATITUDE) / LATITUDE_RANGE);
+  uint32_t lo = static_cast<uint32_t>((1 << 26) * (lon - MIN_LONGITUDE) / LONGITUDE_RANGE);
+  return static_cast<double>(spread(la) | (spread(lo) << 1));
+}
+
+// The cell's center, the way decodeCoords works it out
+static void decode(double score, double& lat, double& lon){
+  constexpr double CELLS = 1 << 26;
+  uint64_t bits = static_cast<uint64_t>(score);
+  uint32_t la = compact(bits), lo = compact(bits >> 1);
+  lat = (MIN_LATITUDE + LATITUDE_RANGE * (la / CELLS) + MIN_LATITUDE + LATITUDE_RANGE * ((la + 1) / CELLS)) / 2;
+  lon = (MIN_LONGITUDE + LONGITUDE_RANGE * (lo / CELLS) + MIN_LONGITUDE + LONGITUDE_RANGE * ((lo + 1) / CELLS)) / 2;
+}
+
+// What geo_search did per member before geo_filter. Sets meters for a match
+static bool reference(const GeoShape& shape, double score, double& meters){
+  constexpr double RAD = M_PI / 180;
+  double lat, lon;
+  decode(score, lat, lon);
+  auto distance = [&](double lon1, double lat1, double lon2, double lat2){
+    double u = std::sin((lat2 - lat1) * RAD / 2), v = std::sin((lon2 - lon1) * RAD / 2);
+    return 2 * EARTH_RADIUS * std::asin(std::sqrt(u * u + std::cos(lat1 * RAD) * std::cos(lat2 * RAD) * v * v));
+  };
+  meters = distance(shape.lon, shape.lat, lon, lat);
+  if (!shape.box) return meters <= shape.radius;
+  if (EARTH_RADIUS * std::fabs(lat - shape.lat) * RAD > shape.height / 2) return false;
+  return distance(shape.lon, lat, lon, lat) <= shape.width / 2;
+}
+
+// Returns whether every kernel agreed with the reference; self is the candidate the
+// shape is centered on, if any
+static bool run(const char* label, const GeoShape& shape, const std::vector<double>& scores, size_t self = SIZE_MAX){
+  constexpr size_t BLOCK = 256;
+  std::vector<char> expected(scores.size());
+  std::vector<double> meters(scores.size());
+  Clock::time_point start = Clock::now();
+  size_t found = 0;
+  for (size_t i = 0; i < scores.size(); i++) found += expected[i] = reference(shape, scores[i], meters[i]);
+  double base = seconds_since(start);
+  std::printf("%-7s %-10s %7.1f ns/candidate  %zu matches\n", label, "libm", base * 1e9 / scores.size(), found);
+
+  GeoFilter filter = geo_prepare(shape);
+  uint32_t matched[BLOCK];
+  bool agreed = true;
+  for (const char* kernel : {"scalar", "avx2", "avx512"}) {
+    if (!geo_use_kernel(kernel)) continue;
+    std::vector<char> got(scores.size());
+    std::vector<double> gotMeters(scores.size());
+    start = Clock::now();
+    for (size_t i = 0; i < scores.size(); i += BLOCK) {
+      size_t n = std::min(BLOCK, scores.size() - i);
+      size_t k = geo_filter(filter, scores.data() + i, n, matched);
+      for (size_t j = 0; j < k; j++) {
+        double lat, lon;
+        decode(scores[i + matched[j]], lat, lon);
+        got[i + matched[j]] = 1;
+        gotMeters[i + matched[j]] = geo_distance(shape.lon, shape.lat, lon, lat);
+      }
+    }
+    double took = seconds_since(start);
+    size_t differ = 0, count = 0;
+    for (size_t i = 0; i < scores.size(); i++) {
+      differ += got[i] != expected[i] || (got[i] && std::fabs(gotMeters[i] - meters[i]) > 1e-6);
+      count += got[i];
+    }
+    std::printf("%-7s %-10s %7.1f ns/candidate  %zu matches, %zu differ, x%.1f", label, kernel,
+                took * 1e9 / scores.size(), count, differ, base / took);
+    if (self != SIZE_MAX) {
+      std::printf(", %g m from itself", gotMeters[self]);
+      if (!got[self] || gotMeters[self] != 0) differ++;
+    }
+    std::printf("\n");
+    agreed = agreed && !differ;
+  }
+  return agreed;
+}
+
+int main(int argc, char** argv){
+  size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  // Around Palermo, spread over the 9 cells a 100 km search would cover
+  std::mt19937_64 rng(7);
+  std::uniform_real_distribution<double> lat(36.5, 39.7), lon(11.3, 15.4);
+  std::vector<double> scores(n);
+  for (double& score : scores) score = encode(lat(rng), lon(rng));
+
+  GeoShape circle;
+  circle.lon = 13.361389;
+  circle.lat = 38.115556;
+  circle.radius = 100000;
+  GeoShape box = circle;
+  box.box = true;
+  box.width = 200000;
+  box.height = 120000;
+  // FROMMEMBER: the center is a member's decoded position
+  GeoShape member = box;
+  decode(scores[0], member.lat, member.lon);
+  bool agreed = run("radius", circle, scores);
+  agreed = run("box", box, scores) && agreed;
+  agreed = run("member", member, scores, 0) && agreed;
+  return agreed ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+// Slab allocator vs malloc on the server's small-object patterns. Each run is its own process so the
+// RSS numbers don't mix: "set" keeps N live strings of 16-128 bytes and replaces random ones (SET
+// churn), "zset" builds N 48-80 byte nodes, drops a random half and refills (ZADD/ZREM churn).
+//
+//   g++ -std=c++20 -O2 -Iinclude bench/slabBench.cpp src/slab.cpp -o slabBench -pthread
+//   ./slabBench slab set 1000000 20000000 4
+//   ./slabBench malloc set 1000000 20000000 4
+#include "slab.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static bool useSlab = true;
+
+static void* allocate(size_t size){
+  if (useSlab){
+    if (void* p = slab_alloc(size)) return p;
+  }
+  return std::malloc(size);
+}
+
+static void release(void* p){
+  if (useSlab && slab_free(p)) return;
+  std::free(p);
+}
+
+static size_t resident_bytes(){
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void touch(void* p, size_t size){ std::memset(p, 0x5a, size < 16 ? size : 16); }
+
+// Keep `live` objects, replace one at random `ops` times
+static void set_churn(size_t live, size_t ops, uint32_t seed){
+  std::mt19937 rng(seed);
+  std::vector<void*> objects(live);
+  for (auto& p : objects){
+    size_t size = 16 + rng() % 113;
+    p = allocate(size);
+    touch(p, size);
+  }
+  for (size_t i = 0; i < ops; i++){
+    size_t at = rng() % live;
+    release(objects[at]);
+    size_t size = 16 + rng() % 113;
+    objects[at] = allocate(size);
+    touch(objects[at], size);
+  }
+  for (void* p : objects) release(p);
+}
+
+// Build `live` nodes, then rounds of removing a random half and adding it back until `ops` frees
+static void zset_churn(size_t live, size_t ops, uint32_t seed){
+  std::mt19937 rng(seed);
+  std::vector<void*> objects(live);
+  for (auto& p : objects){
+    size_t size = 48 + rng() % 33;
+    p = allocate(size);
+    touch(p, size);
+  }
+  for (size_t done = 0; done < ops; done += live / 2){
+    for (size_t i = 0; i < live / 2; i++){
+      size_t at = rng() % live;
+      if (!objects[at]) continue;
+      release(objects[at]);
+      objects[at] = nullptr;
+    }
+    for (auto& p : objects){
+      if (p) continue;
+      size_t size = 48 + rng() % 33;
+      p = allocate(size);
+      touch(p, size);
+    }
+  }
+  for (void* p : objects) release(p);
+}
+
+int main(int argc, char** argv){
+  if (argc < 4){
+    std::fprintf(stderr, "usage: %s slab|malloc set|zset LIVE [OPS] [THREADS]\n", argv[0]);
+    return 1;
+  }
+  useSlab = std::string(argv[1]) == "slab";
+  bool set = std::string(argv[2]) == "set";
+  size_t live = std::strtoull(argv[3], nullptr, 10);
+  size_t ops = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : live * 10;
+  size_t threads = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 1;
+
+  auto start = Clock::now();
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++){
+    workers.emplace_back([=]{
+      if (set) set_churn(live / threads, ops / threads, t + 1);
+      else zset_churn(live / threads, ops / threads, t + 1);
+    });
+  }
+  for (auto& w : workers) w.join();
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::printf("%-6s %-4s live %zu ops %zu threads %zu: %.3f s (%.1f Mops/s), rss %.1f MB\n",
+              argv[1], argv[2], live, ops, threads, elapsed, ops / elapsed / 1e6, resident_bytes() / 1048576.0);
+}
@@ -0,0 +1,104 @@
+// Memory per stream entry: the packed node storage vs the std::map of ID -> field vector it
+// replaced, on a telemetry-like stream (same four fields on every entry, a few entries per
+// millisecond). Each run is its own process so the RSS numbers don't mix.
+//
+//   g++ -std=c++20 -O2 -Iinclude bench/streamBench.cpp src/streamNode.cpp -o streamBench
+//   ./streamBench node 10000000
+//   ./streamBench map 10000000
+#include "stream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start){
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static size_t resident_bytes(){
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Entry i's ID and its sensor, temp, humidity and status values
+struct Record {
+  StreamID id;
+  std::string values[4];
+};
+
+static void make_record(std::mt19937& rng, size_t i, Record& record){
+  static uint64_t ms = 1700000000000, seq = 0;
+  if (rng() % 4 == 0) { ms += 1 + rng() % 3; seq = 0; } else seq++;
+  record.id = StreamID{ms, seq};
+  record.values[0] = "sensor-" + std::to_string(i % 512);
+  record.values[1] = std::to_string(150 + rng() % 200);
+  record.values[2] = std::to_string(rng() % 100);
+  record.values[3] = rng() % 64 ? "ok" : "alarm";
+}
+
+static const char* NAMES[4] = {"sensor", "temp", "humidity", "status"};
+
+int main(int argc, char** argv){
+  if (argc < 3) {
+    std::fprintf(stderr, "usage: %s node|map entries\n", argv[0]);
+    return 1;
+  }
+  bool node = std::strcmp(argv[1], "node") == 0;
+  size_t n = std::strtoull(argv[2], nullptr, 10);
+  std::mt19937 rng(42);
+  Record record;
+
+  size_t before = resident_bytes();
+  auto start = Clock::now();
+  Stream stream;
+  std::map<StreamID, std::vector<std::pair<std::string, std::string>>> entries;
+  for (size_t i = 0; i < n; i++) {
+    make_record(rng, i, record);
+    if (node) {
+      std::string_view fields[8];
+      for (int f = 0; f < 4; f++) {
+        fields[2 * f] = NAMES[f];
+        fields[2 * f + 1] = record.values[f];
+      }
+      stream.append(record.id, fields, 4);
+    } else {
+      auto& fields = entries[record.id];
+      fields.reserve(4);
+      for (int f = 0; f < 4; f++) fields.emplace_back(NAMES[f], record.values[f]);
+    }
+  }
+  double build = seconds_since(start);
+  size_t used = resident_bytes() - before;
+
+  // Read everything back, so a broken encoding can't pass for a small one
+  start = Clock::now();
+  size_t checksum = 0;
+  if (node) {
+    stream.walk(StreamID{}, false, [&](const StreamEntry& entry){
+      for (const auto& [field, value] : entry.fields) checksum += field.size() + value.size();
+      return true;
+    });
+  } else {
+    for (const auto& [id, fields] : entries)
+      for (const auto& [field, value] : fields) checksum += field.size() + value.size();
+  }
+  double scan = seconds_since(start);
+
+  std::printf("%s: %zu entries, %.1f bytes/entry, build %.2f s, scan %.2f s, checksum %zu",
+              argv[1], n, double(used) / n, build, scan, checksum);
+  if (node) std::printf(", %zu nodes", stream.node_count());
+  std::printf("\n");
+  return 0;
+}
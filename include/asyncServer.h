@@ -0,0 +1,8 @@
+#ifndef ASYNCSERVER_H
+#define ASYNCSERVER_H
+
+#include "client.h"
+
+int run_async_server(ServerContext& ctx);
+
+#endif
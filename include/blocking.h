@@ -0,0 +1,69 @@
+#ifndef BLOCKING_H
+#define BLOCKING_H
+
+#include "client.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// BLPOP / BRPOP / BLMOVE that found every key empty park the client instead of
+// sleeping, like Redis' blocked clients. The parked pop is queued on each of its keys,
+// and a push to one of them serves the oldest waiter straight from the push path:
+// the element is popped under the push's own stripe lock and the reply handed over.
+// A parked BLMOVE is woken to move the element itself instead, its destination may
+// be on a stripe the push doesn't hold. Nothing polls: the connection's I/O backend
+// waits for the wake or the timeout on its own event loop (asio timer, io_uring
+// timeout, or an eventfd for the thread per connection backend), then calls resume_parked.
+//
+// The queues are per stripe and guarded by the stripe: whoever holds a key's stripe
+// exclusively (lock or shard) may park on it or serve it.
+struct ParkedPop {
+    enum State : int {
+        WAITING,
+        SERVING,   // claimed by a push, reply being written
+        SERVED,    // reply is ready
+        RETRY,     // BLMOVE: an element arrived, run the command again under its own locks
+        TIMED_OUT, // or the client went away
+    };
+
+    std::vector<std::string> argv; // the command, for RETRY
+    std::vector<std::string> keys;
+    bool popLeft = true;
+    bool move = false; // BLMOVE, the destination may be on a stripe the push doesn't hold
+    std::chrono::steady_clock::time_point deadline; // max() waits forever
+    std::atomic<int> state{WAITING};
+    std::string reply; // written by the push that claimed it, read once SERVED
+    std::function<void()> wake; // the client's unpark, called when state becomes SERVED or RETRY
+
+    bool ready() const {
+        int s = state.load(std::memory_order_acquire);
+        return s == SERVED || s == RETRY;
+    }
+};
+
+// Parses a BLPOP timeout in seconds (fractions allowed, 0 is forever), returns an
+// error reply if it isn't one
+std::string parse_block_timeout(std::string_view arg, std::chrono::steady_clock::time_point& deadline);
+
+// Queues the client on every key of pop, the caller holds all their stripes exclusively
+void park(ClientState& client, Keyspace& db, std::shared_ptr<ParkedPop> pop);
+
+// Hands the list at key to parked clients, oldest first, while it has elements. Every
+// command that can add to a list calls it with the key's stripe held exclusively. The
+// pops are queued for replicas as LPOP / RPOP behind client's command, see also_propagate
+void serve_parked(ClientState& client, Keyspace& db, std::string_view key);
+
+// Called by the I/O backend once the client's unpark ran or its deadline passed.
+// Appends the reply to client.out and returns true if the command is finished, false
+// if it is still parked (woken early, or BLMOVE lost its element and parked again)
+bool resume_parked(ClientState& client, ServerContext& ctx);
+
+// Drops a parked pop whose client is going away
+void cancel_parked(ClientState& client, ServerContext& ctx);
+
+#endif
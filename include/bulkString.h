@@ -1,9 +0,0 @@
-#ifndef BULKSTRING_H
-#define BULKSTRING_H
-
-#include <fstream>
-#include <string>
-
-std::string parsebulkString(int& items, int client_fd, std::string& read_buffer);
-
-#endif // BULKSTRING_H
\ No newline at end of file
@@ -1,8 +0,0 @@
-#ifndef CLEAR_H
-#define CLEAR_H
-
-#include <string>
-
-void clear_array(int& items, std::string& read_buffer);
-
-#endif 
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "config.h"
+#include "resp.h"
+#include "outputBuffer.h"
+#include "evict.h"
+#include "keyspace.h"
+
+#include <string>
+#include <set>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+struct ParkedPop;
+
+// Everything a connection needs to run commands, owned by main()
+struct ServerContext {
+    Config config;
+    std::string filepath;
+    Keyspace& db;
+    std::map<std::string, std::set<int>>& channels;
+    OutputLimit normalLimit;
+    OutputLimit pubsubLimit;
+    EvictionConfig eviction;
+};
+
+// Per connection state, kept between reads
+struct ClientState {
+    int fd = -1;
+    int replOffset = 0;
+    std::vector<std::string> propagateAs; // what replicas get for the running command instead of argv, see rewrite_command
+    std::string alsoPropagate; // writes the running command made on the side, encoded, see also_propagate
+    std::string read_buffer;
+    RespParser parser;
+    Argv argv; // reused for every command, views into read_buffer
+    OutputBuffer out; // replies waiting to be written to the socket, flushed once per read batch
+    std::chrono::steady_clock::time_point softSince{}; // over the normal soft output limit since
+    std::shared_ptr<PushQueue> push; // set by the I/O backend, registered once the client subscribes
+
+    std::set<std::string> subbed;
+    bool subMode = false;
+
+    bool multi = false;
+    bool execing = false; // running EXEC's queued commands, which must not park
+    std::vector<std::vector<std::string>> queued; // commands between MULTI and EXEC
+
+    std::shared_ptr<ParkedPop> parked; // BLPOP & co waiting for a push, see blocking.h
+    std::function<void()> unpark; // set by the I/O backend, wakes whatever runs this client once parked is served
+};
+
+enum class ProcessResult {
+    Done,   // read_buffer has no complete command left
+    Blocked, // stopped in front of a command that may sleep (XREAD BLOCK, WAIT)
+    Parked   // a BLPOP / BRPOP / BLMOVE parked the client, see resume_parked
+};
+
+// Moves messages other connections pushed to this one into client.out
+void take_pushed(ClientState& client);
+
+// Queues a pub/sub message for the subscriber on fd and wakes its I/O loop.
+// A subscriber over the pubsub output limit is shut down instead, false if fd has no push queue
+bool push_message(int fd, std::string_view message, const OutputLimit& limit);
+
+// Makes the client reachable by push_message, done when it first subscribes
+void register_client(ClientState& client);
+
+// Called by the I/O backend before the socket is closed, also drops the client's subscriptions
+void unregister_client(ClientState& client, ServerContext& ctx);
+
+ProcessResult process_client_buffer(ClientState& client, ServerContext& ctx, bool allowBlocking = true);
+
+void handle_client(int client_fd, ServerContext& ctx);
+
+#endif
@@ -1,9 +1,10 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
+#include "resp.h"
 #include <string>
 
-std::string command_command(int& items, int client_fd, std::string& read_buffer);
+std::string command_command(const Argv& argv);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,55 @@
+#ifndef COMMANDTABLE_H
+#define COMMANDTABLE_H
+
+#include "client.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum CommandFlag : uint32_t {
+    CMD_WRITE        = 1 << 0, // changes the dataset, propagated to replicas
+    CMD_READONLY     = 1 << 1,
+    CMD_BLOCKING     = 1 << 2, // may sleep, event loop backends run it on a helper thread
+    CMD_PUBSUB       = 1 << 3, // allowed while the client is in subscribed mode
+    CMD_NOQUEUE      = 1 << 4, // runs immediately inside MULTI instead of being queued
+    CMD_MOVABLE_KEYS = 1 << 5, // keys aren't at fixed positions (XREAD ... STREAMS k1 k2 id1 id2)
+    CMD_ALL_KEYS     = 1 << 6, // reads the whole keyspace, locks every stripe
+    CMD_DENYOOM      = 1 << 7, // may grow the dataset: evicts first over maxmemory, refused if it can't
+    CMD_PARKS        = 1 << 8, // may park the client until a push serves it (BLPOP), propagates the pop it turns into itself
+};
+
+using CommandHandler = std::string (*)(ClientState& client, ServerContext& ctx, const Argv& argv);
+
+struct CommandSpec {
+    std::string_view name; // lowercase
+    CommandHandler handler;
+    int arity;    // argc including the name, negative means at least -arity
+    uint32_t flags;
+    int firstKey; // argv index of the first key, 0 if the command takes none
+    int lastKey;  // negative counts from the end, -1 is the last argument
+    int keyStep;
+    bool (*blocksWith)(const Argv& argv) = nullptr; // for CMD_BLOCKING commands that only sometimes block
+    void (*keysWith)(const Argv& argv, int& first, int& last, int& step) = nullptr; // key positions for CMD_MOVABLE_KEYS
+};
+
+// Case insensitive lookup without building a lowercase copy, nullptr if unknown
+const CommandSpec* lookup_command(std::string_view name);
+
+// Adds the stripes of the command's keys to lock, exclusive for CMD_WRITE commands
+void lock_command_keys(KeyLock& lock, const CommandSpec& spec, const Argv& argv);
+
+// Makes room for CMD_DENYOOM commands, locks the command's keys, runs the handler,
+// then propagates the write to replicas if it changed anything.
+// Commands that block lock per poll instead, so they don't sleep holding a stripe
+std::string execute_command(ClientState& client, ServerContext& ctx, const CommandSpec& spec, const Argv& argv);
+
+inline bool arity_ok(const CommandSpec& spec, size_t argc){
+    return spec.arity >= 0 ? argc == static_cast<size_t>(spec.arity) : argc >= static_cast<size_t>(-spec.arity);
+}
+
+inline bool command_blocks(const CommandSpec& spec, const Argv& argv){
+    if (!(spec.flags & CMD_BLOCKING)) return false;
+    return !spec.blocksWith || spec.blocksWith(argv);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include "resp.h"
 #include <string>
 
 struct Config {
@@ -8,8 +9,22 @@ struct Config {
     std::string dbfilename;
     std::string port = "6379";
     std::string replica = "master";
+    std::string ioBackend = "threads"; // threads | asio | uring
+    std::string ioThreads = "1"; // asio / uring reactors, each with its own SO_REUSEPORT listener
+    std::string tcpBacklog = "511";
+    std::string shards = "0"; // > 0: shard-per-core execution, see shard.h
+    std::string outputLimitNormal = "0 0 0"; // <hard> <soft> <soft seconds>, see outputBuffer.h
+    std::string outputLimitPubsub = "32mb 8mb 60";
+    std::string maxmemory = "0"; // 0 is no limit, see evict.h
+    std::string maxmemoryPolicy = "noeviction";
+    std::string maxmemorySamples = "5";
+    std::string listCompressDepth = "0"; // list nodes kept plain at each end, 0 never compresses, see quicklist.h
+    std::string zsetMaxListpackEntries = "128"; // sorted sets stay packed up to this many members, see set.h
+    std::string zsetMaxListpackValue = "64";    // and while every member is at most this long
+    std::string streamNodeMaxBytes = "4096";    // stream entries packed per node, 0 is no limit, see stream.h
+    std::string streamNodeMaxEntries = "100";
 };
 
-std::string config_command(int& items, int client_fd, std::string& read_buffer, Config config);
+std::string config_command(const Argv& argv, const Config& config);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,327 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <sys/mman.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open addressing hash table keyed by std::string, laid out like a Swiss table:
+// a control byte per slot holds 7 bits of the key's hash (or EMPTY / DELETED),
+// and a probe compares 16 control bytes at once before touching any key.
+//
+// Growing doesn't rehash everything at once. Like Redis' dict, the old table is
+// kept next to the new one and every insert moves one group of 16 slots over,
+// so a resize costs a few microseconds per write instead of one long pause.
+// Lookups check the new table first, then the old one while it still exists.
+//
+// Pointers returned by find/insert stay valid until the next insert (which may
+// migrate entries); find and erase never move anything.
+//
+// Zero is the EMPTY control byte, so a fresh table comes from calloc without a
+// memset, and the drained part of the old table is handed back to the kernel as
+// the migration goes, so neither end of a resize touches the whole table at once.
+//
+// K may be std::string_view when the bytes live in the value already (a sorted set's
+// member index points into its nodes); the caller keeps them alive and unmoved.
+template <typename V, typename K = std::string>
+class Dict {
+public:
+    using Entry = std::pair<K, V>;
+
+    Dict() = default;
+    Dict(const Dict&) = delete;
+    Dict& operator=(const Dict&) = delete;
+    // Movable so a dict can live inside a keyspace value (a sorted set's member index)
+    Dict(Dict&& other) noexcept
+        : cur(std::exchange(other.cur, Table{})), old(std::exchange(other.old, Table{})),
+          migrated(std::exchange(other.migrated, 0)), released(std::exchange(other.released, 0)) {}
+    Dict& operator=(Dict&& other) noexcept {
+        if (this != &other){
+            clear();
+            cur = std::exchange(other.cur, Table{});
+            old = std::exchange(other.old, Table{});
+            migrated = std::exchange(other.migrated, 0);
+            released = std::exchange(other.released, 0);
+        }
+        return *this;
+    }
+    ~Dict(){ cur.destroy(); old.destroy(); }
+
+    V* find(std::string_view key){
+        size_t hash = hasher(key);
+        Entry* e = cur.find(key, hash);
+        if (!e && rehashing()) e = old.find(key, hash);
+        return e ? &e->second : nullptr;
+    }
+
+    // Inserts or overwrites, the reference stays valid until the next insert
+    template <typename T>
+    V& insert_or_assign(std::string_view key, T&& value){
+        size_t hash = hasher(key);
+        if (Entry* e = cur.find(key, hash)){
+            e->second = std::forward<T>(value);
+            return e->second;
+        }
+        if (rehashing()){
+            if (Entry* e = old.find(key, hash)){
+                e->second = std::forward<T>(value);
+                return e->second;
+            }
+        }
+        grow_if_needed();
+        rehash_step();
+        return cur.emplace(hash, K(key), std::forward<T>(value))->second;
+    }
+
+    bool erase(std::string_view key){
+        size_t hash = hasher(key);
+        if (cur.erase(key, hash)) return true;
+        return rehashing() && old.erase(key, hash);
+    }
+
+    size_t size() const { return cur.size + old.size; }
+    size_t bucket_count() const { return cur.capacity + old.capacity; }
+    bool rehashing() const { return old.capacity != 0; }
+
+    // f(const K& key, V& value), must not insert into the dict
+    template <typename F>
+    void for_each(F f){
+        cur.for_each(f);
+        old.for_each(f);
+    }
+
+    // f(key, value) on up to count entries, scanning from slot start (taken modulo the
+    // table size) and wrapping. Like Redis' dictGetSomeKeys: cheap, not uniform
+    template <typename F>
+    void sample(size_t start, size_t count, F f){
+        count -= old.sample(start, count, f);
+        if (count) cur.sample(start, count, f);
+    }
+
+    void clear(){
+        cur.destroy();
+        old.destroy();
+        migrated = released = 0;
+    }
+
+private:
+    static constexpr size_t GROUP = 16;
+    static constexpr size_t MIN_CAPACITY = GROUP; // one group, small sorted sets have a dict each
+    static constexpr int8_t EMPTY = 0;
+    static constexpr int8_t DELETED = 1;   // full slots have the top bit set: 0b1hhhhhhh
+    static constexpr size_t RELEASE_BYTES = 1 << 18; // give drained slot memory back in 256 KB steps
+
+    static int8_t h2(size_t hash){ return static_cast<int8_t>(0x80 | (hash & 0x7F)); }
+    static size_t h1(size_t hash){ return hash >> 7; }
+
+    // Bitmask of the slots in a group of 16 control bytes that satisfy a test
+    struct Group {
+#if defined(__SSE2__)
+        __m128i ctrl;
+        explicit Group(const int8_t* p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+        uint32_t match(int8_t h) const {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h)));
+        }
+        uint32_t match_empty() const { return match(EMPTY); }
+        uint32_t match_full() const { return _mm_movemask_epi8(ctrl); }
+        uint32_t match_free() const { return ~match_full() & 0xFFFF; }
+#else
+        int8_t ctrl[GROUP];
+        explicit Group(const int8_t* p){ std::memcpy(ctrl, p, GROUP); }
+        uint32_t match(int8_t h) const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP; i++) mask |= uint32_t(ctrl[i] == h) << i;
+            return mask;
+        }
+        uint32_t match_empty() const { return match(EMPTY); }
+        uint32_t match_full() const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP; i++) mask |= uint32_t(ctrl[i] < 0) << i;
+            return mask;
+        }
+        uint32_t match_free() const { return ~match_full() & 0xFFFF; }
+#endif
+    };
+
+    struct Table {
+        int8_t* ctrl = nullptr;
+        Entry* slots = nullptr; // raw storage, only slots with a full control byte are constructed
+        size_t capacity = 0;    // power of two, multiple of GROUP
+        size_t size = 0;
+        size_t deleted = 0;
+
+        void allocate(size_t n){
+            capacity = n;
+            size = deleted = 0;
+            ctrl = static_cast<int8_t*>(std::calloc(n, 1));
+            if (!ctrl) throw std::bad_alloc();
+            slots = static_cast<Entry*>(::operator new(n * sizeof(Entry), std::align_val_t(alignof(Entry))));
+        }
+
+        void destroy(){
+            if (!capacity) return;
+            for (size_t i = 0; size && i < capacity; i++){
+                if (ctrl[i] < 0){
+                    slots[i].~Entry();
+                    size--;
+                }
+            }
+            std::free(ctrl);
+            ::operator delete(slots, std::align_val_t(alignof(Entry)));
+            *this = Table{};
+        }
+
+        // Triangular probing over groups visits every group once when the group count
+        // is a power of two. The bound matters for a table being drained, which can
+        // run out of EMPTY bytes since migrated slots become tombstones
+        template <typename F>
+        void probe(size_t hash, F f) const {
+            size_t mask = capacity / GROUP - 1;
+            size_t g = h1(hash) & mask;
+            for (size_t step = 1; step <= mask + 1; step++){
+                if (f(g * GROUP)) return;
+                g = (g + step) & mask;
+            }
+        }
+
+        Entry* find(std::string_view key, size_t hash) const {
+            if (!capacity) return nullptr;
+            Entry* found = nullptr;
+            int8_t tag = h2(hash);
+            probe(hash, [&](size_t base){
+                Group group(ctrl + base);
+                for (uint32_t m = group.match(tag); m; m &= m - 1){
+                    size_t i = base + __builtin_ctz(m);
+                    if (slots[i].first == key){ found = &slots[i]; return true; }
+                }
+                return group.match_empty() != 0;
+            });
+            return found;
+        }
+
+        // Caller made sure the key is absent and there is room
+        template <typename T>
+        Entry* emplace(size_t hash, K&& key, T&& value){
+            size_t slot = 0;
+            probe(hash, [&](size_t base){
+                uint32_t m = Group(ctrl + base).match_free();
+                if (!m) return false;
+                slot = base + __builtin_ctz(m);
+                return true;
+            });
+            if (ctrl[slot] == DELETED) deleted--;
+            ctrl[slot] = h2(hash);
+            size++;
+            return new (&slots[slot]) Entry(std::move(key), std::forward<T>(value));
+        }
+
+        bool erase(std::string_view key, size_t hash){
+            Entry* e = find(key, hash);
+            if (!e) return false;
+            size_t i = e - slots;
+            e->~Entry();
+            // A slot in a group that still has an EMPTY byte can't be in the middle of
+            // another key's probe sequence, so it can go back to EMPTY instead of a tombstone
+            bool groupHasEmpty = Group(ctrl + (i & ~(GROUP - 1))).match_empty() != 0;
+            ctrl[i] = groupHasEmpty ? EMPTY : DELETED;
+            if (!groupHasEmpty) deleted++;
+            size--;
+            return true;
+        }
+
+        template <typename F>
+        void for_each(F& f){
+            for (size_t base = 0; base < capacity; base += GROUP){
+                for (uint32_t m = Group(ctrl + base).match_full(); m; m &= m - 1){
+                    Entry& e = slots[base + __builtin_ctz(m)];
+                    f(static_cast<const K&>(e.first), e.second);
+                }
+            }
+        }
+
+        // Returns how many entries it visited
+        template <typename F>
+        size_t sample(size_t start, size_t count, F& f){
+            size_t visited = 0;
+            size_t groups = capacity / GROUP;
+            for (size_t n = 0; n < groups && visited < count; n++){
+                size_t base = ((start / GROUP + n) % groups) * GROUP;
+                for (uint32_t m = Group(ctrl + base).match_full(); m && visited < count; m &= m - 1){
+                    Entry& e = slots[base + __builtin_ctz(m)];
+                    f(static_cast<const K&>(e.first), e.second);
+                    visited++;
+                }
+            }
+            return visited;
+        }
+    };
+
+    // Keep at most 7/8 of the slots used (tombstones included). When the table
+    // is that full a new one is started and the old one drained incrementally.
+    void grow_if_needed(){
+        if (cur.capacity == 0){
+            cur.allocate(MIN_CAPACITY);
+            return;
+        }
+        if ((cur.size + cur.deleted + 1) * 8 <= cur.capacity * 7) return;
+        if (rehashing()) finish_rehash(); // growing faster than we migrate, shouldn't happen with one group per insert
+        // Mostly tombstones: rebuild at the same size, otherwise double
+        size_t capacity = cur.size * 2 < cur.capacity ? cur.capacity : cur.capacity * 2;
+        old = cur;
+        cur = Table{};
+        cur.allocate(capacity);
+        migrated = 0;
+        released = 0;
+    }
+
+    // Moves one group of the old table into the new one
+    void rehash_step(){
+        if (!rehashing()) return;
+        Group group(old.ctrl + migrated);
+        for (uint32_t m = group.match_full(); m; m &= m - 1){
+            size_t i = migrated + __builtin_ctz(m);
+            Entry& e = old.slots[i];
+            cur.emplace(hasher(e.first), std::move(e.first), std::move(e.second));
+            e.~Entry();
+            old.ctrl[i] = DELETED;
+            old.size--;
+        }
+        migrated += GROUP;
+        if (migrated * sizeof(Entry) - released >= RELEASE_BYTES) release_migrated();
+        if (migrated == old.capacity) old.destroy();
+    }
+
+    // Drops the pages of old slots that were already moved, so freeing the old table
+    // at the end of the resize doesn't have to unmap hundreds of MB in one go
+    void release_migrated(){
+        const uintptr_t page = 4096;
+        uintptr_t from = (reinterpret_cast<uintptr_t>(old.slots) + released + page - 1) & ~(page - 1);
+        uintptr_t to = (reinterpret_cast<uintptr_t>(old.slots) + migrated * sizeof(Entry)) & ~(page - 1);
+        if (to > from) madvise(reinterpret_cast<void*>(from), to - from, MADV_DONTNEED);
+        if (to > from) released = to - reinterpret_cast<uintptr_t>(old.slots);
+    }
+
+    void finish_rehash(){
+        while (rehashing()) rehash_step();
+    }
+
+    Table cur;
+    Table old;              // being drained into cur while a resize is in progress
+    size_t migrated = 0;    // slots of old already moved
+    size_t released = 0;    // bytes at the start of old.slots already given back
+    std::hash<std::string_view> hasher;
+};
+
+#endif
@@ -1,8 +1,9 @@
 #ifndef ECHO_H
 #define ECHO_H
 
+#include "resp.h"
 #include <string>
 
-std::string echo_command(int& items, int client_fd, std::string& read_buffer);
+std::string echo_command(const Argv& argv);
 
-#endif
\ No newline at end of file
+#endif
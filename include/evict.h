@@ -0,0 +1,44 @@
+#ifndef EVICT_H
+#define EVICT_H
+
+#include "config.h"
+#include "keyspace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+enum class EvictionPolicy : uint8_t { NoEviction, AllKeysLru, AllKeysLfu, VolatileLru, VolatileTtl };
+
+// --maxmemory / --maxmemory-policy / --maxmemory-samples, maxmemory 0 means no limit
+struct EvictionConfig {
+    size_t maxmemory = 0;
+    EvictionPolicy policy = EvictionPolicy::NoEviction;
+    size_t samples = 5;
+};
+
+// Throws std::invalid_argument for an unknown policy or a bad size
+EvictionConfig parse_eviction_config(const Config& config);
+
+const char* policy_name(EvictionPolicy policy);
+
+struct EvictionStats {
+    std::atomic<uint64_t> evictedKeys{0};
+    std::atomic<uint64_t> rejectedCommands{0}; // OOM errors sent back
+};
+
+EvictionStats& eviction_stats();
+
+// Called before commands that can grow the dataset, with no stripe locked. Evicts
+// keys until used_memory() is back under the limit, false when it can't (policy
+// noeviction, or no key the policy may evict) and the command should get an OOM error.
+//
+// Candidates are sampled like Redis does rather than kept in a global LRU list: each
+// round reads a few keys from a random stripe, ranks them by the policy, and merges
+// them into a small pool of the best candidates seen so far, which survives between
+// calls. The best one in the pool is deleted and the pool refilled as needed.
+bool free_memory_if_needed(Keyspace& db, const EvictionConfig& config);
+
+const std::string OOM_ERROR = "-OOM command not allowed when used memory > 'maxmemory'.\r\n";
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef EXPIRE_H
+#define EXPIRE_H
+
+#include "resp.h"
+#include "keyspace.h"
+#include "client.h"
+#include <string>
+#include <chrono>
+
+// EXPIRE / PEXPIRE, unit is what the command's number counts. Works on keys of any type.
+// Replicas get the deadline as a PEXPIREAT, so they expire the key when the master does
+std::string expire_command(ClientState& client, const Argv& argv, Keyspace& db, std::chrono::milliseconds unit);
+
+// EXPIREAT / PEXPIREAT: the deadline as a unix time in unit. One in the past deletes the key
+std::string expireat_command(const Argv& argv, Keyspace& db, std::chrono::milliseconds unit);
+
+// TTL / PTTL: -2 for a missing key, -1 for a key without expiry
+std::string ttl_command(const Argv& argv, Keyspace& db, std::chrono::milliseconds unit);
+
+// EXPIRETIME / PEXPIRETIME: the deadline as a unix time in unit, -2 and -1 like TTL
+std::string expiretime_command(const Argv& argv, Keyspace& db, std::chrono::milliseconds unit);
+
+std::string persist_command(const Argv& argv, Keyspace& db);
+
+// Active expiry, run on its own thread for the life of the server. Like Redis' slow
+// cycle it wakes 10 times a second and spends at most a quarter of that deleting
+// keys past their deadline, a few stripes at a time so writers never wait long.
+// When it runs out of time with keys still due it comes back sooner.
+void active_expire_loop(Keyspace& db);
+
+#endif
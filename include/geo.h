@@ -1,22 +1,24 @@
 #ifndef GEO_H
 #define GEO_H
 
-#include "set.h"
+#include "keyspace.h"
+#include "resp.h"
 #include <string>
 #include <set>
 #include <vector>
 #include <map>
 
-std::string geoadd_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets);
+// Any number of longitude latitude member triples, added through one ZADD
+std::string geoadd_command(const Argv& argv, Keyspace& db);
 
-std::string geopos_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets);
+// Both find members with ZSet::score: the member hash, or a scan of a packed set
+std::string geopos_command(const Argv& argv, Keyspace& db);
 
-std::string geodist_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets);
+std::string geodist_command(const Argv& argv, Keyspace& db);
 
-std::string geosearch_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets);
+// Scans only the geohash cells covering the search area, not the whole set
+std::string geosearch_command(const Argv& argv, Keyspace& db);
+
+std::string geosearchstore_command(const Argv& argv, Keyspace& db);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef GEO_DISTANCE_H
+#define GEO_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr double MIN_LATITUDE = -85.05112878;
+constexpr double MAX_LATITUDE = 85.05112878;
+constexpr double MIN_LONGITUDE = -180.0;
+constexpr double MAX_LONGITUDE = 180.0;
+
+constexpr double LATITUDE_RANGE = MAX_LATITUDE - MIN_LATITUDE;
+constexpr double LONGITUDE_RANGE = MAX_LONGITUDE - MIN_LONGITUDE;
+
+constexpr double EARTH_RADIUS = 6372797.560856; // meters, Redis' value
+
+// Where a GEOSEARCH looks: a circle or a box around a center, all in meters
+struct GeoShape {
+    double lon = 0, lat = 0;
+    bool box = false;
+    double radius = 0;
+    double width = 0, height = 0;
+    double conversion = 1; // meters per unit of the query, distances are replied in it
+};
+
+// A shape worked out once per query for geo_filter. A candidate at latitude φ, Δφ and
+// Δλ from the center is in a circle when its haversine term
+//     hav = sin²(Δφ/2) + cos φ0 cos φ sin²(Δλ/2)
+// is at most sin²(r/2R), which skips the asin; a box compares cos²φ sin²(Δλ/2) the
+// same way. Before any of that, |Δφ| and |Δλ| are checked against the shape's
+// bounding box, which needs no trigonometry and rejects most of the covering cells.
+struct GeoFilter {
+    double lon, lat;   // degrees
+    double cosLat;
+    bool box;
+    double maxDLat;    // degrees, exact for a box
+    double maxDLon;    // degrees, 180 when every longitude can match
+    double maxHav;     // circle
+    double maxLonHav;  // box
+};
+
+GeoFilter geo_prepare(const GeoShape& shape);
+
+// Decodes n geohash scores and tests each against filter. The indexes of those inside
+// go to matched, in order; returns how many. Runs the widest kernel the CPU has
+// (AVX-512, AVX2 or plain scalar code), picked once: they may round differently in the
+// last bits, but a process always uses the same one
+size_t geo_filter(const GeoFilter& filter, const double* scores, size_t n, uint32_t* matched);
+
+// Meters between two points, computed like Redis' geohashGetDistance. A match's
+// distance comes from this, not from the kernels: they decode a cell a rounding away
+// from decodeCoords, which would put a member a nanometer from itself
+double geo_distance(double lon1, double lat1, double lon2, double lat2);
+
+// "avx512", "avx2" or "scalar"
+const char* geo_kernel_name();
+// Makes geo_filter use the named kernel, false if the CPU can't run it. For benchmarks
+bool geo_use_kernel(const char* name);
+
+#endif
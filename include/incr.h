@@ -1,12 +1,22 @@
 #ifndef INCR_H
 #define INCR_H
 
+#include "resp.h"
+#include "keyspace.h"
+#include "client.h"
 #include <string>
-#include <map>
-#include <tuple>
-#include <chrono>
 
-std::string incr_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict);
+// The counters work on int encoded strings directly, a raw string value is parsed
+// once and stored int encoded from then on. Overflow is an error, not a wrap
+std::string incr_command(const Argv& argv, Keyspace& db);
 
-#endif
\ No newline at end of file
+std::string decr_command(const Argv& argv, Keyspace& db);
+
+std::string incrby_command(const Argv& argv, Keyspace& db);
+
+std::string decrby_command(const Argv& argv, Keyspace& db);
+
+// Replicas get the result as SET ... KEEPTTL, so they don't redo the float math
+std::string incrbyfloat_command(ClientState& client, const Argv& argv, Keyspace& db);
+
+#endif
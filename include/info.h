@@ -3,7 +3,14 @@
 
 #include <string>
 #include "config.h"
+#include "keyspace.h"
+#include "evict.h"
+#include "resp.h"
 
-std::string info_command(int& items, int client_fd, std::string& read_buffer, Config config);
+// INFO [replication|memory|stats|keyspace], no section gives all of them
+std::string info_command(const Argv& argv, const Config& config, const EvictionConfig& eviction, Keyspace& db);
 
-#endif
\ No newline at end of file
+// MEMORY STATS: used memory against RSS, and the slab allocator's classes
+std::string memory_command(const Argv& argv);
+
+#endif
@@ -1,11 +1,13 @@
 #ifndef KEYS_H
 #define KEYS_H
 
+#include "resp.h"
+#include "keyspace.h"
 #include <string>
 #include <map>
 #include <tuple>
 #include <chrono>
 
-std::string key_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict);
+std::string key_command(const Argv& argv, Keyspace& db);
 
 #endif
\ No newline at end of file
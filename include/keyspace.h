@@ -0,0 +1,354 @@
+#ifndef KEYSPACE_H
+#define KEYSPACE_H
+
+#include "set.h"
+#include "stream.h"
+#include "dict.h"
+#include "quicklist.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <variant>
+#include <array>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+
+class ShardEngine;
+
+using List = QuickList;
+
+enum class ObjType : uint8_t { String, List, ZSet, Stream };
+
+enum class Encoding : uint8_t {
+    Raw,       // string
+    Int,       // string that holds a 64 bit integer
+    QuickList, // list
+    Listpack,  // small sorted set, packed
+    SkipList,  // sorted set
+    Map        // stream
+};
+
+const std::string WRONGTYPE = "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+
+// Strict base 10 int64, like Redis' string2ll: no sign but '-', no leading zeros or
+// spaces, so an integer read from a string formats back to the same bytes
+bool parse_int64(std::string_view s, int64_t& value);
+
+// Formats into buf (at least 21 chars), returns the digits
+std::string_view format_int64(int64_t value, char* buf);
+
+// One value in the keyspace, whatever its type
+struct RedisObject {
+    ObjType type;
+    Encoding encoding; // a sorted set converts itself as it grows, see encoding_name
+    // Strings that hold a 64 bit integer are kept as the integer (Encoding::Int), so
+    // INCR and friends never parse or format, and only become bytes when asked for
+    std::variant<std::string, int64_t, List, ZSet, Stream> value;
+    std::chrono::system_clock::time_point expiry{}; // epoch means no expiry
+    uint64_t access = 0; // what eviction ranks keys by, see access_clock
+
+    template <typename T> T& as() { return std::get<T>(value); }
+    bool is_int() const { return std::holds_alternative<int64_t>(value); }
+
+    // A string value's bytes, an int encoded one is formatted into buf (at least 21 chars)
+    std::string_view string_bytes(char* buf) const {
+        if (is_int()) return format_int64(std::get<int64_t>(value), buf);
+        return std::get<std::string>(value);
+    }
+    // Raw bytes for editing in place (APPEND), an int encoded value is converted first
+    std::string& raw_string(){
+        if (is_int()){
+            char buf[24];
+            value = std::string(string_bytes(buf));
+            encoding = Encoding::Raw;
+        }
+        return std::get<std::string>(value);
+    }
+    // Stores a string value, as an integer when it is one
+    void assign_string(std::string bytes){
+        int64_t n;
+        if (parse_int64(bytes, n)) assign_int(n);
+        else {
+            value = std::move(bytes);
+            encoding = Encoding::Raw;
+        }
+    }
+    void assign_int(int64_t n){
+        value = n;
+        encoding = Encoding::Int;
+    }
+    bool expired(std::chrono::system_clock::time_point now) const {
+        return expiry != std::chrono::system_clock::time_point{} && expiry <= now;
+    }
+};
+
+// A key's access metadata. The low 32 bits are Redis' 24 bit lru field: a seconds clock
+// of the last access (LRU, wraps every 194 days) and above it an 8 bit logarithmic access
+// counter (LFU) that decays by one per idle minute. The next 10 bits hold the millisecond
+// within that second, so LRU also orders keys touched in the same second, such as a
+// pipelined batch and the reads right after it. They fit in RedisObject's padding
+constexpr uint32_t ACCESS_CLOCK_MASK = (1u << 24) - 1;
+constexpr uint8_t LFU_INIT_VAL = 5; // new keys start here so they aren't evicted before a second access
+
+uint64_t access_clock();
+
+inline uint32_t access_idle_seconds(uint64_t access, uint64_t clock){
+    return (static_cast<uint32_t>(clock) - static_cast<uint32_t>(access)) & ACCESS_CLOCK_MASK;
+}
+
+// What LRU ranks by: idle seconds to the millisecond. Stamped a few ms after clock was
+// read (by another thread) counts as not idle
+inline uint64_t access_idle_ms(uint64_t access, uint64_t clock){
+    int64_t ms = int64_t(access_idle_seconds(access, clock)) * 1000 + int64_t(clock >> 32) - int64_t(access >> 32);
+    return ms > 0 ? ms : 0;
+}
+
+// The access counter as of clock, after its decay
+inline uint8_t access_frequency(uint64_t access, uint64_t clock){
+    uint32_t counter = (access >> 24) & 0xFF;
+    uint32_t idleMinutes = access_idle_seconds(access, clock) / 60;
+    return idleMinutes >= counter ? 0 : counter - idleMinutes;
+}
+
+template <typename T> constexpr ObjType type_of();
+template <> constexpr ObjType type_of<std::string>() { return ObjType::String; }
+template <> constexpr ObjType type_of<int64_t>() { return ObjType::String; }
+template <> constexpr ObjType type_of<List>() { return ObjType::List; }
+template <> constexpr ObjType type_of<ZSet>() { return ObjType::ZSet; }
+template <> constexpr ObjType type_of<Stream>() { return ObjType::Stream; }
+
+template <typename T> constexpr Encoding encoding_of();
+template <> constexpr Encoding encoding_of<std::string>() { return Encoding::Raw; }
+template <> constexpr Encoding encoding_of<int64_t>() { return Encoding::Int; }
+template <> constexpr Encoding encoding_of<List>() { return Encoding::QuickList; }
+template <> constexpr Encoding encoding_of<ZSet>() { return Encoding::Listpack; }
+template <> constexpr Encoding encoding_of<Stream>() { return Encoding::Map; }
+
+const char* type_name(ObjType type);
+
+// What OBJECT ENCODING reports for obj
+const char* encoding_name(const RedisObject& obj);
+
+// Counters behind INFO's expiry fields, bumped by whoever deletes the key
+struct ExpireStats {
+    std::atomic<uint64_t> expiredKeys{0};       // lazily on access or by the active cycle
+    std::atomic<uint64_t> cycles{0};            // active expire cycles run
+    std::atomic<uint64_t> timeCapReached{0};    // cycles that stopped on their time budget
+    std::atomic<uint64_t> cycleMicros{0};       // time spent in active expire cycles
+};
+
+// Every key of every type lives here, so a command resolves its key with one lookup
+// and a key can only ever hold one value.
+//
+// Keys are hash partitioned over STRIPES dicts, each behind its own reader/writer
+// lock. Nothing in here locks: the caller holds a KeyLock on the stripes of every
+// key it touches (the command table takes it from the command's key positions).
+// With a ShardEngine the stripes belong to shard threads instead and KeyLock
+// parks the owning shards rather than taking the stripe locks.
+//
+// Every key with an expiry also sits in its stripe's min-heap of deadlines, which the
+// active expire cycle (expire.h) pops so keys nobody reads again still go away. The
+// heap isn't updated when an expiry is cleared or replaced, entries are checked
+// against the key when they come up and the stale ones dropped.
+class Keyspace {
+public:
+    static constexpr size_t STRIPE_BITS = 6;
+    static constexpr size_t STRIPES = size_t(1) << STRIPE_BITS;
+
+    // Top bits of the hash, the stripe's Dict uses the low ones
+    static size_t stripe_of(std::string_view key){
+        return static_cast<uint64_t>(std::hash<std::string_view>{}(key)) >> (64 - STRIPE_BITS);
+    }
+
+    // nullptr if the key is missing or expired. Expired keys are deleted on the way
+    // when the stripe is write locked, a reader just doesn't see them
+    RedisObject* find(std::string_view key);
+
+    // The key's value if it holds a T. wrongType is set when it holds something else
+    template <typename T>
+    T* lookup(std::string_view key, bool& wrongType){
+        static_assert(!std::is_same_v<T, std::string>, "strings may be int encoded, use lookup_string");
+        wrongType = false;
+        RedisObject* obj = find(key);
+        if (!obj) return nullptr;
+        if (obj->type != type_of<T>()){
+            wrongType = true;
+            return nullptr;
+        }
+        return &obj->as<T>();
+    }
+
+    // The key's object if it holds a string (raw or int encoded)
+    RedisObject* lookup_string(std::string_view key, bool& wrongType){
+        RedisObject* obj = find(key);
+        wrongType = obj && obj->type != ObjType::String;
+        return wrongType ? nullptr : obj;
+    }
+
+    // Like lookup, but creates an empty T when the key is missing
+    template <typename T>
+    T* lookup_or_create(std::string_view key, bool& wrongType){
+        T* value = lookup<T>(key, wrongType);
+        if (value || wrongType) return value;
+        RedisObject& obj = insert(key, T{});
+        return &obj.as<T>();
+    }
+
+    // SET semantics: replaces whatever the key held, ttl of epoch means none. Values
+    // that are integers are stored int encoded
+    RedisObject& set_string(std::string_view key, std::string value, std::chrono::system_clock::time_point ttl = {});
+    RedisObject& set_int(std::string_view key, int64_t value);
+
+    bool erase(std::string_view key);
+
+    // Sets (or with epoch clears) the expiry of obj, which is the value of key
+    void set_expiry(std::string_view key, RedisObject& obj, std::chrono::system_clock::time_point when);
+
+    // Whether the stripe's earliest deadline has passed. Read without the stripe's
+    // lock so idle stripes cost the expire cycle nothing, it is only a hint
+    bool stripe_due(size_t stripe, std::chrono::system_clock::time_point now) const {
+        return stripes[stripe].nextDue.load(std::memory_order_relaxed) <= now.time_since_epoch().count();
+    }
+
+    // Deletes up to limit keys of the stripe whose deadline passed, the caller holds
+    // the stripe exclusively. Returns whether more are due
+    bool expire_due(size_t stripe, std::chrono::system_clock::time_point now, size_t limit);
+
+    ExpireStats& expire_stats(){ return stats; }
+
+    // f(key, obj) on up to count keys of the stripe, scanning from a random start
+    // (with volatileOnly, keys with an expiry). What eviction samples from, so
+    // neighbouring keys are as likely as any others. Needs the stripe locked
+    template <typename F>
+    void sample(size_t stripe, size_t start, size_t count, bool volatileOnly, F f);
+
+    // Changes this thread made to the dataset, like Redis' server.dirty: a write command
+    // that changed nothing (EXPIRE on a missing key, LPOP on an empty list) isn't sent to
+    // replicas. insert, erase and set_expiry count themselves, commands that edit a
+    // value in place call mark_dirty
+    static uint64_t dirty(){ return dirtyCount; }
+    static void mark_dirty(){ dirtyCount++; }
+
+    void set_shards(ShardEngine* engine){ shardEngine = engine; }
+    ShardEngine* shards() const { return shardEngine; }
+
+    size_t size() const { // needs every stripe locked
+        size_t n = 0;
+        for (const Stripe& stripe : stripes) n += stripe.entries.size();
+        return n;
+    }
+
+    template <typename F>
+    void for_each(F f){ // f(const std::string& key, RedisObject& obj) for every live key, needs every stripe locked
+        auto now = std::chrono::system_clock::now();
+        for (Stripe& stripe : stripes){
+            stripe.entries.for_each([&](const std::string& key, RedisObject& obj){
+                if (!obj.expired(now)) f(key, obj);
+            });
+        }
+    }
+
+private:
+    friend class KeyLock;
+
+    using Clock = std::chrono::system_clock;
+
+    struct Deadline {
+        Clock::time_point when;
+        std::string key;
+        bool operator>(const Deadline& other) const { return when > other.when; }
+    };
+
+    struct Stripe {
+        std::shared_mutex lock;
+        Dict<RedisObject> entries;
+        std::vector<Deadline> expires; // min-heap on when
+        std::atomic<Clock::rep> nextDue{Clock::time_point::max().time_since_epoch().count()}; // expires' top
+    };
+
+    template <typename T>
+    RedisObject& insert(std::string_view key, T&& value);
+
+    void index_expiry(Stripe& stripe, std::string_view key, Clock::time_point when);
+    static void update_next_due(Stripe& stripe);
+
+    std::array<Stripe, STRIPES> stripes;
+    ShardEngine* shardEngine = nullptr; // set in --shards mode
+    ExpireStats stats;
+    static thread_local uint64_t dirtyCount;
+};
+
+// Locks the stripes of a set of keys, always in stripe order so two commands
+// touching the same stripes can't deadlock. A stripe is locked exclusively if any
+// key on it is written, shared otherwise. Locks are per thread and not reentrant:
+// while a thread holds one, further KeyLocks on it are no-ops, which is how EXEC
+// takes the locks of all its queued commands once and runs them under that.
+class KeyLock {
+public:
+    explicit KeyLock(Keyspace& db) : db(db) {}
+    KeyLock(const KeyLock&) = delete;
+    KeyLock& operator=(const KeyLock&) = delete;
+    ~KeyLock(){ unlock(); }
+
+    void add(std::string_view key, bool write){
+        uint64_t bit = uint64_t(1) << Keyspace::stripe_of(key);
+        (write ? writeMask : readMask) |= bit;
+    }
+    void add_all(bool write){ (write ? writeMask : readMask) = ~uint64_t(0); }
+    void add_stripe(size_t stripe, bool write){ (write ? writeMask : readMask) |= uint64_t(1) << stripe; }
+    uint64_t stripes() const { return readMask | writeMask; }
+
+    void lock();
+    void unlock();
+
+    // Stripes this thread holds exclusively, find() only expires keys on those
+    static bool write_held(size_t stripe){ return heldWrite >> stripe & 1; }
+    // True inside EXEC: blocking commands must not wait there, nobody else can get at the keys
+    static bool any_held(){ return heldRead || heldWrite; }
+
+private:
+    static_assert(Keyspace::STRIPES <= 64, "stripe sets are 64 bit masks");
+
+    Keyspace& db;
+    uint64_t readMask = 0;
+    uint64_t writeMask = 0;
+    bool locked = false;
+    bool parked = false; // shards parked for us in --shards mode
+    static thread_local uint64_t heldRead;
+    static thread_local uint64_t heldWrite;
+};
+
+template <typename T>
+RedisObject& Keyspace::insert(std::string_view key, T&& value){
+    using V = std::remove_cvref_t<T>;
+    dirtyCount++;
+    return stripes[stripe_of(key)].entries.insert_or_assign(key,
+        RedisObject{type_of<V>(), encoding_of<V>(), std::forward<T>(value), {}, uint64_t(LFU_INIT_VAL) << 24 | access_clock()});
+}
+
+template <typename F>
+void Keyspace::sample(size_t s, size_t start, size_t count, bool volatileOnly, F f){
+    Stripe& stripe = stripes[s];
+    if (!volatileOnly){
+        stripe.entries.sample(start, count, f);
+        return;
+    }
+    // The deadline heap holds every volatile key, plus stale entries for keys deleted
+    // or persisted since, so look at a few times count entries at most
+    auto& heap = stripe.expires;
+    size_t budget = std::min(heap.size(), count * 4);
+    for (size_t i = 0; i < budget && count; i++){
+        const Deadline& due = heap[(start + i) % heap.size()];
+        RedisObject* obj = stripe.entries.find(due.key);
+        if (!obj || obj->expiry != due.when) continue;
+        f(due.key, *obj);
+        count--;
+    }
+}
+
+#endif
@@ -1,20 +1,38 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include "resp.h"
+#include "keyspace.h"
+#include "client.h"
 #include <string>
-#include <vector>
-#include <map>
 
-std::string rpush_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict);
+std::string rpush_command(ClientState& client, const Argv& argv, Keyspace& db);
 
-std::string lrange_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict);
+std::string lrange_command(const Argv& argv, Keyspace& db);
 
-std::string lpush_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict);
+std::string lpush_command(ClientState& client, const Argv& argv, Keyspace& db);
 
-std::string llen_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict);
+std::string llen_command(const Argv& argv, Keyspace& db);
 
-std::string lpop_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict);
+std::string lpop_command(const Argv& argv, Keyspace& db);
 
-std::string blpop_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict);
+// BLPOP, BRPOP and BLMOVE park the client when their keys are empty, see blocking.h
+std::string blpop_command(ClientState& client, const Argv& argv, Keyspace& db);
+
+std::string rpop_command(const Argv& argv, Keyspace& db);
+
+std::string lindex_command(const Argv& argv, Keyspace& db);
+
+std::string lset_command(const Argv& argv, Keyspace& db);
+
+std::string linsert_command(ClientState& client, const Argv& argv, Keyspace& db);
+
+std::string ltrim_command(const Argv& argv, Keyspace& db);
+
+std::string lmove_command(ClientState& client, const Argv& argv, Keyspace& db);
+
+std::string brpop_command(ClientState& client, const Argv& argv, Keyspace& db);
+
+std::string blmove_command(ClientState& client, const Argv& argv, Keyspace& db);
 
 #endif
\ No newline at end of file
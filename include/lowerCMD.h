@@ -2,7 +2,8 @@
 #define LOWERCMD_H
 
 #include <string>
+#include <string_view>
 
-std::string lowercase_command(std::string cmd);
+std::string lowercase_command(std::string_view cmd);
 
-#endif
\ No newline at end of file
+#endif
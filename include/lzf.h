@@ -0,0 +1,16 @@
+#ifndef LZF_H
+#define LZF_H
+
+#include <cstddef>
+
+// LZF, the byte-oriented LZ77 variant Redis compresses list nodes and RDB strings
+// with: runs of up to 32 literals and back references of up to 264 bytes within the
+// last 8 KB. Fast rather than tight, and the same format as liblzf.
+
+// Compresses into out, returns the compressed size or 0 if it doesn't fit in outLen
+size_t lzf_compress(const char* in, size_t inLen, char* out, size_t outLen);
+
+// Returns the decompressed size, or 0 if the input is corrupt or doesn't fit in outLen
+size_t lzf_decompress(const char* in, size_t inLen, char* out, size_t outLen);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <cstddef>
+
+// Bytes currently allocated through operator new, what maxmemory is checked
+// against (Redis' used_memory). Every key, value, dict table and connection
+// buffer is counted as it is allocated, using the allocator's real block size.
+size_t used_memory();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <chrono>
+
+// Replies for one connection, kept as a list of chunks so a flush is a single writev
+// and a large reply never has to be copied into one contiguous string
+class OutputBuffer {
+public:
+    static constexpr size_t CHUNK = 16 * 1024;
+
+    OutputBuffer& operator+=(std::string_view data) { append(data); return *this; }
+    void append(std::string_view data);
+    void append(OutputBuffer&& other);
+
+    bool empty() const { return bytes == 0; }
+    size_t size() const { return bytes; }
+    const std::vector<std::string>& chunks() const { return blocks; }
+    void clear();
+
+    // Blocking writev until everything is written, false if the socket failed
+    bool write_to(int fd);
+
+private:
+    std::vector<std::string> blocks;
+    size_t bytes = 0;
+};
+
+// client-output-buffer-limit <hard> <soft> <soft seconds>, 0 turns a limit off
+struct OutputLimit {
+    size_t hard = 0;
+    size_t soft = 0;
+    int softSeconds = 0;
+};
+
+// "32mb": a byte count with an optional kb/mb/gb suffix
+size_t parse_size(const std::string& s);
+
+// Parses "32mb 8mb 60", sizes take an optional kb/mb/gb suffix
+OutputLimit parse_output_limit(const std::string& spec);
+
+// True once `used` is over the hard limit, or has stayed over the soft limit for softSeconds.
+// softSince remembers when the soft limit was first crossed
+bool over_output_limit(size_t used, const OutputLimit& limit, std::chrono::steady_clock::time_point& softSince);
+
+// Messages pushed to a connection by other connections (PUBLISH), the owning
+// I/O loop moves them into its own buffer when wake() tells it to flush
+struct PushQueue {
+    std::mutex mutex;
+    OutputBuffer pending;
+    std::function<void()> wake; // set by the I/O backend, called with mutex held
+    std::chrono::steady_clock::time_point softSince{};
+    bool dropped = false; // went over the pubsub limit, connection is being shut down
+};
+
+#endif
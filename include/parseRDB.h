@@ -1,11 +1,12 @@
 #ifndef PARSERDB_H
 #define PARSERDB_H
 
+#include "keyspace.h"
 #include <string>
 #include <chrono>
 #include <map>
 #include <fstream>
 
-int parse_rdbFile( std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict, std::string filepath);
+int parse_rdbFile(Keyspace& db, std::string filepath);
 
 #endif
\ No newline at end of file
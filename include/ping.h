@@ -1,8 +1,9 @@
 #ifndef PING_H
 #define PING_H
 
+#include "resp.h"
 #include <string>
 
-std::string ping_command(int& items, int client_fd, std::string& read_buffer);
+std::string ping_command(const Argv& argv);
 
-#endif
\ No newline at end of file
+#endif
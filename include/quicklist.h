@@ -0,0 +1,120 @@
+#ifndef QUICKLIST_H
+#define QUICKLIST_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// A list value, laid out like Redis' quicklist: a doubly linked list of nodes, each
+// holding up to NODE_BYTES of elements packed back to back. Pushes and pops at
+// either end touch only the end node, so they're O(1) however long the list is,
+// and a million short elements cost a few hundred allocations instead of a million.
+//
+// An element is packed as <length varint><bytes><back length>, where the back length
+// is the size of the first two written so it can be read from its last byte. That
+// lets a node be walked from either end, like a listpack.
+//
+// With a compress depth of N (--list-compress-depth), every node more than N nodes
+// away from both ends is kept LZF compressed, as Redis does. The ends, where queues
+// push and pop, always stay plain. 0, the default, compresses nothing.
+class QuickList {
+public:
+    static constexpr size_t NODE_BYTES = 8192; // like list-max-listpack-size -2
+
+    QuickList() = default;
+    QuickList(QuickList&& other) noexcept;
+    QuickList& operator=(QuickList&& other) noexcept;
+    QuickList(const QuickList&) = delete;
+    QuickList& operator=(const QuickList&) = delete;
+    ~QuickList(){ clear(); }
+
+    static void set_compress_depth(int depth);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t node_count() const { return nodes; }
+
+    void push_front(std::string_view value);
+    void push_back(std::string_view value);
+    // The list must not be empty
+    std::string pop_front();
+    std::string pop_back();
+
+    // Indexes are 0 based from the head, already range checked by the caller
+    std::string at(size_t index) const;
+    void set(size_t index, std::string_view value);
+    // Inserts next to the first element equal to pivot, false if there is none
+    bool insert(std::string_view pivot, std::string_view value, bool after);
+    // Drops n elements from one end
+    void erase_front(size_t n);
+    void erase_back(size_t n);
+    void clear();
+
+    // f(std::string_view) on up to n elements starting at index start
+    template <typename F>
+    void for_range(size_t start, size_t n, F f) const {
+        if (start >= count) return;
+        size_t skip;
+        const Node* node = seek(start, skip);
+        std::string scratch;
+        for (; node && n; node = node->next){
+            std::string_view data = packed(node, scratch);
+            const char* p = data.data();
+            for (uint32_t i = 0; i < node->count && n; i++){
+                size_t bytes;
+                std::string_view element = decode(p, bytes);
+                p += bytes;
+                if (i < skip) continue;
+                f(element);
+                n--;
+            }
+            skip = 0;
+        }
+    }
+
+private:
+    struct Node {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        std::string data;      // packed elements, LZF compressed while `compressed`
+        uint32_t count = 0;    // elements
+        uint32_t rawSize = 0;  // packed size while compressed
+        bool compressed = false;
+    };
+
+    // The element at p and its packed size
+    static std::string_view decode(const char* p, size_t& bytes){
+        size_t len = 0;
+        size_t header = 0;
+        for (unsigned shift = 0;; shift += 7){
+            uint8_t b = p[header++];
+            len |= size_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+        size_t back = header + len;
+        bytes = back + 1;
+        while (back >>= 7) bytes++;
+        return std::string_view(p + header, len);
+    }
+
+    // The node holding element index and the element's position in it
+    const Node* seek(size_t index, size_t& offset) const;
+    Node* seek(size_t index, size_t& offset);
+    // A node's packed bytes, decompressed into scratch if it has to be
+    std::string_view packed(const Node* node, std::string& scratch) const;
+
+    Node* insert_node(Node* prev, Node* next);
+    void unlink(Node* node);
+    Node* split_if_needed(Node* node); // returns the new second half, if any
+    void compress(Node* node);
+    void decompress(Node* node);
+    void settle(Node* touched); // restores the compress depth invariant after a change
+
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    size_t count = 0;  // elements
+    size_t nodes = 0;
+};
+
+#endif
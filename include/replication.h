@@ -0,0 +1,29 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "client.h"
+#include <string>
+
+// Replaces what replicas get for the running command, for commands that wouldn't
+// replay the same there: XADD * gets the ID it generated, relative expiries become
+// absolute times
+void rewrite_command(ClientState& client, std::vector<std::string> argv);
+
+// Queues a write the running command made on the side (the pop of a parked BLPOP it
+// served), sent to replicas after the command itself
+void also_propagate(ClientState& client, const Argv& argv);
+
+// Called once a write command ran. Sends it, as rewritten if it was, to every connected
+// replica if it changed the dataset, then whatever it queued with also_propagate, and
+// advances the client's replication offset
+void propagate_command(ClientState& client, const Argv& argv, bool changed);
+
+std::string replconf_command(ClientState& client, const Argv& argv);
+
+// Registers the connection as a replica and returns FULLRESYNC followed by an empty RDB
+std::string psync_command(ClientState& client, const Argv& argv);
+
+// Blocks until enough replicas acked the client's offset, or the timeout runs out
+std::string wait_command(ClientState& client, const Argv& argv);
+
+#endif
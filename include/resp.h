@@ -0,0 +1,32 @@
+#ifndef RESP_H
+#define RESP_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Command arguments, argv[0] is the command name. The views point into the
+// connection's read buffer and are only valid until the next read is appended
+using Argv = std::vector<std::string_view>;
+
+enum class ParseStatus {
+    Ok,
+    Incomplete, // need more bytes, nothing was consumed
+    Error
+};
+
+// Walks a read cursor over the connection buffer, one command per call. Nothing is
+// copied or erased while parsing, so a pipeline of N commands costs O(total bytes);
+// the consumed prefix is dropped once per batch with compact()
+struct RespParser {
+    size_t cursor = 0;
+    std::string error;
+
+    ParseStatus next(const std::string& buffer, Argv& argv);
+    void compact(std::string& buffer);
+};
+
+// Encodes argv back into a RESP array, used to propagate writes to replicas
+std::string encode_command(const Argv& argv);
+
+#endif
@@ -1,48 +1,293 @@
 #ifndef SET_H
 #define SET_H
 
+#include "resp.h"
+#include "dict.h"
+#include <memory>
 #include <string>
-#include <set>
+#include <string_view>
+#include <type_traits>
 #include <vector>
-#include <chrono>
-#include <map>
 
+#include <cstddef>
 #include <cstdint>
 
+class Keyspace;
+
+// One allocation per member: this header, then `height` levels, then the member's
+// bytes. The member index keys on those bytes, so they are never copied.
 struct Node {
+    // level(i).span is how many level 0 steps level(i).forward is ahead, so ranks add
+    // up along a search path (from the last node, it counts to the end of the list)
+    struct Level {
+        Node* forward;
+        size_t span;
+    };
+
     double score;
-    std::string key;
-    std::vector<Node*> forward; // forward[i] points to next node at level i
+    Node* backward;  // previous on level 0, null for the first
+    uint32_t length; // member bytes
+    uint8_t height;
+
+    static Node* create(int height, double score, std::string_view member);
+    static void destroy(Node* node);
+
+    Level& level(int i){ return reinterpret_cast<Level*>(this + 1)[i]; }
+    const Level& level(int i) const { return reinterpret_cast<const Level*>(this + 1)[i]; }
+    std::string_view key() const {
+        return std::string_view(reinterpret_cast<const char*>(&level(height)), length);
+    }
+    Node* next() const { return level(0).forward; }
+    Node* prev() const { return backward; }
+};
+
+// A sorted set past the packed limits, as in Redis: a skiplist ordered by (score, member) with span counts
+// on every link, plus a hash from member to node. ZSCORE and duplicate checks go
+// through the hash; ZRANK and ZRANGE by index walk the levels adding up spans.
+//
+// A node gets each level past the first with probability 1/4, like Redis. The head has
+// as many levels as the set's size calls for (about log4 of it) and grows with the set,
+// up to LEVEL_LIMIT, so a 10 member set doesn't carry 32 head pointers and a 5M one
+// isn't stuck with a handful of levels.
+class SkipList {
+public:
+    static constexpr int LEVEL_LIMIT = 32;
+
+    SkipList();
+
+    // Owns its nodes, so it can be moved into the keyspace but not copied
+    SkipList(SkipList&& other) noexcept
+        : maxLevel(other.maxLevel), levels(other.levels), head(other.head), tail(other.tail),
+          length(other.length), members(std::move(other.members)) {
+        other.head = other.tail = nullptr;
+        other.length = 0;
+    }
+    SkipList& operator=(SkipList&& other) noexcept {
+        if (this != &other){
+            clear();
+            maxLevel = other.maxLevel; levels = other.levels;
+            head = other.head; tail = other.tail; length = other.length;
+            members = std::move(other.members);
+            other.head = other.tail = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    ~SkipList() { clear(); }
+
+    size_t size() const { return length; }
+    Node* first() const { return head->level(0).forward; }
+    Node* last() const { return tail; }
+
+    Node* find(std::string_view member){
+        Node** node = members.find(member);
+        return node ? *node : nullptr;
+    }
+    // member must not be in the set yet
+    Node* insert(double score, std::string_view member);
+    // Moves node to its place for the new score
+    void update_score(Node* node, double score);
+    bool erase(std::string_view member);
+
+    // 0 based, from the lowest score
+    size_t rank_of(const Node* node) const;
+    Node* at_rank(size_t rank) const;
+
+    // How many nodes from the first satisfy below(node), which must hold for a prefix
+    // of the set (score under a bound, say). One walk down the levels adding up spans
+    template <typename Below>
+    size_t count_while(Below below) const {
+        size_t count = 0;
+        const Node* x = head;
+        for (int i = levels - 1; i >= 0; i--) {
+            while (x->level(i).forward && below(x->level(i).forward)) {
+                count += x->level(i).span;
+                x = x->level(i).forward;
+            }
+        }
+        return count;
+    }
+
+    // Removes the nodes ranked first..last (0 based, inclusive, in range): each level's
+    // links are spliced past the whole run once, then the nodes are freed
+    void erase_ranks(size_t first, size_t last);
+
+    void clear();
+
+private:
+    // The last node before (score, member) on every level, and its rank
+    void find_update(double score, std::string_view member, Node** update, size_t* rank) const;
+    void link(Node* node, Node** update, size_t* rank);
+    void unlink(Node* node, Node** update);
+    void grow_head(int height);
+
+    int maxLevel;   // the head's height, the most a node gets
+    int levels = 1; // levels in use
+    Node* head;     // sentinel
+    Node* tail = nullptr;
+    size_t length = 0;
+    Dict<Node*, std::string_view> members;
+};
+
+// A small sorted set packed into one buffer, like Redis' listpack encoding: entries
+// sorted by (score, member), each <score, 8 bytes><member length varint><member bytes>.
+// Everything is a scan from the front, which for a few dozen members beats chasing
+// node pointers, and the whole set is a single allocation with no per-member overhead.
+class ZSetPack {
+public:
+    static constexpr size_t npos = size_t(-1);
 
-    Node(double s, std::string k, int level) : score(s), key(k), forward(level, nullptr) {}
+    struct Entry {
+        double score;
+        std::string_view member;
+        size_t next; // offset of the following entry, bytes() after the last
+    };
+
+    size_t size() const { return count; }
+    size_t bytes() const { return data.size(); }
+    Entry entry(size_t offset) const;
+    // Offset of member's entry, npos if it isn't there
+    size_t find(std::string_view member) const;
+    // Offset of the entry ranked rank, in range
+    size_t seek(size_t rank) const;
+
+    // member must not be in the set yet
+    void insert(double score, std::string_view member);
+    void erase_at(size_t offset);
+    // 0 based, inclusive, in range
+    void erase_ranks(size_t first, size_t last);
+
+private:
+    std::vector<char> data; // grown to fit exactly, ZADD after ZREM reuses the slack
+    uint32_t count = 0;
 };
 
-struct SkipList {
-    int maxLevel;
-    float p; // probability for promotion (e.g. 0.5)
-    int currentLevel;
-    Node* head;
-    int size;
-
-    SkipList(int maxL, float prob)
-        : maxLevel(maxL), p(prob), currentLevel(0),
-          head(new Node(-1, "", maxL + 1)), size(0) {} // sentinel head
-        
-    SkipList()
-        : maxLevel(5), p(0.5),  currentLevel(0),
-          head(new Node(-1, "", 6)), size(0) {}
+// A sorted set's value: packed while it is small, converted for good to a SkipList
+// once it has more than zset-max-listpack-entries members or a member longer than
+// zset-max-listpack-value bytes. Members are handed out as (score, member) pairs so
+// commands don't care which form they get.
+class ZSet {
+public:
+    // --zset-max-listpack-entries / --zset-max-listpack-value, set once at startup
+    static void set_packed_limits(size_t entries, size_t value);
+
+    bool packed() const { return !list; }
+    const char* encoding_name() const { return packed() ? "listpack" : "skiplist"; }
+    size_t size() const { return packed() ? pack.size() : list->size(); }
+
+    // False if member isn't in the set
+    bool score(std::string_view member, double& score) const;
+    bool rank(std::string_view member, size_t& rank) const;
+
+    // member must not be in the set yet
+    void insert(double score, std::string_view member);
+    // member must be in the set
+    void update(std::string_view member, double score);
+    bool erase(std::string_view member);
+    // 0 based, inclusive, in range
+    void erase_ranks(size_t first, size_t last);
+
+    // How many members from the first satisfy below(score, member), which must hold
+    // for a prefix of the set
+    template <typename Below>
+    size_t count_while(Below below) const {
+        if (list) return list->count_while([&](const Node* n){ return below(n->score, n->key()); });
+        size_t count = 0;
+        for (size_t at = 0; at < pack.bytes(); count++) {
+            ZSetPack::Entry e = pack.entry(at);
+            if (!below(e.score, e.member)) break;
+            at = e.next;
+        }
+        return count;
+    }
+
+    // f(score, member) on the n members from rank first up, or down with rev. In range.
+    // An f that returns bool stops the walk by returning false
+    template <typename F>
+    void for_range(size_t first, size_t n, bool rev, F f) const {
+        if (n == 0) return;
+        if (list) {
+            Node* node = list->at_rank(first);
+            for (size_t i = 0; i < n; i++, node = rev ? node->prev() : node->next()) {
+                if (!visit(f, node->score, node->key())) return;
+            }
+            return;
+        }
+        // Entries only walk forwards: from the lowest rank, backwards through their offsets
+        size_t at = pack.seek(rev ? first + 1 - n : first);
+        if (!rev) {
+            for (size_t i = 0; i < n; i++) {
+                ZSetPack::Entry e = pack.entry(at);
+                if (!visit(f, e.score, e.member)) return;
+                at = e.next;
+            }
+            return;
+        }
+        std::vector<size_t> offsets(n);
+        for (size_t i = 0; i < n; i++) {
+            offsets[i] = at;
+            at = pack.entry(at).next;
+        }
+        for (size_t i = n; i-- > 0;) {
+            ZSetPack::Entry e = pack.entry(offsets[i]);
+            if (!visit(f, e.score, e.member)) return;
+        }
+    }
+
+    // for_range over the members scored in [min, max), in order
+    template <typename F>
+    void for_scores(double min, double max, F f) const {
+        size_t lo = count_while([&](double score, std::string_view){ return score < min; });
+        size_t hi = count_while([&](double score, std::string_view){ return score < max; });
+        if (hi > lo) for_range(lo, hi - lo, false, f);
+    }
+
+private:
+    template <typename F>
+    static bool visit(F& f, double score, std::string_view member){
+        if constexpr (std::is_void_v<decltype(f(score, member))>) {
+            f(score, member);
+            return true;
+        } else {
+            return f(score, member);
+        }
+    }
+
+    void convert();
+
+    ZSetPack pack;
+    std::unique_ptr<SkipList> list; // null while packed
 };
 
-std::string zadd_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets);
+std::string zadd_command(const Argv& argv, Keyspace& db);
+
+std::string zrank_command(const Argv& argv, Keyspace& db);
+
+// ZRANGE key start stop [BYSCORE | BYLEX] [REV] [LIMIT offset count] [WITHSCORES]
+std::string zrange_command(const Argv& argv, Keyspace& db);
+
+std::string zrangebyscore_command(const Argv& argv, Keyspace& db);
+
+std::string zrevrangebyscore_command(const Argv& argv, Keyspace& db);
+
+std::string zrangebylex_command(const Argv& argv, Keyspace& db);
+
+std::string zcount_command(const Argv& argv, Keyspace& db);
+
+std::string zlexcount_command(const Argv& argv, Keyspace& db);
 
-std::string zrank_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets);
+// Both unlink the whole range in one pass
+std::string zremrangebyscore_command(const Argv& argv, Keyspace& db);
 
-std::string zrange_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets);
+std::string zremrangebyrank_command(const Argv& argv, Keyspace& db);
 
-std::string zcard_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets);
+std::string zcard_command(const Argv& argv, Keyspace& db);
 
-std::string zscore_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets);
+std::string zscore_command(const Argv& argv, Keyspace& db);
 
-std::string zrem_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets);
+std::string zrem_command(const Argv& argv, Keyspace& db);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,14 +1,24 @@
 #ifndef SETGET_H
 #define SETGET_H
 
+#include "resp.h"
+#include "keyspace.h"
+#include "client.h"
 #include <string>
 #include <map>
 #include <tuple>
 #include <chrono>
 
-std::string set_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict);
+// SET key value [EX s | PX ms | EXAT s | PXAT ms | KEEPTTL]. Replicas get a relative
+// expiry as PXAT, so they expire the key when the master does
+std::string set_command(ClientState& client, const Argv& argv, Keyspace& db);
 
-std::string get_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict);
+std::string get_command(const Argv& argv, Keyspace& db);
+
+// Values of several keys, nil for missing keys and keys that aren't strings
+std::string mget_command(const Argv& argv, Keyspace& db);
+
+// Appends to a string value (creating it), returns the new length
+std::string append_command(const Argv& argv, Keyspace& db);
 
-void set_propogated(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict);
 #endif
\ No newline at end of file
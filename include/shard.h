@@ -0,0 +1,89 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "spscQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Shared-nothing execution (--shards N): the keyspace's stripes are dealt out to N
+// threads, each pinned to a core, and a stripe is only ever touched by the thread
+// that owns it, so there are no locks and no shared cache lines on the data path.
+//
+// A command whose keys all live on one shard is handed to that shard over an SPSC
+// ring (one ring per sending thread and shard) and the sender waits for the reply.
+// A command spanning several shards (MGET, EXEC, XREAD over many streams, KEYS) is
+// coordinated instead: a barrier is scattered to every shard involved, and once all
+// of them have parked on it (the gather) the sender runs the command itself and
+// releases them. Coordinators take turns, so barriers reach every shard in the same
+// order and two multi-shard commands can't each wait on a shard the other parked.
+class ShardEngine {
+public:
+    explicit ShardEngine(size_t shards);
+    ShardEngine(const ShardEngine&) = delete;
+    ShardEngine& operator=(const ShardEngine&) = delete;
+
+    void start(); // spawns and pins the shard threads
+
+    size_t count() const { return shards.size(); }
+    size_t owner_of_stripe(size_t stripe) const { return stripe % shards.size(); }
+
+    // The only shard owning every stripe in the mask, -1 if there are several (or none)
+    int single_owner(uint64_t stripes) const;
+
+    // Runs f on shard s and waits for it, exceptions come back to the caller
+    template <typename F>
+    void run_on(size_t s, F& f){
+        Task task;
+        task.call = [](void* arg){ (*static_cast<F*>(arg))(); };
+        task.arg = &f;
+        submit(s, task);
+        wait(task);
+    }
+
+    // Parks every shard owning one of the stripes, so the calling thread can use them.
+    // A shard thread calling this for its own stripes doesn't park anything.
+    // Returns whether release() must follow.
+    bool acquire(uint64_t stripes);
+    void release();
+
+    // Set on shard threads, -1 elsewhere
+    static int current_shard(){ return currentShard; }
+
+private:
+    struct Task {
+        void (*call)(void*) = nullptr; // nullptr means a barrier
+        void* arg = nullptr;
+        std::exception_ptr error;
+        std::atomic<uint32_t> state{0}; // see the TASK_ constants in shard.cpp
+    };
+    using Ring = SpscQueue<Task*, 64>;
+
+    struct Shard {
+        std::thread thread;
+        std::mutex producersMutex; // only taken when a thread sends to this shard for the first time or exits
+        std::vector<std::shared_ptr<Ring>> producers;
+        std::atomic<uint64_t> producersVersion{0};
+        std::atomic<bool> sleeping{false};
+        std::atomic<uint32_t> doorbell{0};
+    };
+
+    void submit(size_t s, Task& task);
+    void wait(Task& task);
+    void run_shard(size_t s);
+    Ring& ring_to(size_t s);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::mutex coordinator;            // one multi-shard command at a time
+    std::vector<Task> barriers;        // the current coordinator's barrier per shard
+    std::vector<size_t> parked;        // shards the current coordinator parked
+    static thread_local int currentShard;
+};
+
+#endif
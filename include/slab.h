@@ -0,0 +1,42 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Size class slab allocator behind operator new (memoryUsage.cpp) for blocks up to
+// 512 bytes: every key, small value, list element, skiplist node and stream entry.
+//
+// Objects of one size class are carved out of 64 KB slabs, so a freed object is
+// reused by the next allocation of the same class instead of leaving a hole that
+// only fits smaller requests. Slabs come out of one reserved address range, which
+// is how slab_free tells its blocks from malloc's and finds their class without a
+// header. Each thread keeps a small cache of free objects per class and only takes
+// the class lock to move a batch in or out, so the common path is lock free.
+constexpr size_t SLAB_CLASSES = 16;
+constexpr size_t SLAB_MAX_SIZE = 512;
+constexpr size_t SLAB_BYTES = 64 * 1024;
+
+// nullptr when size is over SLAB_MAX_SIZE or the slab range is used up, use malloc then
+void* slab_alloc(size_t size);
+// True (and the block freed) if p came from slab_alloc
+bool slab_free(void* p);
+// The class size a slab block was rounded up to, 0 if p isn't a slab block
+size_t slab_usable_size(const void* p);
+
+struct SlabClassStats {
+    size_t size;   // bytes per object
+    size_t slabs;  // 64 KB slabs carved for this class
+    size_t used;   // objects handed out, live or waiting in a thread's cache
+};
+
+struct SlabStats {
+    std::array<SlabClassStats, SLAB_CLASSES> classes;
+    size_t reserved; // bytes in slabs
+    size_t used;     // bytes handed out (class sizes)
+};
+
+SlabStats slab_stats();
+
+#endif
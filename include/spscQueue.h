@@ -0,0 +1,49 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+// Bounded single producer / single consumer ring. push and pop are wait free:
+// each side only writes its own index, and the two indexes sit on separate
+// cache lines so producer and consumer don't bounce one line between cores.
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+public:
+    bool push(const T& value){ // producer thread only, false when full
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache == N){
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache == N) return false;
+        }
+        slots[t & (N - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value){ // consumer thread only, false when empty
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache){
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache) return false;
+        }
+        value = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0}; // next slot to pop, written by the consumer
+    size_t tailCache = 0;                    // consumer's last view of tail
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to push, written by the producer
+    size_t headCache = 0;                    // producer's last view of head
+    alignas(64) std::array<T, N> slots{};
+};
+
+#endif
@@ -1,25 +1,138 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include "resp.h"
+#include <algorithm>
+#include <compare>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
-#include <tuple>
-#include <chrono>
 
-struct Stream {
-    std::map<std::string, std::vector<std::pair<std::string, std::string>>> entries;
-    std::string lastID;
+class Keyspace;
+struct ClientState;
+
+// An entry ID, "<ms>-<seq>", kept as two integers so 10-0 sorts after 9-0 and
+// comparing two is two integer compares
+struct StreamID {
+    uint64_t ms = 0;
+    uint64_t seq = 0;
+
+    auto operator<=>(const StreamID&) const = default;
+    std::string str() const { return std::to_string(ms) + "-" + std::to_string(seq); }
+};
+
+// "<ms>-<seq>", or just "<ms>" with missingSeq as the sequence. False if malformed
+bool parse_stream_id(std::string_view text, StreamID& id, uint64_t missingSeq);
+
+// An entry as read back: field / value views into its node
+struct StreamEntry {
+    StreamID id;
+    std::vector<std::pair<std::string_view, std::string_view>> fields;
+};
+
+// A run of consecutive entries packed into one buffer, like the listpacks in Redis'
+// stream nodes. The buffer starts with the master entry's field names (the node's first
+// entry), then each entry is
+//     <flags><ms - master ms><seq delta>[<field count><name value>...]|[<value>...]
+// where numbers are LEB128 varints and strings a varint length then the bytes. The seq
+// delta is from the master's seq within the master's millisecond, the seq itself after.
+// An entry with the master's field names (SAME_FIELDS) stores just its values, so a
+// stream of identical records pays for its field names once per node.
+class StreamNode {
+public:
+    // Writes the master fields and the first entry. fields holds n name, value pairs
+    StreamNode(StreamID id, const std::string_view* fields, size_t n);
+
+    StreamID master_id() const { return master; }
+    StreamID last_id() const { return last; }
+    size_t size() const { return count; }
+    size_t first_offset() const { return entriesAt; }
+    size_t bytes() const { return data.size(); }
+
+    // Appends unless the node already holds maxEntries or would grow past maxBytes
+    // (0 is no limit). id must be past last_id()
+    bool append(StreamID id, const std::string_view* fields, size_t n, size_t maxBytes, size_t maxEntries);
+    // Decodes the entry at offset into entry, returns the next entry's offset
+    size_t read(size_t offset, StreamEntry& entry) const;
+    // No more appends: drops the growth slack
+    void seal(){ data.shrink_to_fit(); }
+
+private:
+    void encode(StreamID id, const std::string_view* fields, size_t n, std::vector<char>& out) const;
+
+    StreamID master;
+    StreamID last;
+    uint32_t count = 0;
+    uint32_t masterFields = 0;
+    uint32_t entriesAt = 0; // past the master field names
+    std::vector<char> data;
 };
 
-std::string xadd_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict,
-    std::map<std::string, Stream>& sDict);
+// A stream's entries, in StreamNodes of up to stream-node-max-entries entries and
+// stream-node-max-bytes bytes. Redis finds nodes through a radix tree of master IDs;
+// entries here only ever append, so the nodes sit in a vector already sorted by master
+// ID and a seek is a binary search over it, with no tree nodes to pay for.
+class Stream {
+public:
+    // --stream-node-max-bytes / --stream-node-max-entries, set once at startup
+    static void set_node_limits(size_t bytes, size_t entries);
+
+    size_t size() const { return length; }
+    StreamID last_id() const { return lastID; }
+    size_t node_count() const { return nodes.size(); }
+
+    // fields holds n name, value pairs. id must be past last_id()
+    void append(StreamID id, const std::string_view* fields, size_t n);
+
+    // f(entry) on the entries from the first at or after from, or with rev from the
+    // last at or before it backwards, until f returns false
+    template <typename F>
+    void walk(StreamID from, bool rev, F f) const {
+        // Past the last node whose master is at most from
+        auto it = std::upper_bound(nodes.begin(), nodes.end(), from,
+                                   [](StreamID id, const StreamNode& node){ return id < node.master_id(); });
+        StreamEntry entry;
+        if (!rev) {
+            for (size_t i = it == nodes.begin() ? 0 : it - nodes.begin() - 1; i < nodes.size(); i++) {
+                const StreamNode& node = nodes[i];
+                if (node.last_id() < from) continue;
+                for (size_t at = node.first_offset(); at < node.bytes();) {
+                    at = node.read(at, entry);
+                    if (entry.id >= from && !f(entry)) return;
+                }
+            }
+            return;
+        }
+        // Entries only decode forwards: collect a node's offsets, then go back through them
+        std::vector<size_t> offsets;
+        for (size_t i = it - nodes.begin(); i-- > 0;) {
+            const StreamNode& node = nodes[i];
+            offsets.clear();
+            for (size_t at = node.first_offset(); at < node.bytes(); at = node.read(at, entry)) offsets.push_back(at);
+            for (size_t k = offsets.size(); k-- > 0;) {
+                node.read(offsets[k], entry);
+                if (entry.id <= from && !f(entry)) return;
+            }
+        }
+    }
+
+private:
+    std::vector<StreamNode> nodes;
+    size_t length = 0;
+    StreamID lastID;
+};
+
+// Replicas get the ID the entry was added with, not a * that would pick their own
+std::string xadd_command(ClientState& client, const Argv& argv, Keyspace& db);
+
+// XRANGE key start end [COUNT n], XREVRANGE key end start [COUNT n]: both seek to
+// their first entry and stop at the other bound or after n entries
+std::string xrange_command(const Argv& argv, Keyspace& db);
 
-std::string xrange_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, Stream>& sDict);
+std::string xrevrange_command(const Argv& argv, Keyspace& db);
 
-std::string xread_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, Stream>& sDict);
+// XREAD [COUNT n] [BLOCK ms] STREAMS key ... id ...
+std::string xread_command(const Argv& argv, Keyspace& db);
 
-#endif 
\ No newline at end of file
+#endif
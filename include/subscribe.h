@@ -1,19 +1,25 @@
 #ifndef SUBSCRIBE_H
 #define SUBSCRIBE_H
 
+#include "resp.h"
+#include "outputBuffer.h"
 #include <string>
 #include <set>
 #include <vector>
 #include <chrono>
 #include <map>
 
-std::string subscribe_command(int& items, int client_fd, std::string& read_buffer, 
+std::string subscribe_command(const Argv& argv, int client_fd,
     std::map<std::string, std::set<int>>& channels, std::set<std::string>& subbed);
 
-std::string unsubscribe_command(int& items, int client_fd, std::string& read_buffer, 
+std::string unsubscribe_command(const Argv& argv, int client_fd,
     std::map<std::string, std::set<int>>& channels, std::set<std::string>& subbed);
     
-std::string publish_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::set<int>>& channels);
+std::string publish_command(const Argv& argv,
+    std::map<std::string, std::set<int>>& channels, const OutputLimit& limit);
+
+// Drops a closing connection from every channel it subscribed to
+void remove_subscriber(int client_fd,
+    std::map<std::string, std::set<int>>& channels, const std::set<std::string>& subbed);
 
 #endif
\ No newline at end of file
@@ -2,13 +2,14 @@
 #define TYPE_H
 
 #include <string>
-#include "stream.h"
+#include "keyspace.h"
+#include "resp.h"
 #include <map>
 #include <tuple>
 #include <chrono>
 
-std::string type_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict,
-    std::map<std::string, Stream>& sDict);
+std::string type_command(const Argv& argv, Keyspace& db);
+
+std::string object_command(const Argv& argv, Keyspace& db);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef URINGSERVER_H
+#define URINGSERVER_H
+
+#include "client.h"
+
+// True when the kernel has everything the io_uring backend uses (multishot recv,
+// provided buffer rings), otherwise main() falls back to the epoll based asio server
+bool uring_supported();
+
+int run_uring_server(ServerContext& ctx);
+
+#endif
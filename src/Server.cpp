@@ -1,23 +1,13 @@
-#include "bulkString.h"
-#include "clear.h"
-#include "command.h"
+#include "client.h"
+#include "commandTable.h"
+#include "asyncServer.h"
+#include "uringServer.h"
 #include "config.h"
-#include "echo.h"
 #include "lowerCMD.h"
 #include "parseRDB.h"
-#include "ping.h"
-#include "setGet.h"
-#include "keys.h"
-#include "info.h"
-#include "type.h"
-#include "stream.h"
-#include "incr.h"
-#include "list.h"
-#include "subscribe.h"
-#include "set.h"
-#include "geo.h"
-
-#include <mutex>
+#include "shard.h"
+#include "expire.h"
+
 #include <iostream>
 #include <set>
 #include <cstdlib>
@@ -29,6 +19,8 @@
 #include <tuple>
 #include <map>
 #include <chrono>
+#include <memory>
+#include <algorithm>
 #include <fstream>
 #include <unistd.h>
 #include <sys/types.h>
@@ -42,495 +34,66 @@ struct HandshakeResult {
 };
 
 const size_t BUFFER_SIZE = 1024;
-std::vector<int> slaves;
-std::map<int,int> replicaOffsets;
-std::mutex replicaMutex;
-
-using RedisDict = std::map<std::string, std::tuple<std::string, std::chrono::system_clock::time_point>>;
-
-std::string extractArray(std::string& buffer){
-  if (buffer.empty() || buffer[0] != '*') {
-      throw std::runtime_error("Invalid RESP: expected array start '*'");
-  }
-  size_t end = buffer.find("\r\n");
-  if (end == std::string::npos) throw std::runtime_error("Invalid RESP array");
-  int count = std::stoi(buffer.substr(1, end - 1));
-
-  int arrayEnd = end + 2;
-
-  for (int i = 0; i < count; i++) {
-    if (buffer[arrayEnd] != '$') {
-      throw std::runtime_error("Invalid RESP: expected bulk string '$'");
-    }
-
-    end = buffer.find("\r\n", arrayEnd);
-    if (end == std::string::npos) throw std::runtime_error("Invalid RESP: missing CRLF for length");
-    int bulkLen = std::stoi(buffer.substr(arrayEnd + 1, end - (arrayEnd + 1)));
-    arrayEnd = end + 2;
-
-    arrayEnd += bulkLen;
 
-    if (arrayEnd + 2 > buffer.size() || buffer.substr(arrayEnd, 2) != "\r\n") {
-        throw std::runtime_error("Invalid RESP: missing CRLF after bulk string");
-    }
-    arrayEnd += 2;
-  }
-
-  // Extract array
-  std::string firstArray = buffer.substr(0, arrayEnd);
-
-  // Remove it from the buffer
-  buffer.erase(0, arrayEnd);
-
-  return firstArray;
-}
-
-void handle_master(int client_fd, Config config, std::string filepath, RedisDict& dict, std::string initial_buffer = ""){
+void handle_master(int client_fd, ServerContext& ctx, std::string initial_buffer = ""){
   std::string read_buffer = initial_buffer;
   char buffer[BUFFER_SIZE] = {0};
   int offset = 0;
+  RespParser parser;
+  Argv argv;
+  ClientState master; // writes from the master run as this client
+  master.fd = client_fd;
 
   while(true){
-    size_t pos = read_buffer.find("\r\n");
-    if (pos == std::string::npos){
-      ssize_t recieved = recv(client_fd, buffer, sizeof(buffer)-1, 0);
-      if (recieved < 0) {
-        std::cerr << "error\n";
-        break;
-      } else if (recieved == 0) {
-        std::cerr << "master disconnected \n";
-        close(client_fd);
-        break;
-      }   
-      read_buffer.append(buffer, recieved); // Array gonna be like *2\r\n$4\r\ECHO\r\n$5\r\nworld\r\n
-    }
-    
-    std::cout << "handle_master: " << read_buffer << std::endl;
     while (true) {
-      if (read_buffer.empty()) break;
-
-      size_t buffer_start_len = read_buffer.size(); 
-
-      size_t pos = read_buffer.find("\r\n");
-      if (pos == std::string::npos) break;
-      
-      std::string start = read_buffer.substr(0,pos);
-      read_buffer.erase(0, pos + 2);
-      if (start[0]== '*'){  // Array gonna be like $4\r\nECHO\r\n$5\r\nworld\r\n
-        int items = std::stoi(start.substr(1));
-        pos = read_buffer.find("\r\n");
-        std::string indicator = read_buffer.substr(0,pos);
-        read_buffer.erase(0, pos + 2);
-        if (indicator[0] == '$'){ // Array gonna be like ECHO\r\n$5\r\nworld\r\n
-          int strLen = std::stoi(indicator.substr(1,pos-1));
-          std::string bulkString = read_buffer.substr(0, strLen);
-          bulkString = lowercase_command(bulkString);
-          read_buffer.erase(0, strLen + 2);
-          items -= 1;
-          if ( bulkString == "set" ){
-            set_propogated(items, client_fd, read_buffer, dict);
-            offset += buffer_start_len - read_buffer.size();
-          }
-          else if ( bulkString == "ping"){
-            offset += buffer_start_len - read_buffer.size();
-          }
-          else if (bulkString == "replconf"){
-            std::string acks = parsebulkString(items, client_fd, read_buffer);
-            acks = lowercase_command(acks);
-            std::string filler = parsebulkString(items, client_fd, read_buffer);
-            if (acks == "getack" && filler == "*"){
-              std::cout << "Called GetAck " << std::endl;
-              std::string string_offset = std::to_string(offset);
-              std::string response = "*3\r\n$8\r\nREPLCONF\r\n$3\r\nACK\r\n$";
-              response += std::to_string(string_offset.length()) + "\r\n";
-              response += std::to_string(offset) + "\r\n";
-              send(client_fd, response.c_str(), response.size(), 0);
-              clear_array(items,read_buffer);
-              offset += buffer_start_len - read_buffer.size();
-            }
-          }
-          else{
-            std::string response = "-ERR unrecognized command\r\n";
-            send(client_fd, response.c_str(), response.size(), 0);
-            clear_array(items,read_buffer);
-          }
+      size_t commandStart = parser.cursor;
+      ParseStatus status = parser.next(read_buffer, argv);
+      if (status == ParseStatus::Incomplete) break;
+      if (status == ParseStatus::Error){
+        std::cerr << "bad command from master: " << parser.error << "\n";
+        close(client_fd);
+        return;
+      }
+      if (argv.empty()) continue;
+      int commandLen = parser.cursor - commandStart;
+
+      const CommandSpec* spec = lookup_command(argv[0]);
+      if (spec && (spec->flags & CMD_WRITE) && arity_ok(*spec, argv.size())){
+        KeyLock lock(ctx.db);
+        lock_command_keys(lock, *spec, argv);
+        lock.lock();
+        spec->handler(master, ctx, argv); // master does not want the reply
+        master.propagateAs.clear(); // nothing is passed on from a replica
+        master.alsoPropagate.clear();
+      }
+      else if (spec && spec->name == "replconf"){
+        if (argv.size() == 3 && lowercase_command(argv[1]) == "getack" && argv[2] == "*"){
+          std::cout << "Called GetAck " << std::endl;
+          std::string string_offset = std::to_string(offset);
+          std::string response = "*3\r\n$8\r\nREPLCONF\r\n$3\r\nACK\r\n$";
+          response += std::to_string(string_offset.length()) + "\r\n";
+          response += string_offset + "\r\n";
+          send(client_fd, response.c_str(), response.size(), 0);
         }
       }
-      else if (start[0]== '$'){
-          int strLen = std::stoi(start.substr(1,pos));
-          std::string bulkString = read_buffer.substr(0, strLen);
-          read_buffer.erase(0, strLen + 2);
+      else if (!spec || spec->name != "ping"){
+        std::string response = "-ERR unrecognized command\r\n";
+        send(client_fd, response.c_str(), response.size(), 0);
       }
+      offset += commandLen;
     }
-  }
-}
-
-void handle_client(int client_fd, Config config, std::string filepath, RedisDict& dict, 
-  std::map<std::string, Stream>& sDict, std::map<std::string, std::vector<std::string>>&lDict,
-  std::map<std::string, std::set<int>>& channels, std::map<std::string, SkipList>& sets ) {
-
-  int replOffset = 0;
-  std::string read_buffer;
-  char buffer[BUFFER_SIZE] = {0};
-
-  std::set<std::string> subbed;
-  bool subMode = false;
+    parser.compact(read_buffer);
 
-  std::string response = "";
-  std::string tempResponse = "";
-  std::string commandQueue = "";
-  int queuedUp = 0;
-  bool multi = false;
-
-  while(true){
-    ssize_t recieved = recv(client_fd, buffer, sizeof(buffer)-1, 0); // Waiting for client input
+    ssize_t recieved = recv(client_fd, buffer, sizeof(buffer)-1, 0);
     if (recieved < 0) {
       std::cerr << "error\n";
       break;
     } else if (recieved == 0) {
-      std::cerr << "client disconnected \n";
+      std::cerr << "master disconnected \n";
       close(client_fd);
       break;
     }
-    
-    read_buffer.append(buffer, recieved); // Read clients into buffer
-    while (true) {
-      if (read_buffer.empty()) break;
-      size_t pos = read_buffer.find("\r\n");
-      if (pos == std::string::npos) break; // Check there is something to process / not half a command
-
-      std::string prefix = "";
-      if(multi){
-        // If multi, first check if being given discard
-        std::string discardPattern = "*1\r\n$7\r\ndiscard\r\n";
-        if (read_buffer.size() >= discardPattern.size()) {
-          prefix = read_buffer.substr(0,discardPattern.size());
-          prefix = lowercase_command(prefix);
-          if (prefix.compare(0, discardPattern.size(), discardPattern) == 0){ // Discard
-            int indicator = read_buffer.find("\r\n");
-            read_buffer.erase(0, pos + 2);
-            int throwawayItems = 1;
-            clear_array(throwawayItems, read_buffer);
-            multi = false;
-            queuedUp = 0;
-            commandQueue = "";
-            response = "+OK\r\n";
-            send(client_fd, response.c_str(), response.size(), 0);
-            response = "";
-            continue;
-          }
-        }
-      }
-      
-      if(multi){
-        std::string execPattern = "*1\r\n$4\r\nexec\r\n";
-        if (read_buffer.size() >= execPattern.size()) {
-          prefix = read_buffer.substr(0,execPattern.size());
-          prefix = lowercase_command(prefix);
-          if (prefix.compare(0, execPattern.size(), execPattern) != 0){ // Not a exec command so just queue it
-            tempResponse = "+QUEUED\r\n";
-            send(client_fd, tempResponse.c_str(), tempResponse.size(), 0);
-
-            commandQueue += extractArray(read_buffer);
-            queuedUp +=1;
-            continue;
-          }
-        }
-      }
-      
-      std::string start = read_buffer.substr(0,pos); // Get starting identifier from buffer
-      read_buffer.erase(0, pos + 2); 
-      if (start[0]== '*'){  // If input is an array
-
-        int items = std::stoi(start.substr(1)); // How many items are in the array
-        pos = read_buffer.find("\r\n");
-        std::string indicator = read_buffer.substr(0,pos); // What the first item in the array type is
-        read_buffer.erase(0, pos + 2);
-
-        if (indicator[0] == '$'){ // First item is bulk String (only supported type at this time)
-
-          pos = read_buffer.find("\r\n");
-          std::string bulkString = read_buffer.substr(0,pos);
-          bulkString = lowercase_command(bulkString);
-          read_buffer.erase(0, pos + 2);
-          items -=1;
-
-          if(subMode){ // when in subscribed mode, only take subscribe, unsubscribe, and special ping, give error for the rest
-            if (bulkString == "subscribe"){
-              response += subscribe_command(items, client_fd, read_buffer, channels, subbed);
-            }
-            else if (bulkString == "unsubscribe"){
-              response += unsubscribe_command(items, client_fd, read_buffer, channels, subbed);
-            }
-            else if (bulkString == "ping"){
-              response += "*2\r\n$4\r\npong\r\n$0\r\n\r\n";
-            }
-            else{
-              response += "-ERR Can't execute '"+bulkString+"' in subscribed mode: only SUBSCRIBE / UNSUBSCRIBE / PING are allowed \r\n";
-            }
-            send(client_fd, response.c_str(), response.size(), 0);
-            clear_array(items, read_buffer);
-            response = "";
-            continue;
-          }
-
-          if (bulkString == "multi"){
-            if (multi){
-              tempResponse = "-ERR MULTI calls can not be nested\r\n";
-              send(client_fd, tempResponse.c_str(), tempResponse.size(), 0);
-              clear_array(items, read_buffer);
-              continue;
-            }
-            else{
-              multi = true;
-              tempResponse = "+OK\r\n";
-              send(client_fd, tempResponse.c_str(), tempResponse.size(), 0);
-              clear_array(items, read_buffer);
-              continue;
-            }
-          }
-          else if (bulkString == "exec"){
-            if (!multi){
-              response = "-ERR EXEC without MULTI\r\n";
-              send(client_fd, response.c_str(), response.size(), 0);
-              clear_array(items, read_buffer);
-              continue;
-            }
-            else{
-              multi = false;
-              read_buffer = commandQueue + read_buffer;
-              commandQueue = "";
-              response = "*" + std::to_string(queuedUp) + "\r\n";
-            }
-          }
-          else if (bulkString == "discard"){
-            if (!multi){
-              response = "-ERR DISCARD without MULTI\r\n";
-            }
-          }
-          else if ( bulkString == "ping" ){ // Array gonna be like $5\r\nworld\r\n
-            response += ping_command(items, client_fd, read_buffer);
-          }
-          else if ( bulkString == "echo" ){
-            response += echo_command(items, client_fd, read_buffer);
-          }
-          else if ( bulkString == "command" ){
-            response += command_command(items, client_fd, read_buffer);
-          }
-          else if ( bulkString == "set" ){
-            if (true){  // Pass on to replicas before processing
-              std::string sMessage = "*" + std::to_string(items+1) + "\r\n$3\r\nSET\r\n";
-              sMessage += read_buffer;
-              for (int s : slaves){ 
-                send(s, sMessage.c_str(), sMessage.length(), 0);
-              }
-              replOffset += sMessage.size();
-            }
-           
-            response += set_command(items, client_fd, read_buffer, dict);
-          }
-          else if ( bulkString == "get" ){
-            response += get_command(items, client_fd, read_buffer, dict);
-          }
-          else if (bulkString == "config"){
-            response += config_command(items, client_fd, read_buffer, config);
-          }
-          else if (bulkString == "keys"){
-            response += key_command(items, client_fd, read_buffer, dict);
-          }
-          else if (bulkString == "info"){
-            response += info_command(items, client_fd, read_buffer, config);
-          }
-          else if (bulkString == "type"){
-            response += type_command(items, client_fd, read_buffer, dict, sDict);
-          }
-          else if (bulkString == "xadd"){
-            response += xadd_command(items, client_fd, read_buffer, dict, sDict);
-          }
-          else if (bulkString == "xrange"){
-            response += xrange_command(items, client_fd, read_buffer, sDict);
-          }
-          else if (bulkString == "xread"){
-            response += xread_command(items, client_fd, read_buffer, sDict);
-          }
-          else if (bulkString == "incr"){
-            response += incr_command(items, client_fd, read_buffer, dict);
-          }
-          else if (bulkString == "rpush"){
-            response += rpush_command(items, client_fd, read_buffer, lDict);
-          }
-          else if (bulkString == "lrange"){
-            response += lrange_command(items, client_fd, read_buffer, lDict);
-          }
-          else if (bulkString == "lpush"){
-            response += lpush_command(items, client_fd, read_buffer, lDict);
-          }
-          else if (bulkString == "llen"){
-            response += llen_command(items, client_fd, read_buffer, lDict);
-          }
-          else if (bulkString == "lpop"){
-            response += lpop_command(items, client_fd, read_buffer, lDict);
-          }
-          else if (bulkString == "blpop"){
-            response += blpop_command(items, client_fd, read_buffer, lDict);
-          }
-          else if (bulkString == "subscribe"){
-            response += subscribe_command(items, client_fd, read_buffer, channels, subbed);
-            subMode = true;
-          }
-          else if (bulkString == "unsubscribe"){
-            response += unsubscribe_command(items, client_fd, read_buffer, channels, subbed);
-          }
-          else if (bulkString == "publish"){
-            response += publish_command(items, client_fd, read_buffer, channels);
-          }
-          else if (bulkString == "zadd"){
-            response += zadd_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "zrank"){
-            response += zrank_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "zrange"){
-            response += zrange_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "zcard"){
-            response += zcard_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "zscore"){
-            response += zscore_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "zrem"){
-            response += zrem_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "geoadd"){
-            response += geoadd_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "geopos"){
-            response += geopos_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "geodist"){
-            response += geodist_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "geosearch"){
-            response += geosearch_command(items, client_fd, read_buffer, sets);
-          }
-          else if (bulkString == "replconf"){
-            std::string next = parsebulkString(items, client_fd, read_buffer);
-            next = lowercase_command(next);
-            if (next == "getack"){
-              std::cout << "getack called from client" << std::endl;
-              std::string sMessage = "*3\r\n$8\r\nreplconf\r\n$6\r\ngetack\r\n$1\r\n*\r\n";
-              for (int s : slaves){
-                send(s, sMessage.c_str(), sMessage.length(), 0);
-              }
-              std::string response = "+\r\n";
-              send(client_fd, response.c_str(), response.size(), 0);
-              clear_array(items,read_buffer);
-            }
-            else if (next == "ack"){
-              int offset = std::stoi(parsebulkString(items, client_fd, read_buffer));
-              {
-                  std::lock_guard<std::mutex> lock(replicaMutex); 
-                  replicaOffsets[client_fd] = offset;             
-              } 
-            }
-            else{
-              std::string response = "+OK\r\n";
-              send(client_fd, response.c_str(), response.size(), 0);
-              clear_array(items,read_buffer);
-            }
-          }
-          else if (bulkString == "psync"){
-            std::string response = "+FULLRESYNC 8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb 0\r\n";
-            send(client_fd, response.c_str(), response.size(), 0);
-            clear_array(items,read_buffer);
-
-            std::string emptyRDB = "524544495330303131fa0972656469732d76657205372e322e30fa0a72656469732d62697473c040fa056374696d65c26d08bc65fa08757365642d6d656dc2b0c41000fa08616f662d62617365c000fff06e3bfec0ff5aa2";
-            int length = emptyRDB.length() / 2;
-            response = "$" + std::to_string(length) + "\r\n";
-            std::vector<uint8_t> bytes;
-            bytes.reserve(length);
-            for (size_t i = 0; i < emptyRDB.length(); i += 2) {
-              std::string byteStr = emptyRDB.substr(i, 2);
-              uint8_t byte = static_cast<uint8_t>(std::stoul(byteStr, nullptr, 16));
-              bytes.push_back(byte);
-            }
-            response.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
-            send(client_fd, response.c_str(), response.size(), 0);
-            clear_array(items,read_buffer);
-            {
-                std::lock_guard<std::mutex> lock(replicaMutex); 
-                replicaOffsets[client_fd] = 0;             
-            } 
-            slaves.push_back(client_fd);
-          }
-          else if (bulkString == "wait"){
-            int replicaCount = std::stoi(parsebulkString(items, client_fd, read_buffer));
-            int timeout = std::stoi(parsebulkString(items, client_fd, read_buffer));
-            int connectedReplicas = 0;
-            auto start = std::chrono::steady_clock::now();
-
-            std::string sMessage = "*3\r\n$8\r\nREPLCONF\r\n$6\r\nGETACK\r\n$1\r\n*\r\n";
-            for (int s : slaves){
-              send(s, sMessage.c_str(), sMessage.length(), 0);
-            }
-
-            while(true){
-
-              connectedReplicas = 0;
-
-              {
-                std::lock_guard<std::mutex> lock(replicaMutex);
-                for (int s : slaves) {
-                    if (replicaOffsets[s] >= replOffset) connectedReplicas++;
-                }
-              }
-
-              if (timeout > 0){
-                auto now = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-                if (elapsed >= timeout) {
-                  break; // timeout
-                }
-              }
-              if (connectedReplicas >= replicaCount || connectedReplicas == slaves.size()){
-                break;
-              }
-              std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
-
-            std::string response = ":" + std::to_string(connectedReplicas) + "\r\n";
-            send(client_fd, response.c_str(), response.size(), 0);
-            clear_array(items,read_buffer);
-          }
-          else{
-            response += "-ERR unrecognized command\r\n";
-          }
-
-          if (queuedUp == 0){
-            send(client_fd, response.c_str(), response.size(), 0);
-            clear_array(items, read_buffer);
-            response = "";
-          }
-          else{
-            queuedUp -=1;
-          }
-        }
-      }
-      else if (start[0]== '$'){ // If input is a bulkString, just scrap it 
-          int strLen = std::stoi(start.substr(1,pos));
-          std::string bulkString = read_buffer.substr(0, strLen);
-          read_buffer.erase(0, strLen + 2);
-      }
-      else if (start == "PING\r\n"){ // If input is a simple PING command
-        std::string response = "+PONG\r\n";
-        send(client_fd, response.c_str(), response.size(), 0);
-      }
-      else{ // If input is not supported
-        std::string response = "+ERROR\r\n";
-        send(client_fd, response.c_str(), response.size(), 0);
-      }
-    }
+    read_buffer.append(buffer, recieved);
   }
 }
 
@@ -585,7 +148,7 @@ std::string simple_rcv(int client_fd){
 }
 
 HandshakeResult handshake(std::string masterport, Config params){
-  int space = masterport.find(" ");
+  size_t space = masterport.find(" ");
   if (space == std::string::npos) throw std::invalid_argument("Expected '<HOST> <PORT>' format");
   std::string masterhost = masterport.substr(0, space);
   masterport = masterport.substr(space+1);
@@ -650,11 +213,8 @@ HandshakeResult handshake(std::string masterport, Config params){
 int main(int argc, char **argv) {
   Config params;
   std::vector<std::thread> threads;
-  RedisDict dict;
-  std::map<std::string, Stream> sDict; 
-  std::map<std::string, std::vector<std::string>> lDict;
+  Keyspace db;
   std::map<std::string, std::set<int>> channels;
-  std::map<std::string, SkipList> sets;
   std::string masterport;
 
   for (int i = 1; i < argc; i++){
@@ -673,13 +233,75 @@ int main(int argc, char **argv) {
       
       masterport = argv[++i];
     }
+    else if(arg == "--io-backend" && i+1 < argc){
+      params.ioBackend = argv[++i];
+    }
+    else if(arg == "--io-threads" && i+1 < argc){
+      params.ioThreads = argv[++i];
+      if (params.ioBackend == "threads") params.ioBackend = "asio";
+    }
+    else if(arg == "--tcp-backlog" && i+1 < argc){
+      params.tcpBacklog = argv[++i];
+    }
+    else if(arg == "--shards" && i+1 < argc){
+      params.shards = argv[++i];
+    }
+    else if(arg == "--maxmemory" && i+1 < argc){
+      params.maxmemory = argv[++i];
+    }
+    else if(arg == "--maxmemory-policy" && i+1 < argc){
+      params.maxmemoryPolicy = argv[++i];
+    }
+    else if(arg == "--maxmemory-samples" && i+1 < argc){
+      params.maxmemorySamples = argv[++i];
+    }
+    else if(arg == "--list-compress-depth" && i+1 < argc){
+      params.listCompressDepth = argv[++i];
+    }
+    else if(arg == "--zset-max-listpack-entries" && i+1 < argc){
+      params.zsetMaxListpackEntries = argv[++i];
+    }
+    else if(arg == "--zset-max-listpack-value" && i+1 < argc){
+      params.zsetMaxListpackValue = argv[++i];
+    }
+    else if(arg == "--stream-node-max-bytes" && i+1 < argc){
+      params.streamNodeMaxBytes = argv[++i];
+    }
+    else if(arg == "--stream-node-max-entries" && i+1 < argc){
+      params.streamNodeMaxEntries = argv[++i];
+    }
+    else if(arg == "--client-output-buffer-limit" && i+1 < argc){ // "<normal|pubsub> <hard> <soft> <soft seconds>"
+      std::string limit = argv[++i];
+      int space = limit.find(" ");
+      std::string limitClass = lowercase_command(limit.substr(0, space));
+      if (limitClass == "normal") params.outputLimitNormal = limit.substr(space + 1);
+      else if (limitClass == "pubsub") params.outputLimitPubsub = limit.substr(space + 1);
+      else std::cerr << "unknown client-output-buffer-limit class: " << limitClass << "\n";
+    }
   }
 
   std::string filepath = params.dir + "/" + params.dbfilename;
   if (params.dir !="" || params.dbfilename != ""){
     std::cout << filepath << std::endl;
   }
-  parse_rdbFile(dict, filepath);
+  QuickList::set_compress_depth(std::stoi(params.listCompressDepth));
+  ZSet::set_packed_limits(std::stoul(params.zsetMaxListpackEntries), std::stoul(params.zsetMaxListpackValue));
+  Stream::set_node_limits(std::stoul(params.streamNodeMaxBytes), std::stoul(params.streamNodeMaxEntries));
+  parse_rdbFile(db, filepath);
+
+  size_t shardCount = std::min<size_t>(std::stoul(params.shards), Keyspace::STRIPES);
+  std::unique_ptr<ShardEngine> shards;
+  if (shardCount > 0){
+    shards = std::make_unique<ShardEngine>(shardCount);
+    db.set_shards(shards.get());
+    shards->start();
+  }
+  std::thread(active_expire_loop, std::ref(db)).detach();
+
+  ServerContext ctx{params, filepath, db, channels,
+                    parse_output_limit(params.outputLimitNormal),
+                    parse_output_limit(params.outputLimitPubsub),
+                    parse_eviction_config(params)};
 
   if (params.replica == "slave"){
     HandshakeResult hr = handshake(masterport, params);
@@ -687,13 +309,24 @@ int main(int argc, char **argv) {
       return 1;
     };
     std::cout << "Connected to Master \n";
-    threads.emplace_back(std::thread(handle_master, hr.fd, params, filepath, std::ref(dict), hr.leftover));
+    threads.emplace_back(std::thread(handle_master, hr.fd, std::ref(ctx), hr.leftover));
     threads.back().detach();
   }
 
   // Flush after every std::cout / std::cerr
   std::cout << std::unitbuf;
   std::cerr << std::unitbuf;
+
+  if (params.ioBackend == "uring"){
+    if (uring_supported()){
+      return run_uring_server(ctx);
+    }
+    std::cerr << "io_uring not supported by this kernel, falling back to epoll\n";
+    params.ioBackend = "asio";
+  }
+  if (params.ioBackend == "asio"){
+    return run_async_server(ctx);
+  }
   
   int server_fd = socket(AF_INET, SOCK_STREAM, 0);
   if (server_fd < 0) {
@@ -719,7 +352,7 @@ int main(int argc, char **argv) {
     return 1;
   }
   
-  int connection_backlog = 5;
+  int connection_backlog = std::stoi(params.tcpBacklog);
   if (listen(server_fd, connection_backlog) != 0) {
     std::cerr << "listen failed\n";
     return 1;
@@ -739,8 +372,7 @@ int main(int argc, char **argv) {
       continue;
     }
     std::cout << "Client connected\n";
-    threads.emplace_back(std::thread(handle_client, client_fd, params, filepath, 
-      std::ref(dict), std::ref(sDict), std::ref(lDict), std::ref(channels), std::ref(sets)));
+    threads.emplace_back(std::thread(handle_client, client_fd, std::ref(ctx)));
     threads.back().detach();
   }
 
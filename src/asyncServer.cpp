@@ -0,0 +1,188 @@
+#include "asyncServer.h"
+#include "blocking.h"
+
+#include <asio.hpp>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+namespace {
+
+const size_t READ_CHUNK = 16 * 1024;
+
+// Runs f on its own thread and resumes the calling coroutine on its executor when done.
+// A blocked client only costs a thread for as long as it is actually blocked.
+template <typename F>
+asio::awaitable<void> run_blocking(F f){
+  auto ex = co_await asio::this_coro::executor;
+  std::exception_ptr error;
+  co_await asio::async_initiate<decltype(asio::use_awaitable), void()>(
+    [ex, f, &error](auto handler) mutable {
+      std::thread([ex, f, &error, handler = std::move(handler)]() mutable {
+        try {
+          f();
+        } catch (...) {
+          error = std::current_exception(); // rethrown on the loop, not terminate() on this thread
+        }
+        asio::post(ex, std::move(handler));
+      }).detach();
+    }, asio::use_awaitable);
+  if (error) std::rethrow_exception(error);
+}
+
+// Lets a PUBLISH on another connection, a push serving this session's parked pop or
+// its park timeout interrupt the session's wait for input
+struct Waker {
+  asio::ip::tcp::socket& socket;
+  bool waitingRead = false;
+};
+
+std::vector<asio::const_buffer> as_buffers(const OutputBuffer& out){
+  std::vector<asio::const_buffer> buffers;
+  buffers.reserve(out.chunks().size());
+  for (const std::string& chunk : out.chunks()) buffers.emplace_back(chunk.data(), chunk.size());
+  return buffers;
+}
+
+asio::awaitable<void> session(asio::ip::tcp::socket socket, ServerContext& ctx){
+  ClientState client;
+  client.fd = socket.native_handle();
+  // Idle connections only wait for readability, the read itself goes through one
+  // buffer shared by the whole loop so thousands of sockets don't each hold a chunk
+  static thread_local std::vector<char> buffer(READ_CHUNK);
+
+  auto waker = std::make_shared<Waker>(Waker{socket});
+  client.push = std::make_shared<PushQueue>();
+  auto wake = [ex = socket.get_executor(), weak = std::weak_ptr<Waker>(waker)]{
+    asio::post(ex, [weak]{
+      auto w = weak.lock();
+      if (w && w->waitingRead) w->socket.cancel();
+    });
+  };
+  client.push->wake = wake;
+  client.unpark = wake;
+  asio::steady_timer parkTimer(socket.get_executor());
+
+  try {
+    socket.non_blocking(true);
+    while (true) {
+      take_pushed(client);
+      if (!client.out.empty()){
+        co_await asio::async_write(socket, as_buffers(client.out), asio::use_awaitable);
+        client.out.clear();
+        continue; // more may have been published while writing
+      }
+
+      // A parked BLPOP keeps waiting on the socket too, so a hangup still ends it. Its
+      // unpark and the timer cancel the wait like a publish does
+      bool resumed = false;
+      if (client.parked){
+        resumed = resume_parked(client, ctx);
+        if (!resumed && client.parked->deadline != std::chrono::steady_clock::time_point::max()){
+          parkTimer.expires_at(client.parked->deadline);
+          parkTimer.async_wait([weak = std::weak_ptr<Waker>(waker)](const asio::error_code& ec){
+            auto w = weak.lock();
+            if (!ec && w && w->waitingRead) w->socket.cancel();
+          });
+        }
+      }
+      if (!resumed){
+        asio::error_code ec;
+        waker->waitingRead = true;
+        co_await socket.async_wait(asio::ip::tcp::socket::wait_read, asio::redirect_error(asio::use_awaitable, ec));
+        waker->waitingRead = false;
+        if (ec == asio::error::operation_aborted) continue; // woken to flush published messages, or unparked
+        if (ec) break;
+        size_t recieved = socket.read_some(asio::buffer(buffer), ec);
+        if (ec == asio::error::would_block) continue;
+        if (ec) break;
+        client.read_buffer.append(buffer.data(), recieved);
+        if (client.parked) continue; // pipelined behind the parked command, runs once it's done
+      }
+
+      // XREAD BLOCK / WAIT sleep until they are satisfied, so they must not run on the loop.
+      // BLPOP parks instead, its reply comes through resume_parked above
+      bool failed = false;
+      try {
+        while (process_client_buffer(client, ctx, false) == ProcessResult::Blocked){
+          co_await run_blocking([&client, &ctx]{ process_client_buffer(client, ctx, true); });
+        }
+      } catch (const std::exception& e) {
+        failed = true; // protocol error, the reply is already in client.out
+      }
+
+      if (failed){
+        take_pushed(client);
+        co_await asio::async_write(socket, as_buffers(client.out), asio::use_awaitable);
+        break;
+      }
+    }
+  } catch (const std::exception& e) {
+    // connection reset
+  }
+  unregister_client(client, ctx);
+  std::cerr << "client disconnected \n";
+}
+
+asio::awaitable<void> listener(asio::ip::tcp::acceptor acceptor, ServerContext& ctx){
+  while (true) {
+    asio::ip::tcp::socket socket = co_await acceptor.async_accept(asio::use_awaitable);
+    std::cout << "Client connected\n";
+    asio::co_spawn(acceptor.get_executor(), session(std::move(socket), ctx), asio::detached);
+  }
+}
+
+}
+
+int run_async_server(ServerContext& ctx){
+  int port = std::stoi(ctx.config.port);
+  int reactors = std::max(1, std::stoi(ctx.config.ioThreads));
+  int backlog = std::stoi(ctx.config.tcpBacklog);
+
+  // Each reactor is one io_context on one thread with its own listening socket. SO_REUSEPORT
+  // lets the kernel spread new connections across them, and a connection stays on the
+  // reactor that accepted it for its whole life
+  std::vector<std::unique_ptr<asio::io_context>> loops;
+  for (int i = 0; i < reactors; i++){
+    loops.push_back(std::make_unique<asio::io_context>(1));
+    try {
+      asio::ip::tcp::acceptor acceptor(*loops.back());
+      acceptor.open(asio::ip::tcp::v4());
+      acceptor.set_option(asio::socket_base::reuse_address(true));
+      int reuse = 1;
+      if (setsockopt(acceptor.native_handle(), SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+        std::cerr << "setsockopt SO_REUSEPORT failed\n";
+        return 1;
+      }
+      acceptor.bind(asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port));
+      acceptor.listen(backlog);
+      asio::co_spawn(*loops.back(), listener(std::move(acceptor), ctx), asio::detached);
+    } catch (const std::exception& e) {
+      std::cerr << "Failed to bind to port "<< port <<"\n";
+      return 1;
+    }
+  }
+  std::cout << "Waiting for a client to connect...\n";
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (int i = 0; i < reactors; i++){
+    auto run = [&loops, i, cores]{
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % cores, &cpus);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      loops[i]->run();
+    };
+    if (i == reactors - 1) run(); // last reactor runs on the main thread
+    else threads.emplace_back(run);
+  }
+  for (auto& t : threads) t.join();
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include "blocking.h"
+#include "commandTable.h"
+#include "replication.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+using Queue = std::deque<std::shared_ptr<ParkedPop>>;
+
+// Parked pops by key, per stripe and guarded by it
+std::array<std::unordered_map<std::string, Queue>, Keyspace::STRIPES> parkedOn;
+std::atomic<size_t> queued{0}; // entries over all queues, so pushes skip the lookup when nobody waits
+
+std::string bulk(std::string_view s){
+  std::string response = "$" + std::to_string(s.size()) + "\r\n";
+  response.append(s);
+  response += "\r\n";
+  return response;
+}
+
+// Takes pop off its keys' queues, whatever is left of them
+void unqueue(Keyspace& db, const std::shared_ptr<ParkedPop>& pop){
+  KeyLock lock(db);
+  for (const std::string& key : pop->keys) lock.add(key, true);
+  lock.lock();
+  for (const std::string& key : pop->keys){
+    auto& stripe = parkedOn[Keyspace::stripe_of(key)];
+    auto it = stripe.find(key);
+    if (it == stripe.end()) continue;
+    Queue& queue = it->second;
+    size_t before = queue.size();
+    std::erase(queue, pop);
+    queued.fetch_sub(before - queue.size(), std::memory_order_relaxed);
+    if (queue.empty()) stripe.erase(it);
+  }
+}
+
+} // namespace
+
+std::string parse_block_timeout(std::string_view arg, std::chrono::steady_clock::time_point& deadline){
+  std::string text(arg);
+  char* end = nullptr;
+  double seconds = std::strtod(text.c_str(), &end);
+  if (text.empty() || end != text.c_str() + text.size() || !std::isfinite(seconds)){
+    return "-ERR timeout is not a float or out of range\r\n";
+  }
+  if (seconds < 0) return "-ERR timeout is negative\r\n";
+  if (seconds == 0){
+    deadline = std::chrono::steady_clock::time_point::max();
+    return "";
+  }
+  deadline = std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+  return "";
+}
+
+void park(ClientState& client, Keyspace&, std::shared_ptr<ParkedPop> pop){
+  std::sort(pop->keys.begin(), pop->keys.end());
+  pop->keys.erase(std::unique(pop->keys.begin(), pop->keys.end()), pop->keys.end()); // BLPOP k k 0
+  pop->wake = client.unpark;
+  for (const std::string& key : pop->keys){
+    parkedOn[Keyspace::stripe_of(key)][key].push_back(pop);
+    queued.fetch_add(1, std::memory_order_relaxed);
+  }
+  client.parked = std::move(pop);
+}
+
+void serve_parked(ClientState& client, Keyspace& db, std::string_view key){
+  // A parker registers under the stripe lock this push holds now, so it's visible here
+  if (queued.load(std::memory_order_relaxed) == 0) return;
+  auto& stripe = parkedOn[Keyspace::stripe_of(key)];
+  auto it = stripe.find(std::string(key));
+  if (it == stripe.end()) return;
+  Queue& queue = it->second;
+  bool wrongType;
+  List* list = db.lookup<List>(key, wrongType);
+  size_t available = list ? list->size() : 0;
+
+  while (available && !queue.empty()){
+    std::shared_ptr<ParkedPop> pop = std::move(queue.front());
+    queue.pop_front();
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    int expected = ParkedPop::WAITING;
+    if (pop->move){
+      // Its destination may be on a stripe we don't hold, it moves the element itself
+      if (!pop->state.compare_exchange_strong(expected, ParkedPop::RETRY, std::memory_order_acq_rel)) continue;
+    } else {
+      // Served already through another key, or timed out: dropped here lazily
+      if (!pop->state.compare_exchange_strong(expected, ParkedPop::SERVING, std::memory_order_acq_rel)) continue;
+      std::string element = pop->popLeft ? list->pop_front() : list->pop_back();
+      also_propagate(client, Argv{pop->popLeft ? "LPOP" : "RPOP", key});
+      pop->reply = "*2\r\n" + bulk(key) + bulk(element);
+      pop->state.store(ParkedPop::SERVED, std::memory_order_release);
+    }
+    available--;
+    if (pop->wake) pop->wake();
+  }
+  if (list && list->empty()) db.erase(key);
+  if (queue.empty()) stripe.erase(it);
+}
+
+bool resume_parked(ClientState& client, ServerContext& ctx){
+  std::shared_ptr<ParkedPop> pop = client.parked;
+  int state = pop->state.load(std::memory_order_acquire);
+  if (state == ParkedPop::WAITING){
+    if (std::chrono::steady_clock::now() < pop->deadline) return false;
+    // On failure state is reloaded: a push claimed it just now
+    if (pop->state.compare_exchange_strong(state, ParkedPop::TIMED_OUT, std::memory_order_acq_rel)) state = ParkedPop::TIMED_OUT;
+  }
+  if (state == ParkedPop::SERVING) return false; // the push wakes us again when the reply is written
+
+  client.parked.reset();
+  unqueue(ctx.db, pop);
+  if (state == ParkedPop::TIMED_OUT){
+    client.out += pop->move ? "$-1\r\n" : "*-1\r\n";
+    return true;
+  }
+  if (state == ParkedPop::SERVED){
+    client.out += pop->reply;
+    return true;
+  }
+  // RETRY: BLMOVE runs again under its own locks, and parks again if it lost the element
+  Argv argv(pop->argv.begin(), pop->argv.end());
+  client.out += execute_command(client, ctx, *lookup_command(argv[0]), argv);
+  if (client.parked) client.parked->deadline = pop->deadline; // same timeout as the first time
+  return !client.parked;
+}
+
+void cancel_parked(ClientState& client, ServerContext& ctx){
+  std::shared_ptr<ParkedPop> pop = std::move(client.parked);
+  if (!pop) return;
+  int state = ParkedPop::WAITING;
+  pop->state.compare_exchange_strong(state, ParkedPop::TIMED_OUT, std::memory_order_acq_rel);
+  while (pop->state.load(std::memory_order_acquire) == ParkedPop::SERVING) std::this_thread::yield();
+  unqueue(ctx.db, pop);
+}
@@ -0,0 +1,241 @@
+#include "client.h"
+#include "commandTable.h"
+#include "subscribe.h"
+#include "blocking.h"
+
+#include <mutex>
+#include <stdexcept>
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <cerrno>
+#include <ctime>
+
+const size_t BUFFER_SIZE = 1024;
+
+namespace {
+
+// What a parked client's unpark writes to. Shared with the ParkedPop, a push that
+// claimed it may still be calling unpark after the connection is gone
+struct ParkWake {
+  int fd = eventfd(0, 0);
+  ~ParkWake(){ close(fd); }
+};
+
+// Sleeps until the parked command is woken or its deadline passes, false if the client hung up meanwhile
+bool wait_unparked(ClientState& client, int wakeFd){
+  while (!client.parked->ready()){
+    std::chrono::steady_clock::time_point deadline = client.parked->deadline;
+    timespec timeout;
+    timespec* waitFor = nullptr; // forever
+    if (deadline != std::chrono::steady_clock::time_point::max()){
+      auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0) return true;
+      timeout.tv_sec = left.count() / 1000000000;
+      timeout.tv_nsec = left.count() % 1000000000;
+      waitFor = &timeout;
+    }
+    // Pipelined input stays in the socket until the parked command is done, only a hangup counts
+    pollfd fds[2] = {{client.fd, POLLRDHUP, 0}, {wakeFd, POLLIN, 0}};
+    if (ppoll(fds, 2, waitFor, nullptr) < 0){
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (fds[0].revents) return false;
+    if (fds[1].revents & POLLIN){
+      uint64_t count;
+      ssize_t ignored = read(wakeFd, &count, sizeof(count));
+      (void)ignored;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+// Subscribers by fd, so PUBLISH can reach connections owned by other threads / reactors
+std::map<int, std::shared_ptr<PushQueue>> pushQueues;
+std::mutex pushQueuesMutex;
+
+void take_pushed(ClientState& client){
+  if (!client.push) return;
+  std::lock_guard<std::mutex> lock(client.push->mutex);
+  client.out.append(std::move(client.push->pending));
+}
+
+bool push_message(int fd, std::string_view message, const OutputLimit& limit){
+  std::lock_guard<std::mutex> registryLock(pushQueuesMutex);
+  auto it = pushQueues.find(fd);
+  if (it == pushQueues.end()) return false;
+  PushQueue& queue = *it->second;
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.dropped) return true;
+  queue.pending += message;
+  if (over_output_limit(queue.pending.size(), limit, queue.softSince)){
+    // Slow consumer, drop it rather than letting the backlog grow without bound.
+    // The owner sees EOF / EPIPE and unregisters, fd stays valid until then
+    std::cerr << "closing subscriber " << fd << " over the pubsub output buffer limit\n";
+    queue.dropped = true;
+    queue.pending.clear();
+    shutdown(fd, SHUT_RDWR);
+    return true;
+  }
+  if (queue.wake) queue.wake();
+  return true;
+}
+
+void register_client(ClientState& client){
+  if (!client.push) return;
+  std::lock_guard<std::mutex> lock(pushQueuesMutex);
+  pushQueues[client.fd] = client.push;
+}
+
+void unregister_client(ClientState& client, ServerContext& ctx){
+  {
+    std::lock_guard<std::mutex> lock(pushQueuesMutex);
+    auto it = pushQueues.find(client.fd);
+    if (it != pushQueues.end() && it->second == client.push) pushQueues.erase(it);
+  }
+  remove_subscriber(client.fd, ctx.channels, client.subbed); // the fd number may be reused by the next connection
+  client.subbed.clear();
+  cancel_parked(client, ctx);
+}
+
+ProcessResult process_client_buffer(ClientState& client, ServerContext& ctx, bool allowBlocking){
+  RespParser& parser = client.parser;
+  Argv& argv = client.argv;
+  ProcessResult result = ProcessResult::Done;
+  take_pushed(client); // messages published before this batch go out before its replies
+  if (client.parked) return ProcessResult::Parked; // the rest waits behind it
+
+  while (true) {
+    size_t commandStart = parser.cursor;
+    ParseStatus status = parser.next(client.read_buffer, argv);
+    if (status == ParseStatus::Incomplete) break; // half a command, wait for the rest
+    if (status == ParseStatus::Error){
+      client.out += "-ERR Protocol error: " + parser.error + "\r\n";
+      throw std::runtime_error("protocol error");
+    }
+    if (argv.empty()) continue;
+
+    const CommandSpec* spec = lookup_command(argv[0]);
+    if (!spec){
+      client.out += "-ERR unrecognized command\r\n";
+      continue;
+    }
+    if (!arity_ok(*spec, argv.size())){
+      client.out += "-ERR wrong number of arguments for '" + std::string(spec->name) + "' command\r\n";
+      continue;
+    }
+
+    if (client.subMode && !(spec->flags & CMD_PUBSUB)){ // when in subscribed mode, only take subscribe, unsubscribe, and special ping
+      client.out += "-ERR Can't execute '" + std::string(spec->name) + "' in subscribed mode: only SUBSCRIBE / UNSUBSCRIBE / PING are allowed \r\n";
+      continue;
+    }
+    if (client.multi && !(spec->flags & CMD_NOQUEUE)){ // Not a exec command so just queue it
+      client.queued.emplace_back(argv.begin(), argv.end());
+      client.out += "+QUEUED\r\n";
+      continue;
+    }
+    if (!allowBlocking && command_blocks(*spec, argv)){
+      parser.cursor = commandStart; // leave it for the thread that is allowed to block
+      result = ProcessResult::Blocked;
+      break;
+    }
+    client.out += execute_command(client, ctx, *spec, argv);
+    if (client.parked){
+      result = ProcessResult::Parked;
+      break;
+    }
+  }
+
+  parser.compact(client.read_buffer);
+
+  if (!client.subMode && over_output_limit(client.out.size(), ctx.normalLimit, client.softSince)){
+    std::cerr << "closing client " << client.fd << " over the normal output buffer limit\n";
+    client.out.clear();
+    throw std::runtime_error("output buffer limit");
+  }
+  return result;
+}
+
+void handle_client(int client_fd, ServerContext& ctx) {
+  ClientState client;
+  client.fd = client_fd;
+  client.push = std::make_shared<PushQueue>();
+  int wakeFd = -1; // only subscribers need to wake up for anything but their own socket
+  auto parkWake = std::make_shared<ParkWake>();
+  client.unpark = [parkWake]{
+    uint64_t one = 1;
+    ssize_t ignored = write(parkWake->fd, &one, sizeof(one));
+    (void)ignored;
+  };
+  char buffer[BUFFER_SIZE] = {0};
+
+  while(true){
+    if (client.subMode && wakeFd < 0){
+      wakeFd = eventfd(0, 0);
+      std::lock_guard<std::mutex> lock(client.push->mutex);
+      client.push->wake = [wakeFd]{
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+      };
+    }
+    if (wakeFd >= 0){
+      take_pushed(client);
+      if (!client.out.empty() && !client.out.write_to(client_fd)) break;
+
+      pollfd fds[2] = {{client_fd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+      if (poll(fds, 2, -1) < 0){
+        if (errno == EINTR) continue;
+        break;
+      }
+      if (fds[1].revents & POLLIN){
+        uint64_t count;
+        ssize_t ignored = read(wakeFd, &count, sizeof(count));
+        (void)ignored;
+      }
+      if (!fds[0].revents) continue; // only published messages, flushed at the top
+    }
+
+    ssize_t recieved = recv(client_fd, buffer, sizeof(buffer)-1, 0); // Waiting for client input
+    if (recieved < 0) {
+      std::cerr << "error\n";
+      break;
+    } else if (recieved == 0) {
+      std::cerr << "client disconnected \n";
+      break;
+    }
+
+    client.read_buffer.append(buffer, recieved); // Read clients into buffer
+    bool failed = false;
+    try {
+      ProcessResult result = process_client_buffer(client, ctx);
+      while (result == ProcessResult::Parked){
+        // Replies to the commands before it go out first, then the thread sleeps on it
+        take_pushed(client);
+        if (!client.out.write_to(client_fd)) throw std::runtime_error("write failed");
+        if (!wait_unparked(client, parkWake->fd)) throw std::runtime_error("client hung up while parked");
+        if (resume_parked(client, ctx)) result = process_client_buffer(client, ctx);
+      }
+    } catch (const std::exception& e) {
+      failed = true;
+    }
+
+    take_pushed(client);
+    if (!client.out.write_to(client_fd)) break;
+    if (failed){
+      std::cerr << "closing client after error\n";
+      break;
+    }
+  }
+  unregister_client(client, ctx);
+  if (wakeFd >= 0) close(wakeFd);
+  close(client_fd);
+}
@@ -1,15 +1,9 @@
 #include "command.h"
-#include "bulkString.h"
-#include "clear.h"
 #include "lowerCMD.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
-std::string command_command(int& items, int client_fd, std::string& read_buffer){
-  if (items == 1){
-    std::string bulkString = parsebulkString(items, client_fd, read_buffer);
-    bulkString = lowercase_command(bulkString);
+std::string command_command(const Argv& argv){
+  if (argv.size() == 2){
+    std::string bulkString = lowercase_command(argv[1]);
     std::string response = "-ERR command for command ";
     response.append(bulkString);
     response.append(" not yet implemented ");
@@ -20,4 +14,4 @@ std::string command_command(int& items, int client_fd, std::string& read_buffer)
     std::string response = "-ERR wrong number of arguments for command command\r\n";
     return response;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,360 @@
+#include "commandTable.h"
+#include "command.h"
+#include "echo.h"
+#include "ping.h"
+#include "setGet.h"
+#include "keys.h"
+#include "info.h"
+#include "type.h"
+#include "incr.h"
+#include "expire.h"
+#include "list.h"
+#include "subscribe.h"
+#include "geo.h"
+#include "replication.h"
+#include "lowerCMD.h"
+#include "shard.h"
+
+#include <array>
+
+namespace {
+
+// Adapters from the table's uniform signature to each command's own
+
+std::string ping(ClientState& client, ServerContext&, const Argv& argv){
+  if (client.subMode) return "*2\r\n$4\r\npong\r\n$0\r\n\r\n"; // subscribed clients get the pub/sub form
+  return ping_command(argv);
+}
+std::string echo(ClientState&, ServerContext&, const Argv& argv){ return echo_command(argv); }
+std::string command(ClientState&, ServerContext&, const Argv& argv){ return command_command(argv); }
+std::string config(ClientState&, ServerContext& ctx, const Argv& argv){ return config_command(argv, ctx.config); }
+std::string info(ClientState&, ServerContext& ctx, const Argv& argv){ return info_command(argv, ctx.config, ctx.eviction, ctx.db); }
+std::string memory(ClientState&, ServerContext&, const Argv& argv){ return memory_command(argv); }
+
+std::string set(ClientState& client, ServerContext& ctx, const Argv& argv){ return set_command(client, argv, ctx.db); }
+std::string get(ClientState&, ServerContext& ctx, const Argv& argv){ return get_command(argv, ctx.db); }
+std::string mget(ClientState&, ServerContext& ctx, const Argv& argv){ return mget_command(argv, ctx.db); }
+std::string keys(ClientState&, ServerContext& ctx, const Argv& argv){ return key_command(argv, ctx.db); }
+std::string type(ClientState&, ServerContext& ctx, const Argv& argv){ return type_command(argv, ctx.db); }
+std::string object(ClientState&, ServerContext& ctx, const Argv& argv){ return object_command(argv, ctx.db); }
+std::string append(ClientState&, ServerContext& ctx, const Argv& argv){ return append_command(argv, ctx.db); }
+std::string incr(ClientState&, ServerContext& ctx, const Argv& argv){ return incr_command(argv, ctx.db); }
+std::string decr(ClientState&, ServerContext& ctx, const Argv& argv){ return decr_command(argv, ctx.db); }
+std::string incrby(ClientState&, ServerContext& ctx, const Argv& argv){ return incrby_command(argv, ctx.db); }
+std::string decrby(ClientState&, ServerContext& ctx, const Argv& argv){ return decrby_command(argv, ctx.db); }
+std::string incrbyfloat(ClientState& client, ServerContext& ctx, const Argv& argv){ return incrbyfloat_command(client, argv, ctx.db); }
+std::string expire(ClientState& client, ServerContext& ctx, const Argv& argv){ return expire_command(client, argv, ctx.db, std::chrono::seconds(1)); }
+std::string pexpire(ClientState& client, ServerContext& ctx, const Argv& argv){ return expire_command(client, argv, ctx.db, std::chrono::milliseconds(1)); }
+std::string expireat(ClientState&, ServerContext& ctx, const Argv& argv){ return expireat_command(argv, ctx.db, std::chrono::seconds(1)); }
+std::string pexpireat(ClientState&, ServerContext& ctx, const Argv& argv){ return expireat_command(argv, ctx.db, std::chrono::milliseconds(1)); }
+std::string ttl(ClientState&, ServerContext& ctx, const Argv& argv){ return ttl_command(argv, ctx.db, std::chrono::seconds(1)); }
+std::string pttl(ClientState&, ServerContext& ctx, const Argv& argv){ return ttl_command(argv, ctx.db, std::chrono::milliseconds(1)); }
+std::string expiretime(ClientState&, ServerContext& ctx, const Argv& argv){ return expiretime_command(argv, ctx.db, std::chrono::seconds(1)); }
+std::string pexpiretime(ClientState&, ServerContext& ctx, const Argv& argv){ return expiretime_command(argv, ctx.db, std::chrono::milliseconds(1)); }
+std::string persist(ClientState&, ServerContext& ctx, const Argv& argv){ return persist_command(argv, ctx.db); }
+
+std::string xadd(ClientState& client, ServerContext& ctx, const Argv& argv){ return xadd_command(client, argv, ctx.db); }
+std::string xrange(ClientState&, ServerContext& ctx, const Argv& argv){ return xrange_command(argv, ctx.db); }
+std::string xread(ClientState&, ServerContext& ctx, const Argv& argv){ return xread_command(argv, ctx.db); }
+std::string xrevrange(ClientState&, ServerContext& ctx, const Argv& argv){ return xrevrange_command(argv, ctx.db); }
+// XREAD [COUNT n] [BLOCK ms] STREAMS k1 .. kn id1 .. idn: options come in pairs before STREAMS
+static int xread_streams(const Argv& argv){
+  int i = 1;
+  while (i < static_cast<int>(argv.size()) && lowercase_command(argv[i]) != "streams") i += 2;
+  return i;
+}
+bool xread_blocks(const Argv& argv){
+  for (int i = 1; i < xread_streams(argv); i += 2){
+    if (lowercase_command(argv[i]) == "block") return true;
+  }
+  return false;
+}
+void xread_keys(const Argv& argv, int& first, int& last, int& step){
+  int streams = xread_streams(argv);
+  int count = (static_cast<int>(argv.size()) - streams - 1) / 2;
+  first = streams + 1;
+  last = streams + count;
+  step = 1;
+}
+
+std::string rpush(ClientState& client, ServerContext& ctx, const Argv& argv){ return rpush_command(client, argv, ctx.db); }
+std::string lrange(ClientState&, ServerContext& ctx, const Argv& argv){ return lrange_command(argv, ctx.db); }
+std::string lpush(ClientState& client, ServerContext& ctx, const Argv& argv){ return lpush_command(client, argv, ctx.db); }
+std::string llen(ClientState&, ServerContext& ctx, const Argv& argv){ return llen_command(argv, ctx.db); }
+std::string lpop(ClientState&, ServerContext& ctx, const Argv& argv){ return lpop_command(argv, ctx.db); }
+std::string blpop(ClientState& client, ServerContext& ctx, const Argv& argv){ return blpop_command(client, argv, ctx.db); }
+std::string rpop(ClientState&, ServerContext& ctx, const Argv& argv){ return rpop_command(argv, ctx.db); }
+std::string lindex(ClientState&, ServerContext& ctx, const Argv& argv){ return lindex_command(argv, ctx.db); }
+std::string lset(ClientState&, ServerContext& ctx, const Argv& argv){ return lset_command(argv, ctx.db); }
+std::string linsert(ClientState& client, ServerContext& ctx, const Argv& argv){ return linsert_command(client, argv, ctx.db); }
+std::string ltrim(ClientState&, ServerContext& ctx, const Argv& argv){ return ltrim_command(argv, ctx.db); }
+std::string lmove(ClientState& client, ServerContext& ctx, const Argv& argv){ return lmove_command(client, argv, ctx.db); }
+std::string brpop(ClientState& client, ServerContext& ctx, const Argv& argv){ return brpop_command(client, argv, ctx.db); }
+std::string blmove(ClientState& client, ServerContext& ctx, const Argv& argv){ return blmove_command(client, argv, ctx.db); }
+
+std::string subscribe(ClientState& client, ServerContext& ctx, const Argv& argv){
+  std::string response = subscribe_command(argv, client.fd, ctx.channels, client.subbed);
+  if (!client.subMode) register_client(client);
+  client.subMode = true;
+  return response;
+}
+std::string unsubscribe(ClientState& client, ServerContext& ctx, const Argv& argv){
+  return unsubscribe_command(argv, client.fd, ctx.channels, client.subbed);
+}
+std::string publish(ClientState&, ServerContext& ctx, const Argv& argv){
+  return publish_command(argv, ctx.channels, ctx.pubsubLimit);
+}
+
+std::string zadd(ClientState&, ServerContext& ctx, const Argv& argv){ return zadd_command(argv, ctx.db); }
+std::string zrank(ClientState&, ServerContext& ctx, const Argv& argv){ return zrank_command(argv, ctx.db); }
+std::string zrange(ClientState&, ServerContext& ctx, const Argv& argv){ return zrange_command(argv, ctx.db); }
+std::string zrangebyscore(ClientState&, ServerContext& ctx, const Argv& argv){ return zrangebyscore_command(argv, ctx.db); }
+std::string zrevrangebyscore(ClientState&, ServerContext& ctx, const Argv& argv){ return zrevrangebyscore_command(argv, ctx.db); }
+std::string zrangebylex(ClientState&, ServerContext& ctx, const Argv& argv){ return zrangebylex_command(argv, ctx.db); }
+std::string zcount(ClientState&, ServerContext& ctx, const Argv& argv){ return zcount_command(argv, ctx.db); }
+std::string zlexcount(ClientState&, ServerContext& ctx, const Argv& argv){ return zlexcount_command(argv, ctx.db); }
+std::string zremrangebyscore(ClientState&, ServerContext& ctx, const Argv& argv){ return zremrangebyscore_command(argv, ctx.db); }
+std::string zremrangebyrank(ClientState&, ServerContext& ctx, const Argv& argv){ return zremrangebyrank_command(argv, ctx.db); }
+std::string zcard(ClientState&, ServerContext& ctx, const Argv& argv){ return zcard_command(argv, ctx.db); }
+std::string zscore(ClientState&, ServerContext& ctx, const Argv& argv){ return zscore_command(argv, ctx.db); }
+std::string zrem(ClientState&, ServerContext& ctx, const Argv& argv){ return zrem_command(argv, ctx.db); }
+std::string geoadd(ClientState&, ServerContext& ctx, const Argv& argv){ return geoadd_command(argv, ctx.db); }
+std::string geopos(ClientState&, ServerContext& ctx, const Argv& argv){ return geopos_command(argv, ctx.db); }
+std::string geodist(ClientState&, ServerContext& ctx, const Argv& argv){ return geodist_command(argv, ctx.db); }
+std::string geosearch(ClientState&, ServerContext& ctx, const Argv& argv){ return geosearch_command(argv, ctx.db); }
+std::string geosearchstore(ClientState&, ServerContext& ctx, const Argv& argv){ return geosearchstore_command(argv, ctx.db); }
+
+std::string replconf(ClientState& client, ServerContext&, const Argv& argv){ return replconf_command(client, argv); }
+std::string psync(ClientState& client, ServerContext&, const Argv& argv){ return psync_command(client, argv); }
+std::string wait(ClientState& client, ServerContext&, const Argv& argv){ return wait_command(client, argv); }
+
+std::string multi(ClientState& client, ServerContext&, const Argv&){
+  if (client.multi) return "-ERR MULTI calls can not be nested\r\n";
+  client.multi = true;
+  return "+OK\r\n";
+}
+std::string exec(ClientState& client, ServerContext& ctx, const Argv&){
+  if (!client.multi) return "-ERR EXEC without MULTI\r\n";
+  client.multi = false;
+  std::vector<std::vector<std::string>> queued;
+  queued.swap(client.queued);
+  std::string response = "*" + std::to_string(queued.size()) + "\r\n";
+  Argv queuedArgv;
+  // Lock every stripe the transaction touches up front, the queued commands then run under it
+  KeyLock lock(ctx.db);
+  bool denyoom = false;
+  for (const auto& command : queued){
+    queuedArgv.assign(command.begin(), command.end());
+    const CommandSpec& spec = *lookup_command(queuedArgv[0]);
+    lock_command_keys(lock, spec, queuedArgv);
+    denyoom = denyoom || (spec.flags & CMD_DENYOOM);
+  }
+  // Evict before locking (eviction locks the stripes it samples), the queued commands then
+  // skip it. Out of memory, the transaction is discarded the way Redis rejects an EXEC
+  if (denyoom && !free_memory_if_needed(ctx.db, ctx.eviction)){
+    return "-EXECABORT Transaction discarded because of: " + OOM_ERROR.substr(1);
+  }
+  lock.lock();
+  client.execing = true;
+  for (const auto& command : queued){
+    queuedArgv.assign(command.begin(), command.end());
+    response += execute_command(client, ctx, *lookup_command(queuedArgv[0]), queuedArgv); // checked when queued
+  }
+  client.execing = false;
+  return response;
+}
+std::string discard(ClientState& client, ServerContext&, const Argv&){
+  if (!client.multi) return "-ERR DISCARD without MULTI\r\n";
+  client.multi = false;
+  client.queued.clear();
+  return "+OK\r\n";
+}
+
+constexpr CommandSpec COMMANDS[] = {
+  // name          handler      arity  flags                             keys: first last step
+  {"ping",        ping,        -1, CMD_PUBSUB,                           0, 0, 0},
+  {"echo",        echo,         2, 0,                                    0, 0, 0},
+  {"command",     command,     -1, 0,                                    0, 0, 0},
+  {"config",      config,      -3, 0,                                    0, 0, 0},
+  {"info",        info,        -1, CMD_READONLY | CMD_ALL_KEYS,          0, 0, 0},
+  {"memory",      memory,       2, 0,                                    0, 0, 0},
+  {"set",         set,         -3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"get",         get,          2, CMD_READONLY,                         1, 1, 1},
+  {"mget",        mget,        -2, CMD_READONLY,                         1, -1, 1},
+  {"keys",        keys,         2, CMD_READONLY | CMD_ALL_KEYS,          0, 0, 0},
+  {"type",        type,         2, CMD_READONLY,                         1, 1, 1},
+  {"object",      object,       3, CMD_READONLY,                         2, 2, 1},
+  {"append",      append,       3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"incr",        incr,         2, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"decr",        decr,         2, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"incrby",      incrby,       3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"decrby",      decrby,       3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"incrbyfloat", incrbyfloat,  3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"expire",      expire,       3, CMD_WRITE,                            1, 1, 1},
+  {"pexpire",     pexpire,      3, CMD_WRITE,                            1, 1, 1},
+  {"expireat",    expireat,     3, CMD_WRITE,                            1, 1, 1},
+  {"pexpireat",   pexpireat,    3, CMD_WRITE,                            1, 1, 1},
+  {"ttl",         ttl,          2, CMD_READONLY,                         1, 1, 1},
+  {"pttl",        pttl,         2, CMD_READONLY,                         1, 1, 1},
+  {"expiretime",  expiretime,   2, CMD_READONLY,                         1, 1, 1},
+  {"pexpiretime", pexpiretime,  2, CMD_READONLY,                         1, 1, 1},
+  {"persist",     persist,      2, CMD_WRITE,                            1, 1, 1},
+  {"xadd",        xadd,        -5, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"xrange",      xrange,      -4, CMD_READONLY,                         1, 1, 1},
+  {"xrevrange",   xrevrange,   -4, CMD_READONLY,                         1, 1, 1},
+  {"xread",       xread,       -4, CMD_READONLY | CMD_BLOCKING | CMD_MOVABLE_KEYS, 0, 0, 0, xread_blocks, xread_keys},
+  {"rpush",       rpush,       -3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"lrange",      lrange,       4, CMD_READONLY,                         1, 1, 1},
+  {"lpush",       lpush,       -3, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"llen",        llen,         2, CMD_READONLY,                         1, 1, 1},
+  {"lpop",        lpop,        -2, CMD_WRITE,                            1, 1, 1},
+  {"blpop",       blpop,       -3, CMD_WRITE | CMD_PARKS,                1, -2, 1},
+  {"brpop",       brpop,       -3, CMD_WRITE | CMD_PARKS,                1, -2, 1},
+  {"blmove",      blmove,       6, CMD_WRITE | CMD_DENYOOM | CMD_PARKS,  1, 2, 1},
+  {"rpop",        rpop,        -2, CMD_WRITE,                            1, 1, 1},
+  {"lindex",      lindex,       3, CMD_READONLY,                         1, 1, 1},
+  {"lset",        lset,         4, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"linsert",     linsert,      5, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"ltrim",       ltrim,        4, CMD_WRITE,                            1, 1, 1},
+  {"lmove",       lmove,        5, CMD_WRITE | CMD_DENYOOM,              1, 2, 1},
+  {"subscribe",   subscribe,   -2, CMD_PUBSUB,                           0, 0, 0},
+  {"unsubscribe", unsubscribe, -1, CMD_PUBSUB,                           0, 0, 0},
+  {"publish",     publish,      3, 0,                                    0, 0, 0},
+  {"zadd",        zadd,        -4, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"zrank",       zrank,        3, CMD_READONLY,                         1, 1, 1},
+  {"zrange",      zrange,      -4, CMD_READONLY,                         1, 1, 1},
+  {"zrangebyscore", zrangebyscore, -4, CMD_READONLY,                     1, 1, 1},
+  {"zrevrangebyscore", zrevrangebyscore, -4, CMD_READONLY,               1, 1, 1},
+  {"zrangebylex", zrangebylex, -4, CMD_READONLY,                         1, 1, 1},
+  {"zcount",      zcount,       4, CMD_READONLY,                         1, 1, 1},
+  {"zlexcount",   zlexcount,    4, CMD_READONLY,                         1, 1, 1},
+  {"zremrangebyscore", zremrangebyscore, 4, CMD_WRITE,                   1, 1, 1},
+  {"zremrangebyrank", zremrangebyrank, 4, CMD_WRITE,                     1, 1, 1},
+  {"zcard",       zcard,        2, CMD_READONLY,                         1, 1, 1},
+  {"zscore",      zscore,       3, CMD_READONLY,                         1, 1, 1},
+  {"zrem",        zrem,         3, CMD_WRITE,                            1, 1, 1},
+  {"geoadd",      geoadd,      -5, CMD_WRITE | CMD_DENYOOM,              1, 1, 1},
+  {"geopos",      geopos,      -2, CMD_READONLY,                         1, 1, 1},
+  {"geodist",     geodist,      4, CMD_READONLY,                         1, 1, 1},
+  {"geosearch",   geosearch,   -7, CMD_READONLY,                         1, 1, 1},
+  {"geosearchstore", geosearchstore, -8, CMD_WRITE | CMD_DENYOOM,        1, 2, 1},
+  {"replconf",    replconf,    -1, 0,                                    0, 0, 0},
+  {"psync",       psync,       -1, 0,                                    0, 0, 0},
+  {"wait",        wait,         3, CMD_BLOCKING,                         0, 0, 0},
+  {"multi",       multi,        1, CMD_NOQUEUE,                          0, 0, 0},
+  {"exec",        exec,         1, CMD_NOQUEUE,                          0, 0, 0},
+  {"discard",     discard,      1, CMD_NOQUEUE,                          0, 0, 0},
+};
+constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// Perfect hash: the seed is searched at compile time so every name lands in its own slot,
+// a lookup is one hash of the (case folded) name and one compare
+constexpr size_t SLOTS = 512; // sparse enough that a seed turns up within the constexpr step limit
+static_assert(COMMAND_COUNT < SLOTS && COMMAND_COUNT < 255, "command table needs more slots");
+
+constexpr unsigned char fold(char c){
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+constexpr uint32_t name_hash(std::string_view name, uint32_t seed){
+  uint32_t h = 2166136261u ^ seed;
+  for (char c : name){
+    h ^= fold(c);
+    h *= 16777619u;
+  }
+  return h ^ (h >> 15);
+}
+
+constexpr uint32_t find_seed(){
+  for (uint32_t seed = 1; seed < 100000; seed++){
+    std::array<bool, SLOTS> used{};
+    bool collision = false;
+    for (const CommandSpec& spec : COMMANDS){
+      size_t slot = name_hash(spec.name, seed) % SLOTS;
+      if (used[slot]){ collision = true; break; }
+      used[slot] = true;
+    }
+    if (!collision) return seed;
+  }
+  return 0;
+}
+
+constexpr uint32_t SEED = find_seed();
+static_assert(SEED != 0, "no collision free seed for the command table");
+
+constexpr std::array<uint8_t, SLOTS> build_index(){
+  std::array<uint8_t, SLOTS> index{};
+  for (auto& slot : index) slot = 0xFF;
+  for (size_t i = 0; i < COMMAND_COUNT; i++){
+    index[name_hash(COMMANDS[i].name, SEED) % SLOTS] = i;
+  }
+  return index;
+}
+
+constexpr std::array<uint8_t, SLOTS> INDEX = build_index();
+
+constexpr bool equals_folded(std::string_view input, std::string_view lowerName){
+  if (input.size() != lowerName.size()) return false;
+  for (size_t i = 0; i < input.size(); i++){
+    if (fold(input[i]) != static_cast<unsigned char>(lowerName[i])) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+const CommandSpec* lookup_command(std::string_view name){
+  uint8_t i = INDEX[name_hash(name, SEED) % SLOTS];
+  if (i == 0xFF || !equals_folded(name, COMMANDS[i].name)) return nullptr;
+  return &COMMANDS[i];
+}
+
+void lock_command_keys(KeyLock& lock, const CommandSpec& spec, const Argv& argv){
+  bool write = spec.flags & CMD_WRITE;
+  if (spec.flags & CMD_ALL_KEYS){
+    lock.add_all(write);
+    return;
+  }
+  int first = spec.firstKey, last = spec.lastKey, step = spec.keyStep;
+  if (spec.keysWith) spec.keysWith(argv, first, last, step);
+  if (first <= 0) return;
+  int argc = static_cast<int>(argv.size());
+  if (last < 0) last += argc;
+  for (int i = first; i <= last && i < argc; i += step){
+    lock.add(argv[i], write);
+  }
+}
+
+std::string execute_command(ClientState& client, ServerContext& ctx, const CommandSpec& spec, const Argv& argv){
+  // Only where no stripe is held yet: not inside EXEC, and not on the shard a command was forwarded to
+  if ((spec.flags & CMD_DENYOOM) && !KeyLock::any_held() && ShardEngine::current_shard() < 0){
+    if (!free_memory_if_needed(ctx.db, ctx.eviction)) return OOM_ERROR;
+  }
+  KeyLock lock(ctx.db);
+  if (!command_blocks(spec, argv)){
+    lock_command_keys(lock, spec, argv);
+    ShardEngine* shards = ctx.db.shards();
+    if (shards && !KeyLock::any_held()){
+      // Keys on a single shard: run it there. Several shards: lock() parks them for us
+      int owner = shards->single_owner(lock.stripes());
+      if (owner >= 0 && owner != ShardEngine::current_shard()){
+        std::string response;
+        auto run = [&]{ response = execute_command(client, ctx, spec, argv); };
+        shards->run_on(owner, run);
+        return response;
+      }
+    }
+    lock.lock();
+  }
+  uint64_t dirty = Keyspace::dirty();
+  std::string response = spec.handler(client, ctx, argv);
+  // Pass writes on to replicas once they took effect, still under the key locks so replicas
+  // see writes to a key in the order they were applied. Only writes that changed something
+  // go out, as the handler rewrote them (XADD * with its ID). Blocking commands are left
+  // out, replaying them could block the replica. A parked pop is propagated as the LPOP /
+  // RPOP it ends up doing, queued with also_propagate like the pops a push serves
+  bool changed = (spec.flags & CMD_WRITE) && !(spec.flags & (CMD_BLOCKING | CMD_PARKS)) &&
+                 Keyspace::dirty() != dirty && !response.starts_with('-');
+  propagate_command(client, argv, changed);
+  return response;
+}
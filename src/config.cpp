@@ -1,31 +1,34 @@
 #include "config.h"
-#include "clear.h"
 #include "lowerCMD.h"
-#include "bulkString.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
 
-std::string config_command(int& items, int client_fd, std::string& read_buffer, Config config){
+std::string config_command(const Argv& argv, const Config& config){
   //error if 1 or 0 items left, like "config get" or "config"
-  if (items <= 1){
+  if (argv.size() <= 2){
     std::string response = "-ERR wrong number of arguments for config command\r\n";
     return response;
   }
   // only work with config get not other config command
-  std::string subCmd = parsebulkString(items, client_fd, read_buffer);
-  subCmd = lowercase_command(subCmd);
+  std::string subCmd = lowercase_command(argv[1]);
   if ( subCmd != "get"){
     std::string response = "-ERR wrong arguments for config command\r\n";
     return response;
   }
-  std::string response = "*" + std::to_string(items*2) + "\r\n";
-  while (items != 0){
-    std::string key  = parsebulkString(items, client_fd, read_buffer);
+  std::string response = "*" + std::to_string((argv.size() - 2)*2) + "\r\n";
+  for (size_t i = 2; i < argv.size(); i++){
+    std::string_view key = argv[i];
     std::string val;
     if (key == "dir") val = config.dir;
     else if (key == "dbfilename") val = config.dbfilename; 
+    else if (key == "maxmemory") val = config.maxmemory;
+    else if (key == "maxmemory-policy") val = config.maxmemoryPolicy;
+    else if (key == "maxmemory-samples") val = config.maxmemorySamples;
+    else if (key == "list-compress-depth") val = config.listCompressDepth;
+    else if (key == "zset-max-listpack-entries") val = config.zsetMaxListpackEntries;
+    else if (key == "zset-max-listpack-value") val = config.zsetMaxListpackValue;
+    else if (key == "stream-node-max-bytes") val = config.streamNodeMaxBytes;
+    else if (key == "stream-node-max-entries") val = config.streamNodeMaxEntries;
+    else if (key == "client-output-buffer-limit") val = "normal " + config.outputLimitNormal + " pubsub " + config.outputLimitPubsub;
     else{
       std::string response = "-ERR config parameter not found \r\n";
       return response;
@@ -33,9 +36,10 @@ std::string config_command(int& items, int client_fd, std::string& read_buffer,
     int keyLen = key.length();
     int valLen = val.length();
     response += "$" + std::to_string(keyLen) + "\r\n";
-    response += key + "\r\n";
+    response.append(key);
+    response += "\r\n";
     response += "$" + std::to_string(valLen) + "\r\n";
     response += val + "\r\n";
   }
   return response;
-}
\ No newline at end of file
+}
@@ -1,17 +1,10 @@
 #include "echo.h"
-#include "bulkString.h"
-#include "clear.h"
 
-std::string echo_command(int& items, int client_fd, std::string& read_buffer){
+std::string echo_command(const Argv& argv){
 
-  if (items == 1){
-    if (read_buffer[0] != '$'){
-      std::string response = "-ERR argument must be bulk string for echo command\r\n";
-      return response;
-    }
-    std::string bulkString = parsebulkString(items, client_fd, read_buffer);
+  if (argv.size() == 2){
     std::string response = "+";
-    response.append(bulkString);
+    response.append(argv[1]);
     response.append("\r\n");
     return response;
   }
@@ -19,4 +12,4 @@ std::string echo_command(int& items, int client_fd, std::string& read_buffer){
     std::string response = "-ERR wrong number of arguments for echo command\r\n";
     return response;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,133 @@
+#include "evict.h"
+#include "memoryUsage.h"
+#include "outputBuffer.h"
+#include "lowerCMD.h"
+
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr size_t POOL_SIZE = 16; // Redis' EVPOOL_SIZE
+
+struct Candidate {
+    uint64_t score; // higher is evicted first
+    size_t stripe;
+    std::string key;
+};
+
+std::mutex evictionMutex; // one evictor at a time, it owns the pool
+std::vector<Candidate> pool; // sorted by score, best last
+
+bool volatile_only(EvictionPolicy policy){
+    return policy == EvictionPolicy::VolatileLru || policy == EvictionPolicy::VolatileTtl;
+}
+
+uint64_t score(EvictionPolicy policy, const RedisObject& obj, uint64_t clock){
+    uint64_t access = std::atomic_ref<const uint64_t>(obj.access).load(std::memory_order_relaxed);
+    switch (policy){
+        case EvictionPolicy::AllKeysLfu:
+            return 255 - access_frequency(access, clock);
+        case EvictionPolicy::VolatileTtl: // sooner deadline first
+            return UINT64_MAX - static_cast<uint64_t>(obj.expiry.time_since_epoch().count());
+        default:
+            return access_idle_ms(access, clock);
+    }
+}
+
+// Samples the stripe into the pool, returns whether it found any key
+bool fill_pool(Keyspace& db, const EvictionConfig& config, size_t stripe, std::minstd_rand& rng){
+    KeyLock lock(db);
+    lock.add_stripe(stripe, false);
+    lock.lock();
+    uint64_t clock = access_clock();
+    bool found = false;
+    db.sample(stripe, rng(), config.samples, volatile_only(config.policy), [&](const std::string& key, RedisObject& obj){
+        found = true;
+        uint64_t s = score(config.policy, obj, clock);
+        if (pool.size() == POOL_SIZE && s <= pool.front().score) return;
+        bool known = std::any_of(pool.begin(), pool.end(), [&](const Candidate& c){ return c.key == key; });
+        if (known) return;
+        if (pool.size() == POOL_SIZE) pool.erase(pool.begin());
+        auto at = std::lower_bound(pool.begin(), pool.end(), s, [](const Candidate& c, uint64_t v){ return c.score < v; });
+        pool.insert(at, {s, stripe, key});
+    });
+    return found;
+}
+
+// Deletes the pool's best candidate if it's still there (and still volatile when
+// the policy says so), returns whether a key went away
+bool evict_best(Keyspace& db, const EvictionConfig& config){
+    Candidate best = std::move(pool.back());
+    pool.pop_back();
+    KeyLock lock(db);
+    lock.add_stripe(best.stripe, true);
+    lock.lock();
+    RedisObject* obj = db.find(best.key);
+    if (!obj) return false;
+    if (volatile_only(config.policy) && obj->expiry == std::chrono::system_clock::time_point{}) return false;
+    db.erase(best.key);
+    eviction_stats().evictedKeys.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace
+
+EvictionConfig parse_eviction_config(const Config& config){
+    EvictionConfig eviction;
+    eviction.maxmemory = parse_size(config.maxmemory);
+    eviction.samples = std::max(1ul, std::stoul(config.maxmemorySamples));
+    std::string policy = lowercase_command(config.maxmemoryPolicy);
+    if (policy == "noeviction") eviction.policy = EvictionPolicy::NoEviction;
+    else if (policy == "allkeys-lru") eviction.policy = EvictionPolicy::AllKeysLru;
+    else if (policy == "allkeys-lfu") eviction.policy = EvictionPolicy::AllKeysLfu;
+    else if (policy == "volatile-lru") eviction.policy = EvictionPolicy::VolatileLru;
+    else if (policy == "volatile-ttl") eviction.policy = EvictionPolicy::VolatileTtl;
+    else throw std::invalid_argument("unknown maxmemory-policy: " + policy);
+    return eviction;
+}
+
+const char* policy_name(EvictionPolicy policy){
+    switch (policy){
+        case EvictionPolicy::NoEviction: return "noeviction";
+        case EvictionPolicy::AllKeysLru: return "allkeys-lru";
+        case EvictionPolicy::AllKeysLfu: return "allkeys-lfu";
+        case EvictionPolicy::VolatileLru: return "volatile-lru";
+        case EvictionPolicy::VolatileTtl: return "volatile-ttl";
+    }
+    return "noeviction";
+}
+
+EvictionStats& eviction_stats(){
+    static EvictionStats stats;
+    return stats;
+}
+
+bool free_memory_if_needed(Keyspace& db, const EvictionConfig& config){
+    if (!config.maxmemory || used_memory() <= config.maxmemory) return true;
+    if (config.policy == EvictionPolicy::NoEviction){
+        eviction_stats().rejectedCommands.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(evictionMutex);
+    static thread_local std::minstd_rand rng{std::random_device{}()};
+    size_t stripe = rng() % Keyspace::STRIPES;
+    size_t emptyRounds = 0; // stripes in a row without a candidate, all of them means nothing to evict
+    while (used_memory() > config.maxmemory && emptyRounds < Keyspace::STRIPES){
+        if (fill_pool(db, config, stripe, rng)){
+            emptyRounds = 0;
+            stripe = rng() % Keyspace::STRIPES;
+        }
+        else {
+            emptyRounds++;
+            stripe = (stripe + 1) % Keyspace::STRIPES;
+        }
+        if (!pool.empty()) evict_best(db, config);
+    }
+    if (used_memory() <= config.maxmemory) return true;
+    eviction_stats().rejectedCommands.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
@@ -0,0 +1,122 @@
+#include "expire.h"
+#include "replication.h"
+
+#include <charconv>
+#include <thread>
+
+namespace {
+
+using namespace std::chrono;
+
+constexpr auto CYCLE_PERIOD = milliseconds(100); // Redis' default hz of 10
+constexpr auto CYCLE_BUDGET = milliseconds(25);  // 25% of the period
+constexpr size_t KEYS_PER_LOCK = 64;             // deletions per stripe lock, then the stripe is let go
+
+bool parse_integer(std::string_view arg, long long& value){
+  auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+  return ec == std::errc() && end == arg.data() + arg.size();
+}
+
+// One pass over the stripes starting at cursor, until nothing is due or the budget
+// is spent. Returns false when it stopped on the budget, cursor then points at
+// the stripe to resume from
+bool expire_cycle(Keyspace& db, size_t& cursor, steady_clock::time_point deadline){
+  bool more = true;
+  while (more){
+    more = false;
+    for (size_t n = 0; n < Keyspace::STRIPES; n++){
+      size_t stripe = (cursor + n) % Keyspace::STRIPES;
+      auto now = system_clock::now();
+      if (!db.stripe_due(stripe, now)) continue;
+      {
+        KeyLock lock(db);
+        lock.add_stripe(stripe, true);
+        lock.lock();
+        more = db.expire_due(stripe, now, KEYS_PER_LOCK) || more;
+      }
+      if (steady_clock::now() >= deadline){
+        cursor = (stripe + 1) % Keyspace::STRIPES;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+static std::string expire_at(Keyspace& db, std::string_view key, system_clock::time_point when, system_clock::time_point now){
+  RedisObject* obj = db.find(key);
+  if (!obj) return ":0\r\n";
+  if (when <= now){ // a deadline in the past deletes the key right away
+    db.erase(key);
+    return ":1\r\n";
+  }
+  db.set_expiry(key, *obj, when);
+  return ":1\r\n";
+}
+
+std::string expire_command(ClientState& client, const Argv& argv, Keyspace& db, milliseconds unit){
+  if (argv.size() != 3) return "-ERR wrong number of arguments for expire command\r\n";
+  long long amount;
+  if (!parse_integer(argv[2], amount)) return "-ERR value is not an integer or out of range\r\n";
+  // system_clock counts nanoseconds, so deadlines past ~2262 don't fit
+  auto now = system_clock::now();
+  long long limit = duration_cast<milliseconds>(system_clock::time_point::max() - now).count() / unit.count();
+  if (amount > limit || amount < -limit) return "-ERR invalid expire time\r\n";
+  auto when = time_point_cast<milliseconds>(now) + amount * unit;
+  rewrite_command(client, {"PEXPIREAT", std::string(argv[1]), std::to_string(when.time_since_epoch().count())});
+  return expire_at(db, argv[1], when, now);
+}
+
+std::string expireat_command(const Argv& argv, Keyspace& db, milliseconds unit){
+  if (argv.size() != 3) return "-ERR wrong number of arguments for expireat command\r\n";
+  long long amount;
+  if (!parse_integer(argv[2], amount)) return "-ERR value is not an integer or out of range\r\n";
+  long long limit = duration_cast<milliseconds>(system_clock::time_point::max().time_since_epoch()).count() / unit.count();
+  if (amount > limit || amount < -limit) return "-ERR invalid expire time\r\n";
+  return expire_at(db, argv[1], system_clock::time_point(amount * unit), system_clock::now());
+}
+
+std::string ttl_command(const Argv& argv, Keyspace& db, milliseconds unit){
+  if (argv.size() != 2) return "-ERR wrong number of arguments for ttl command\r\n";
+  RedisObject* obj = db.find(argv[1]);
+  if (!obj) return ":-2\r\n";
+  if (obj->expiry == system_clock::time_point{}) return ":-1\r\n";
+  long long left = duration_cast<milliseconds>(obj->expiry - system_clock::now()).count();
+  if (left < 0) left = 0;
+  long long per = unit.count();
+  return ":" + std::to_string((left + per / 2) / per) + "\r\n"; // rounded like Redis
+}
+
+std::string expiretime_command(const Argv& argv, Keyspace& db, milliseconds unit){
+  if (argv.size() != 2) return "-ERR wrong number of arguments for expiretime command\r\n";
+  RedisObject* obj = db.find(argv[1]);
+  if (!obj) return ":-2\r\n";
+  if (obj->expiry == system_clock::time_point{}) return ":-1\r\n";
+  return ":" + std::to_string(duration_cast<milliseconds>(obj->expiry.time_since_epoch()).count() / unit.count()) + "\r\n";
+}
+
+std::string persist_command(const Argv& argv, Keyspace& db){
+  if (argv.size() != 2) return "-ERR wrong number of arguments for persist command\r\n";
+  RedisObject* obj = db.find(argv[1]);
+  if (!obj || obj->expiry == system_clock::time_point{}) return ":0\r\n";
+  db.set_expiry(argv[1], *obj, {});
+  return ":1\r\n";
+}
+
+void active_expire_loop(Keyspace& db){
+  ExpireStats& stats = db.expire_stats();
+  size_t cursor = 0;
+  while (true){
+    auto start = steady_clock::now();
+    bool finished = expire_cycle(db, cursor, start + CYCLE_BUDGET);
+    auto spent = steady_clock::now() - start;
+    stats.cycles.fetch_add(1, std::memory_order_relaxed);
+    stats.cycleMicros.fetch_add(duration_cast<microseconds>(spent).count(), std::memory_order_relaxed);
+    if (!finished) stats.timeCapReached.fetch_add(1, std::memory_order_relaxed);
+    // Behind: run again after as long as we ran, so the backlog drains at half a core.
+    // Caught up: back to the normal period
+    std::this_thread::sleep_for(finished ? CYCLE_PERIOD - spent : CYCLE_BUDGET);
+  }
+}
@@ -1,20 +1,16 @@
 #include "geo.h"
-#include "bulkString.h"
+#include "geoDistance.h"
+#include "lowerCMD.h"
+#include <algorithm>
 #include <cstdint>
-#include <iostream>
+#include <cstdio>
+#include <cstdlib>
 #include <cmath>
 #include <utility>
 #include <math.h>
 
-constexpr double MIN_LATITUDE = -85.05112878;
-constexpr double MAX_LATITUDE = 85.05112878;
-constexpr double MIN_LONGITUDE = -180.0;
-constexpr double MAX_LONGITUDE = 180.0;
+#include <immintrin.h>
 
-const double LATITUDE_RANGE = MAX_LATITUDE - MIN_LATITUDE;
-const double LONGITUDE_RANGE = MAX_LONGITUDE - MIN_LONGITUDE;
-
-const static double EarthRadiusKm = 6372797.560856;
 const double PI = 3.14159265358979323846;
 
 uint64_t spread_int32_to_int64(uint32_t v){
@@ -44,15 +40,43 @@ uint32_t compact_int64_to_int32(uint64_t v){
     return v;
 }
 
+// Geohash scores keep latitude in the even bits and longitude in the odd ones. With
+// BMI2, PDEP and PEXT move each coordinate's bits in one instruction instead of the
+// five rounds above, which then stay as the fallback. Zen 1 and 2 have BMI2 but run
+// PDEP/PEXT in microcode, slower than the shifts, so they keep the fallback too
+static uint64_t interleave_shift(uint32_t lat, uint32_t lon){
+    return spread_int32_to_int64(lat) | (spread_int32_to_int64(lon) << 1);
+}
+
+static std::pair<uint32_t, uint32_t> deinterleave_shift(uint64_t bits){
+    return {compact_int64_to_int32(bits), compact_int64_to_int32(bits >> 1)};
+}
+
+__attribute__((target("bmi2"))) static uint64_t interleave_bmi2(uint32_t lat, uint32_t lon){
+    return _pdep_u64(lat, 0x5555555555555555) | _pdep_u64(lon, 0xAAAAAAAAAAAAAAAA);
+}
+
+__attribute__((target("bmi2"))) static std::pair<uint32_t, uint32_t> deinterleave_bmi2(uint64_t bits){
+    return {static_cast<uint32_t>(_pext_u64(bits, 0x5555555555555555)),
+            static_cast<uint32_t>(_pext_u64(bits, 0xAAAAAAAAAAAAAAAA))};
+}
+
+static bool fast_pdep(){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2");
+}
+
+static const bool USE_BMI2 = fast_pdep();
+static uint64_t (*const interleave)(uint32_t lat, uint32_t lon) = USE_BMI2 ? interleave_bmi2 : interleave_shift;
+static std::pair<uint32_t, uint32_t> (*const deinterleave)(uint64_t bits) = USE_BMI2 ? deinterleave_bmi2 : deinterleave_shift;
+
 std::pair<double, double> decodeCoords(uint64_t score){
-    uint64_t longitude = score >> 1;
-    uint64_t lattitude = score;
-    uint32_t compactedLong = compact_int64_to_int32(longitude);
-    uint32_t compactedLat = compact_int64_to_int32(lattitude);
-    double grid_latitude_min = MIN_LATITUDE + LATITUDE_RANGE * (compactedLat / pow(2, 26));
-    double grid_latitude_max = MIN_LATITUDE + LATITUDE_RANGE * ((compactedLat + 1) / pow(2, 26));
-    double grid_longitude_min = MIN_LONGITUDE + LONGITUDE_RANGE * (compactedLong / pow(2, 26));
-    double grid_longitude_max = MIN_LONGITUDE + LONGITUDE_RANGE * ((compactedLong + 1) / pow(2, 26));
+    auto [compactedLat, compactedLong] = deinterleave(score);
+    constexpr double CELLS = 1 << 26; // per coordinate
+    double grid_latitude_min = MIN_LATITUDE + LATITUDE_RANGE * (compactedLat / CELLS);
+    double grid_latitude_max = MIN_LATITUDE + LATITUDE_RANGE * ((compactedLat + 1) / CELLS);
+    double grid_longitude_min = MIN_LONGITUDE + LONGITUDE_RANGE * (compactedLong / CELLS);
+    double grid_longitude_max = MIN_LONGITUDE + LONGITUDE_RANGE * ((compactedLong + 1) / CELLS);
     double lat = (grid_latitude_min + grid_latitude_max) / 2.0;
     double lon = (grid_longitude_min + grid_longitude_max) / 2.0;
     return std::make_pair(lat, lon);
@@ -64,11 +88,7 @@ uint64_t encodeCoords(double lat, double lon){
     double normalized_longitude = x * (lon - MIN_LONGITUDE) / LONGITUDE_RANGE;
     uint32_t normalLatitude = static_cast<uint32_t>(normalized_latitude);
     uint32_t normalLongitude = static_cast<uint32_t>(normalized_longitude);
-    uint64_t interleavedLat = spread_int32_to_int64(normalLatitude);
-    uint64_t interleavedLong = spread_int32_to_int64(normalLongitude);
-    uint64_t shiftedLong = interleavedLong << 1;
-    uint64_t score = interleavedLat | shiftedLong;
-    return score;
+    return interleave(normalLatitude, normalLongitude);
 }
 
 double haversine(uint64_t score1, uint64_t score2){
@@ -88,36 +108,57 @@ double haversine(uint64_t score1, uint64_t score2){
 	double diffLo = lonRad2 - lonRad1;
 
     double computation = asin(sqrt(sin(diffLa / 2) * sin(diffLa / 2) + cos(latRad1) * cos(latRad2) * sin(diffLo / 2) * sin(diffLo / 2)));
-    double distance  = 2 * EarthRadiusKm * computation;
+    double distance  = 2 * EARTH_RADIUS * computation;
     return distance;
 }
 
-std::string geoadd_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets){
-        if (items == 4){
-            std::string response = "";
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            double longitude = std::stod(parsebulkString(items, client_fd, read_buffer));
-            double latitude = std::stod(parsebulkString(items, client_fd, read_buffer));
-            std::string name = parsebulkString(items, client_fd, read_buffer);
-
-            if(longitude > MAX_LONGITUDE || longitude < MIN_LONGITUDE ||
-            latitude > MAX_LATITUDE || latitude < MIN_LATITUDE)
-            {
-                std::string response = "-ERR invalid longitude,latitude pair " + std::to_string(longitude) + "," +std::to_string(latitude) +"\r\n";
-                return response;
-            }
+static const std::string NOT_FLOAT = "-ERR value is not a valid float\r\n";
+static const std::string SYNTAX_ERROR = "-ERR syntax error\r\n";
 
-            uint64_t score = encodeCoords(latitude, longitude);
+static bool parse_double(std::string_view arg, double& value){
+    std::string text(arg);
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size() && !std::isnan(value);
+}
 
-            SkipList& sl = sets[listName];
+// GEOADD key [NX | XX] [CH] longitude latitude member [longitude latitude member ...]
+// Every pair is checked before anything is added, then they all go to ZADD in one call
+std::string geoadd_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 5){
+            size_t first = 2;
+            bool nx = false, xx = false;
+            for (; first < argv.size(); first++) {
+                std::string flag = lowercase_command(argv[first]);
+                if (flag == "nx") nx = true;
+                else if (flag == "xx") xx = true;
+                else if (flag != "ch") break;
+            }
+            size_t items = argv.size() - first;
+            if (items == 0 || items % 3 || (nx && xx)) return SYNTAX_ERROR;
+
+            std::vector<std::string> scores(items / 3);
+            for (size_t i = 0; i < scores.size(); i++) {
+                double longitude, latitude;
+                if (!parse_double(argv[first + 3 * i], longitude) || !parse_double(argv[first + 3 * i + 1], latitude)) return NOT_FLOAT;
+                if(longitude > MAX_LONGITUDE || longitude < MIN_LONGITUDE ||
+                latitude > MAX_LATITUDE || latitude < MIN_LATITUDE)
+                {
+                    std::string response = "-ERR invalid longitude,latitude pair " + std::to_string(longitude) + "," +std::to_string(latitude) +"\r\n";
+                    return response;
+                }
+                scores[i] = std::to_string(encodeCoords(latitude, longitude));
+            }
 
-            int tempItems = 3;
-            std::string message = "$" + std::to_string(listName.size())+ "\r\n" + listName + "\r\n";
-            message += "$" + std::to_string(std::to_string(score).size())+ "\r\n" + std::to_string(score) + "\r\n";
-            message += "$" + std::to_string(name.size())+ "\r\n" + name + "\r\n";
-            response = zadd_command(tempItems,client_fd,message, sets);
-            return response;
+            // zadd key [flags] score member ...
+            Argv zaddArgv(argv.begin(), argv.begin() + first);
+            zaddArgv[0] = "zadd";
+            zaddArgv.reserve(first + 2 * scores.size());
+            for (size_t i = 0; i < scores.size(); i++) {
+                zaddArgv.push_back(scores[i]);
+                zaddArgv.push_back(argv[first + 3 * i + 2]);
+            }
+            return zadd_command(zaddArgv, db);
         }
         else{
             std::string response = "-ERR wrong number of arguments for geoadd command\r\n";
@@ -125,47 +166,38 @@ std::string geoadd_command(int& items, int client_fd, std::string& read_buffer,
         }
     }
 
-std::string geopos_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets){
-        if (items >= 2){
+std::string geopos_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 3){
 
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
             std::string response = "";
-            int itemsCopy = items;
+            int itemsCopy = argv.size() - 2;
             response += "*"+std::to_string(itemsCopy)+"\r\n";
 
-            auto it = sets.find(listName);
-            if(it == sets.end()){
-                std::cout << "not found" << std::endl;
-                for(int i = 0; i < items; i++){
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if(!found){
+                for(int i = 0; i < itemsCopy; i++){
                     response += "*-1\r\n";
                 }
                 return response;
             }
 
-            SkipList& sl = it->second;
+            ZSet& zs = *found;
 
             for(int i = 0; i < itemsCopy; i++){
-                uint64_t score = 0;
-                std::string name = parsebulkString(items, client_fd, read_buffer);
-                Node* prev = sl.head;
-                for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                    if (n->key == name) {
-                        score = n->score;
-                        break;
-                    }
-                }
-                if (score == 0){
+                double memberScore;
+                if (!zs.score(argv[i + 2], memberScore)){
                     response += "*-1\r\n";
                     continue;
                 }
+                uint64_t score = memberScore;
                 auto coords = decodeCoords(score);
                 double lat = coords.first;
                 double lon = coords.second;
                 response += "*2\r\n";
                 response += "$"+ std::to_string(std::to_string(lon).size()) + "\r\n" + std::to_string(lon) + "\r\n";
                 response += "$"+ std::to_string(std::to_string(lat).size()) + "\r\n" + std::to_string(lat) + "\r\n";
-                std::cout << response << std::endl;
             }
             return response;
 
@@ -176,37 +208,21 @@ std::string geopos_command(int& items, int client_fd, std::string& read_buffer,
         }
     }
 
-std::string geodist_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets){
-        if(items == 3){
+std::string geodist_command(const Argv& argv, Keyspace& db){
+        if(argv.size() == 4){
             std::string response = "";
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            auto it = sets.find(listName);
-            if (it == sets.end()){
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found){
                 response = "-ERR could not find set \r\n";
                 return response;
             }
-            SkipList& sl = it->second;
-            std::string loc1 = parsebulkString(items, client_fd, read_buffer);
-            std::string loc2 = parsebulkString(items, client_fd, read_buffer);
-            Node* prev = sl.head;
-            uint64_t score1 = -1;
-            for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                if (n->key == loc1) {
-                    score1 = n->score;
-                    break;
-                }
-            }
-            prev = sl.head;
-            uint64_t score2 = -1;
-            for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                if (n->key == loc2) {
-                    score2 = n->score;
-                    break;
-                }
-            }
+            ZSet& zs = *found;
+            double loc1, loc2;
+            if (!zs.score(argv[2], loc1) || !zs.score(argv[3], loc2)) return "$-1\r\n";
 
-            double distance  = haversine(score1, score2);
+            double distance  = haversine(loc1, loc2);
 
             std::string strDistance = std::to_string(distance);
             response += "$" + std::to_string(strDistance.size()) + "\r\n";
@@ -219,50 +235,352 @@ std::string geodist_command(int& items, int client_fd, std::string& read_buffer,
         }
     }
 
-std::string geosearch_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, SkipList>& sets){
-        if(items == 7){
-            std::string response = "";
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            auto it = sets.find(listName);
-            if (it == sets.end()){
-                response = "-ERR could not find set \r\n";
-                return response;
+struct GeoQuery {
+    GeoShape shape;
+    bool fromMember = false, fromLonLat = false;
+    bool byRadius = false;
+    std::string_view member;
+    int sort = 0; // 1 ASC, -1 DESC, 0 as found
+    size_t count = 0; // 0 is all
+    bool any = false;
+    bool withCoord = false, withDist = false, withHash = false;
+    bool storeDist = false;
+};
+
+struct GeoMatch {
+    std::string_view member;
+    double score;
+    double dist; // meters
+};
+
+constexpr double MERCATOR_MAX = 20037726.37;
+constexpr int GEO_STEP_MAX = 26;
+
+static double deg_rad(double deg){ return deg * (PI / 180.0); }
+static double rad_deg(double rad){ return rad / (PI / 180.0); }
+
+// The cell a score falls in, at step bits per coordinate: its corners
+struct GeoArea {
+    double lonMin, lonMax, latMin, latMax;
+};
+
+static GeoArea cell_area(uint64_t bits, int step){
+    double cells = static_cast<double>(uint64_t(1) << step);
+    auto [latIndex, lonIndex] = deinterleave(bits);
+    return GeoArea{MIN_LONGITUDE + LONGITUDE_RANGE * (lonIndex / cells), MIN_LONGITUDE + LONGITUDE_RANGE * ((lonIndex + 1) / cells),
+                   MIN_LATITUDE + LATITUDE_RANGE * (latIndex / cells), MIN_LATITUDE + LATITUDE_RANGE * ((latIndex + 1) / cells)};
+}
+
+// Neighbouring cells, like Redis' geohash_move_x / geohash_move_y: longitude sits in the
+// odd bits, latitude in the even ones, and each is stepped with a carry through its own
+// bits only. Moving off one edge wraps to the other
+static uint64_t move_lon(uint64_t bits, int step, int d){
+    uint64_t x = bits & 0xaaaaaaaaaaaaaaaaULL;
+    uint64_t y = bits & 0x5555555555555555ULL;
+    uint64_t zz = 0x5555555555555555ULL >> (64 - step * 2);
+    if (d > 0) x = x + (zz + 1);
+    else {
+        x = x | zz;
+        x = x - (zz + 1);
+    }
+    x &= 0xaaaaaaaaaaaaaaaaULL >> (64 - step * 2);
+    return x | y;
+}
+
+static uint64_t move_lat(uint64_t bits, int step, int d){
+    uint64_t x = bits & 0xaaaaaaaaaaaaaaaaULL;
+    uint64_t y = bits & 0x5555555555555555ULL;
+    uint64_t zz = 0xaaaaaaaaaaaaaaaaULL >> (64 - step * 2);
+    if (d > 0) y = y + (zz + 1);
+    else {
+        y = y | zz;
+        y = y - (zz + 1);
+    }
+    y &= 0x5555555555555555ULL >> (64 - step * 2);
+    return x | y;
+}
+
+// The coarsest cells still about as small as the search radius, as Redis estimates them
+static int steps_for_radius(double meters, double lat){
+    if (meters == 0) return GEO_STEP_MAX;
+    int step = 1;
+    while (meters < MERCATOR_MAX) {
+        meters *= 2;
+        step++;
+    }
+    step -= 2; // the 9 cells cover the radius
+    // Cells get narrower towards the poles
+    if (lat > 66 || lat < -66) {
+        step--;
+        if (lat > 80 || lat < -80) step--;
+    }
+    return step < 1 ? 1 : step > GEO_STEP_MAX ? GEO_STEP_MAX : step;
+}
+
+// Score intervals [min, max) to scan for shape: the center's cell at a precision about
+// the size of the shape, and those of its 8 neighbours the shape reaches into. Like
+// Redis' geohashGetAreasByShapeWGS84
+static std::vector<std::pair<uint64_t, uint64_t>> covering_ranges(const GeoShape& shape){
+    double halfHeight = shape.box ? shape.height / 2 : shape.radius;
+    double halfWidth = shape.box ? shape.width / 2 : shape.radius;
+    double latDelta = rad_deg(halfHeight / EARTH_RADIUS);
+    double lonDeltaTop = rad_deg(halfWidth / EARTH_RADIUS / cos(deg_rad(shape.lat + latDelta)));
+    double lonDeltaBottom = rad_deg(halfWidth / EARTH_RADIUS / cos(deg_rad(shape.lat - latDelta)));
+    // The bounding box is widest on the side nearer the equator
+    double lonDelta = shape.lat < 0 ? lonDeltaBottom : lonDeltaTop;
+    double minLon = shape.lon - lonDelta, maxLon = shape.lon + lonDelta;
+    double minLat = shape.lat - latDelta, maxLat = shape.lat + latDelta;
+
+    double radius = shape.box ? sqrt(halfWidth * halfWidth + halfHeight * halfHeight) : shape.radius;
+    int step = steps_for_radius(radius, shape.lat);
+    uint64_t full = encodeCoords(shape.lat, shape.lon);
+    uint64_t center = full >> (52 - step * 2);
+
+    // Near a cell's edge the estimate may leave part of the shape outside the 9 cells
+    if (step > 1) {
+        GeoArea north = cell_area(move_lat(center, step, 1), step);
+        GeoArea south = cell_area(move_lat(center, step, -1), step);
+        GeoArea east = cell_area(move_lon(center, step, 1), step);
+        GeoArea west = cell_area(move_lon(center, step, -1), step);
+        if (north.latMax < maxLat || south.latMin > minLat || east.lonMax < maxLon || west.lonMin > minLon) {
+            step--;
+            center = full >> (52 - step * 2);
+        }
+    }
+
+    GeoArea area = cell_area(center, step);
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (int dlat = -1; dlat <= 1; dlat++) {
+        for (int dlon = -1; dlon <= 1; dlon++) {
+            // Neighbours on a side the shape doesn't reach are skipped
+            if (step >= 2) {
+                if (dlat < 0 && area.latMin < minLat) continue;
+                if (dlat > 0 && area.latMax > maxLat) continue;
+                if (dlon < 0 && area.lonMin < minLon) continue;
+                if (dlon > 0 && area.lonMax > maxLon) continue;
             }
-            SkipList& sl = it->second;
-            std::string fromlonlat = parsebulkString(items, client_fd, read_buffer);
-            double lon = std::stod(parsebulkString(items, client_fd, read_buffer));
-            double lat = std::stod(parsebulkString(items, client_fd, read_buffer));
-            uint64_t newscore = encodeCoords(lat,lon);
-            std::string byradius = parsebulkString(items, client_fd, read_buffer);
-            double distance = std::stod(parsebulkString(items, client_fd, read_buffer));
-            std::string units = parsebulkString(items, client_fd, read_buffer);
-            if(units == "km"){
-                distance *= 1000;
+            uint64_t cell = center;
+            if (dlat) cell = move_lat(cell, step, dlat);
+            if (dlon) cell = move_lon(cell, step, dlon);
+            std::pair<uint64_t, uint64_t> range{cell << (52 - step * 2), (cell + 1) << (52 - step * 2)};
+            // Coarse cells wrap onto each other
+            if (std::find(ranges.begin(), ranges.end(), range) == ranges.end()) ranges.push_back(range);
+        }
+    }
+    return ranges;
+}
+
+// Seeks to each covering interval and hands its members to geo_filter a block at a
+// time, then takes each match's distance from geo_distance. COUNT ANY stops after the
+// block that reaches count matches
+static std::vector<GeoMatch> geo_search(const ZSet& zs, const GeoQuery& query){
+    constexpr size_t BLOCK = 256;
+    GeoFilter filter = geo_prepare(query.shape);
+    std::vector<GeoMatch> matches;
+    size_t limit = query.any ? query.count : 0;
+    double scores[BLOCK];
+    std::string_view members[BLOCK];
+    uint32_t matched[BLOCK];
+    size_t pending = 0;
+    auto flush = [&]{
+        size_t found = geo_filter(filter, scores, pending, matched);
+        for (size_t k = 0; k < found; k++) {
+            double score = scores[matched[k]];
+            auto [lat, lon] = decodeCoords(static_cast<uint64_t>(score));
+            matches.push_back(GeoMatch{members[matched[k]], score, geo_distance(query.shape.lon, query.shape.lat, lon, lat)});
+        }
+        pending = 0;
+        return !limit || matches.size() < limit;
+    };
+    for (auto [min, max] : covering_ranges(query.shape)) {
+        bool more = true;
+        zs.for_scores(static_cast<double>(min), static_cast<double>(max), [&](double score, std::string_view member){
+            scores[pending] = score;
+            members[pending] = member;
+            if (++pending < BLOCK) return true;
+            return more = flush();
+        });
+        if (!more || !flush()) break;
+    }
+    // COUNT without ANY means the nearest ones
+    int sort = query.sort == 0 && query.count && !query.any ? 1 : query.sort;
+    if (sort > 0) std::stable_sort(matches.begin(), matches.end(), [](const GeoMatch& a, const GeoMatch& b){ return a.dist < b.dist; });
+    if (sort < 0) std::stable_sort(matches.begin(), matches.end(), [](const GeoMatch& a, const GeoMatch& b){ return a.dist > b.dist; });
+    if (query.count && matches.size() > query.count) matches.resize(query.count);
+    return matches;
+}
+
+static bool parse_unit(std::string_view arg, double& conversion){
+    std::string unit = lowercase_command(arg);
+    if (unit == "m") conversion = 1;
+    else if (unit == "km") conversion = 1000;
+    else if (unit == "ft") conversion = 0.3048;
+    else if (unit == "mi") conversion = 1609.34;
+    else return false;
+    return true;
+}
+
+static const std::string BAD_UNIT = "-ERR unsupported unit provided. please use M, KM, FT, MI\r\n";
+
+// GEOSEARCH's arguments from argv[first], the ones after the key. Returns an error
+// reply, or "" when query is filled in
+static std::string parse_geo_query(const Argv& argv, size_t first, bool store, GeoQuery& query){
+    for (size_t i = first; i < argv.size(); i++) {
+        std::string option = lowercase_command(argv[i]);
+        size_t left = argv.size() - i - 1;
+        if (option == "frommember" && left >= 1) {
+            if (query.fromMember || query.fromLonLat) return SYNTAX_ERROR;
+            query.fromMember = true;
+            query.member = argv[++i];
+        }
+        else if (option == "fromlonlat" && left >= 2) {
+            if (query.fromMember || query.fromLonLat) return SYNTAX_ERROR;
+            query.fromLonLat = true;
+            if (!parse_double(argv[i + 1], query.shape.lon) || !parse_double(argv[i + 2], query.shape.lat)) return NOT_FLOAT;
+            if (query.shape.lon > MAX_LONGITUDE || query.shape.lon < MIN_LONGITUDE ||
+                query.shape.lat > MAX_LATITUDE || query.shape.lat < MIN_LATITUDE) {
+                return "-ERR invalid longitude,latitude pair " + std::to_string(query.shape.lon) + "," + std::to_string(query.shape.lat) + "\r\n";
             }
-            else if (units == "mi"){
-                distance *= 1.60934;
+            i += 2;
+        }
+        else if (option == "byradius" && left >= 2) {
+            if (query.shape.box || query.byRadius) return SYNTAX_ERROR;
+            query.byRadius = true;
+            if (!parse_double(argv[i + 1], query.shape.radius)) return "-ERR need numeric radius\r\n";
+            if (query.shape.radius < 0) return "-ERR radius cannot be negative\r\n";
+            if (!parse_unit(argv[i + 2], query.shape.conversion)) return BAD_UNIT;
+            query.shape.radius *= query.shape.conversion;
+            i += 2;
+        }
+        else if (option == "bybox" && left >= 3) {
+            if (query.shape.box || query.byRadius) return SYNTAX_ERROR;
+            query.shape.box = true;
+            if (!parse_double(argv[i + 1], query.shape.width) || !parse_double(argv[i + 2], query.shape.height)) return NOT_FLOAT;
+            if (query.shape.width < 0 || query.shape.height < 0) return "-ERR height or width cannot be negative\r\n";
+            if (!parse_unit(argv[i + 3], query.shape.conversion)) return BAD_UNIT;
+            query.shape.width *= query.shape.conversion;
+            query.shape.height *= query.shape.conversion;
+            i += 3;
+        }
+        else if (option == "asc") query.sort = 1;
+        else if (option == "desc") query.sort = -1;
+        else if (option == "count" && left >= 1) {
+            int64_t count;
+            if (!parse_int64(argv[i + 1], count)) return "-ERR value is not an integer or out of range\r\n";
+            if (count <= 0) return "-ERR COUNT must be > 0\r\n";
+            query.count = count;
+            i++;
+            if (i + 1 < argv.size() && lowercase_command(argv[i + 1]) == "any") {
+                query.any = true;
+                i++;
             }
+        }
+        else if (!store && option == "withcoord") query.withCoord = true;
+        else if (!store && option == "withdist") query.withDist = true;
+        else if (!store && option == "withhash") query.withHash = true;
+        else if (store && option == "storedist") query.storeDist = true;
+        else return SYNTAX_ERROR;
+    }
+    if (query.fromMember == query.fromLonLat) {
+        return "-ERR exactly one of FROMMEMBER or FROMLONLAT can be specified for GEOSEARCH\r\n";
+    }
+    if (!query.shape.box && !query.byRadius) {
+        return "-ERR exactly one of BYRADIUS and BYBOX can be specified for GEOSEARCH\r\n";
+    }
+    return "";
+}
 
-            std::vector<std::string > inRange;
-            for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                double dist = haversine(newscore, n->score);
-                if (distance >= dist){
-                    inRange.push_back(n->key);
-                }
-            }
+// Coordinates the way Redis prints long doubles: 17 decimals, trailing zeros dropped
+static std::string format_coord(double value){
+    char buf[64];
+    int n = std::snprintf(buf, sizeof(buf), "%.17Lf", static_cast<long double>(value));
+    while (n > 1 && buf[n - 1] == '0') n--;
+    if (n > 1 && buf[n - 1] == '.') n--;
+    return std::string(buf, n);
+}
 
-            response += "*" + std::to_string(inRange.size()) + "\r\n";
-            for (std::string s : inRange){
-                response += "$" + std::to_string(s.size()) + "\r\n";
-                response += s + "\r\n";
-            }
+static std::string geo_bulk(std::string_view s){
+    std::string response = "$" + std::to_string(s.size()) + "\r\n";
+    response.append(s);
+    response += "\r\n";
+    return response;
+}
 
-            return response;
+// The query's center: FROMLONLAT's, or FROMMEMBER's position. False if the member is missing
+static bool resolve_center(const ZSet& zs, GeoQuery& query){
+    if (!query.fromMember) return true;
+    double score;
+    if (!zs.score(query.member, score)) return false;
+    auto [lat, lon] = decodeCoords(static_cast<uint64_t>(score));
+    query.shape.lat = lat;
+    query.shape.lon = lon;
+    return true;
+}
 
+// GEOSEARCH key <FROMMEMBER member | FROMLONLAT lon lat> <BYRADIUS r unit | BYBOX w h unit>
+//           [ASC | DESC] [COUNT n [ANY]] [WITHCOORD] [WITHDIST] [WITHHASH]
+std::string geosearch_command(const Argv& argv, Keyspace& db){
+        if(argv.size() >= 7){
+            GeoQuery query;
+            std::string error = parse_geo_query(argv, 2, false, query);
+            if (!error.empty()) return error;
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found) return "*0\r\n";
+            if (!resolve_center(*found, query)) return "-ERR could not decode requested zset member\r\n";
+
+            std::vector<GeoMatch> matches = geo_search(*found, query);
+            size_t fields = 1 + query.withDist + query.withHash + query.withCoord;
+            std::string response = "*" + std::to_string(matches.size()) + "\r\n";
+            for (const GeoMatch& match : matches) {
+                if (fields > 1) response += "*" + std::to_string(fields) + "\r\n";
+                response += geo_bulk(match.member);
+                if (query.withDist) {
+                    char buf[64];
+                    int n = std::snprintf(buf, sizeof(buf), "%.4f", match.dist / query.shape.conversion);
+                    response += geo_bulk(std::string_view(buf, n));
+                }
+                if (query.withHash) response += ":" + std::to_string(static_cast<uint64_t>(match.score)) + "\r\n";
+                if (query.withCoord) {
+                    auto [lat, lon] = decodeCoords(static_cast<uint64_t>(match.score));
+                    response += "*2\r\n" + geo_bulk(format_coord(lon)) + geo_bulk(format_coord(lat));
+                }
+            }
+            return response;
         }
         else{
             std::string response = "-ERR wrong number of arguments for geosearch command\r\n";
             return response;
         }
-    }
\ No newline at end of file
+    }
+
+// GEOSEARCHSTORE destination source ... [STOREDIST]: the matches replace destination,
+// scored by their geohash, or with STOREDIST by their distance in the query's unit
+std::string geosearchstore_command(const Argv& argv, Keyspace& db){
+        if(argv.size() >= 8){
+            GeoQuery query;
+            std::string error = parse_geo_query(argv, 3, true, query);
+            if (!error.empty()) return error;
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[2], wrongType);
+            if (wrongType) return WRONGTYPE;
+
+            std::vector<std::pair<double, std::string>> stored; // copied, source may be destination
+            if (found) {
+                if (!resolve_center(*found, query)) return "-ERR could not decode requested zset member\r\n";
+                for (const GeoMatch& match : geo_search(*found, query)) {
+                    stored.emplace_back(query.storeDist ? match.dist / query.shape.conversion : match.score, match.member);
+                }
+            }
+            db.erase(argv[1]);
+            if (stored.empty()) return ":0\r\n"; // empty sorted sets don't exist
+            ZSet* destination = db.lookup_or_create<ZSet>(argv[1], wrongType);
+            for (const auto& [score, member] : stored) destination->insert(score, member);
+            return ":" + std::to_string(stored.size()) + "\r\n";
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for geosearchstore command\r\n";
+            return response;
+        }
+    }
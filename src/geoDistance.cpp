@@ -0,0 +1,305 @@
+#include "geoDistance.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+// GCC 12's AVX-512 intrinsics start from a self initialized "undefined" vector, which
+// -Wmaybe-uninitialized reports inside the header (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double DEG_RAD = PI / 180;
+constexpr double DEG_HALF_RAD = PI / 360;
+
+// A score's cell center is base + index * step on each axis
+constexpr double CELLS = 1 << 26;
+constexpr double LAT_STEP = LATITUDE_RANGE / CELLS;
+constexpr double LON_STEP = LONGITUDE_RANGE / CELLS;
+constexpr double LAT_BASE = MIN_LATITUDE + LAT_STEP / 2;
+constexpr double LON_BASE = MIN_LONGITUDE + LON_STEP / 2;
+
+// Adding 2^52 to an integer below it leaves the integer in the low mantissa bits, and
+// 1.5 * 2^52 does the same for small negative ones: converts without AVX-512DQ
+constexpr double TWO_52 = 4503599627370496.0;
+constexpr double ROUND_MAGIC = 6755399441055744.0;
+
+// sin and cos take x = k π/2 + r, |r| <= π/4, with π/2 in two parts so r keeps its bits.
+// The arguments here stay within ±π, where Taylor terms up to r^17 / r^18 land within an
+// ulp of libm: close enough to decide a match, not to reply its distance
+constexpr double TWO_BY_PI = 2 / PI;
+constexpr double PIO2_HI = 1.5707963267948966;
+constexpr double PIO2_LO = 6.123233995736766e-17;
+constexpr double SIN_TERMS[] = {-1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800,
+                                1.0 / 6227020800, -1.0 / 1307674368000, 1.0 / 355687428096000};
+constexpr double COS_TERMS[] = {-1.0 / 2, 1.0 / 24, -1.0 / 720, 1.0 / 40320, -1.0 / 3628800, 1.0 / 479001600,
+                                -1.0 / 87178291200, 1.0 / 20922789888000, -1.0 / 6402373705728000};
+constexpr int SIN_COUNT = sizeof(SIN_TERMS) / sizeof(SIN_TERMS[0]);
+constexpr int COS_COUNT = sizeof(COS_TERMS) / sizeof(COS_TERMS[0]);
+
+uint64_t compact(uint64_t v){
+    v &= 0x5555555555555555;
+    v = (v | (v >> 1)) & 0x3333333333333333;
+    v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0F;
+    v = (v | (v >> 4)) & 0x00FF00FF00FF00FF;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFF;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFF;
+    return v;
+}
+
+// sin²(x) and |cos x| for |x| <= π
+void sin2_cos(double x, double& sin2, double& cosAbs){
+    double k = std::nearbyint(x * TWO_BY_PI);
+    double r = (x - k * PIO2_HI) - k * PIO2_LO;
+    double z = r * r;
+    double ps = SIN_TERMS[SIN_COUNT - 1];
+    for (int j = SIN_COUNT - 2; j >= 0; j--) ps = ps * z + SIN_TERMS[j];
+    double pc = COS_TERMS[COS_COUNT - 1];
+    for (int j = COS_COUNT - 2; j >= 0; j--) pc = pc * z + COS_TERMS[j];
+    double s = r + r * z * ps;
+    double c = 1 + z * pc;
+    // An odd quadrant swaps them, signs don't matter here
+    bool odd = static_cast<int64_t>(k) & 1;
+    sin2 = odd ? c * c : s * s;
+    cosAbs = std::fabs(odd ? s : c);
+}
+
+size_t filter_scalar(const GeoFilter& f, const double* scores, size_t n, uint32_t* matched){
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bits = static_cast<uint64_t>(scores[i]);
+        double lat = LAT_BASE + static_cast<double>(compact(bits)) * LAT_STEP;
+        double lon = LON_BASE + static_cast<double>(compact(bits >> 1)) * LON_STEP;
+        double dLat = lat - f.lat, dLon = lon - f.lon;
+        double absDLon = std::fabs(dLon);
+        if (std::fabs(dLat) > f.maxDLat || std::min(absDLon, 360 - absDLon) > f.maxDLon) continue;
+
+        double latSin2, lonSin2, cosLat, unused;
+        sin2_cos(dLat * DEG_HALF_RAD, latSin2, unused);
+        sin2_cos(dLon * DEG_HALF_RAD, lonSin2, unused);
+        sin2_cos(lat * DEG_RAD, unused, cosLat);
+        double h = latSin2 + f.cosLat * cosLat * lonSin2;
+        bool inside = f.box ? cosLat * cosLat * lonSin2 <= f.maxLonHav : h <= f.maxHav;
+        if (!inside) continue;
+        matched[found++] = static_cast<uint32_t>(i);
+    }
+    return found;
+}
+
+#define GEO_AVX2 __attribute__((target("avx2,fma")))
+#define GEO_AVX512 __attribute__((target("avx512f")))
+
+GEO_AVX2 inline __m256d compact4(__m256i v){
+    v = _mm256_and_si256(v, _mm256_set1_epi64x(0x5555555555555555));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 1)), _mm256_set1_epi64x(0x3333333333333333));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 2)), _mm256_set1_epi64x(0x0F0F0F0F0F0F0F0F));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 4)), _mm256_set1_epi64x(0x00FF00FF00FF00FF));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 8)), _mm256_set1_epi64x(0x0000FFFF0000FFFF));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 16)), _mm256_set1_epi64x(0x00000000FFFFFFFF));
+    __m256d magic = _mm256_set1_pd(TWO_52);
+    return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(v, _mm256_castpd_si256(magic))), magic);
+}
+
+GEO_AVX2 inline void sin2_cos4(__m256d x, __m256d& sin2, __m256d& cosAbs){
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(TWO_BY_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(PIO2_LO), _mm256_fnmadd_pd(k, _mm256_set1_pd(PIO2_HI), x));
+    __m256d z = _mm256_mul_pd(r, r);
+    __m256d ps = _mm256_set1_pd(SIN_TERMS[SIN_COUNT - 1]);
+    for (int j = SIN_COUNT - 2; j >= 0; j--) ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(SIN_TERMS[j]));
+    __m256d pc = _mm256_set1_pd(COS_TERMS[COS_COUNT - 1]);
+    for (int j = COS_COUNT - 2; j >= 0; j--) pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(COS_TERMS[j]));
+    __m256d s = _mm256_fmadd_pd(_mm256_mul_pd(r, z), ps, r);
+    __m256d c = _mm256_fmadd_pd(z, pc, _mm256_set1_pd(1));
+    __m256i one = _mm256_set1_epi64x(1);
+    __m256i kBits = _mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(ROUND_MAGIC)));
+    __m256d odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(kBits, one), one));
+    sin2 = _mm256_blendv_pd(_mm256_mul_pd(s, s), _mm256_mul_pd(c, c), odd);
+    cosAbs = _mm256_andnot_pd(_mm256_set1_pd(-0.0), _mm256_blendv_pd(c, s, odd));
+}
+
+GEO_AVX2 size_t filter_avx2(const GeoFilter& f, const double* scores, size_t n, uint32_t* matched){
+    const __m256d magic = _mm256_set1_pd(TWO_52);
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    size_t found = 0;
+    for (size_t i = 0; i < n; i += 4) {
+        __m256d score;
+        int lanes = 0xF;
+        if (i + 4 <= n) score = _mm256_loadu_pd(scores + i);
+        else {
+            double tail[4] = {0, 0, 0, 0};
+            std::memcpy(tail, scores + i, (n - i) * sizeof(double));
+            score = _mm256_loadu_pd(tail);
+            lanes = (1 << (n - i)) - 1;
+        }
+        // Deinterleave: latitude in the even bits, longitude in the odd ones
+        __m256i bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(score, magic)), _mm256_castpd_si256(magic));
+        __m256d lat = _mm256_fmadd_pd(compact4(bits), _mm256_set1_pd(LAT_STEP), _mm256_set1_pd(LAT_BASE));
+        __m256d lon = _mm256_fmadd_pd(compact4(_mm256_srli_epi64(bits, 1)), _mm256_set1_pd(LON_STEP), _mm256_set1_pd(LON_BASE));
+        __m256d dLat = _mm256_sub_pd(lat, _mm256_set1_pd(f.lat));
+        __m256d dLon = _mm256_sub_pd(lon, _mm256_set1_pd(f.lon));
+        __m256d absDLon = _mm256_andnot_pd(signBit, dLon);
+        absDLon = _mm256_min_pd(absDLon, _mm256_sub_pd(_mm256_set1_pd(360), absDLon));
+        __m256d near = _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(signBit, dLat), _mm256_set1_pd(f.maxDLat), _CMP_LE_OQ),
+                                     _mm256_cmp_pd(absDLon, _mm256_set1_pd(f.maxDLon), _CMP_LE_OQ));
+        lanes &= _mm256_movemask_pd(near);
+        if (!lanes) continue;
+
+        __m256d latSin2, lonSin2, cosLat, unused;
+        sin2_cos4(_mm256_mul_pd(dLat, _mm256_set1_pd(DEG_HALF_RAD)), latSin2, unused);
+        sin2_cos4(_mm256_mul_pd(dLon, _mm256_set1_pd(DEG_HALF_RAD)), lonSin2, unused);
+        sin2_cos4(_mm256_mul_pd(lat, _mm256_set1_pd(DEG_RAD)), unused, cosLat);
+        __m256d h = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_set1_pd(f.cosLat), cosLat), lonSin2, latSin2);
+        __m256d inside = f.box ? _mm256_cmp_pd(_mm256_mul_pd(_mm256_mul_pd(cosLat, cosLat), lonSin2), _mm256_set1_pd(f.maxLonHav), _CMP_LE_OQ)
+                               : _mm256_cmp_pd(h, _mm256_set1_pd(f.maxHav), _CMP_LE_OQ);
+        lanes &= _mm256_movemask_pd(inside);
+        for (; lanes; lanes &= lanes - 1) matched[found++] = static_cast<uint32_t>(i + __builtin_ctz(lanes));
+    }
+    return found;
+}
+
+GEO_AVX512 inline __m512d compact8(__m512i v){
+    v = _mm512_and_si512(v, _mm512_set1_epi64(0x5555555555555555));
+    v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi64(v, 1)), _mm512_set1_epi64(0x3333333333333333));
+    v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi64(v, 2)), _mm512_set1_epi64(0x0F0F0F0F0F0F0F0F));
+    v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi64(v, 4)), _mm512_set1_epi64(0x00FF00FF00FF00FF));
+    v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi64(v, 8)), _mm512_set1_epi64(0x0000FFFF0000FFFF));
+    v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi64(v, 16)), _mm512_set1_epi64(0x00000000FFFFFFFF));
+    __m512d magic = _mm512_set1_pd(TWO_52);
+    return _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(v, _mm512_castpd_si512(magic))), magic);
+}
+
+GEO_AVX512 inline void sin2_cos8(__m512d x, __m512d& sin2, __m512d& cosAbs){
+    __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(TWO_BY_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(PIO2_LO), _mm512_fnmadd_pd(k, _mm512_set1_pd(PIO2_HI), x));
+    __m512d z = _mm512_mul_pd(r, r);
+    __m512d ps = _mm512_set1_pd(SIN_TERMS[SIN_COUNT - 1]);
+    for (int j = SIN_COUNT - 2; j >= 0; j--) ps = _mm512_fmadd_pd(ps, z, _mm512_set1_pd(SIN_TERMS[j]));
+    __m512d pc = _mm512_set1_pd(COS_TERMS[COS_COUNT - 1]);
+    for (int j = COS_COUNT - 2; j >= 0; j--) pc = _mm512_fmadd_pd(pc, z, _mm512_set1_pd(COS_TERMS[j]));
+    __m512d s = _mm512_fmadd_pd(_mm512_mul_pd(r, z), ps, r);
+    __m512d c = _mm512_fmadd_pd(z, pc, _mm512_set1_pd(1));
+    __m512i kBits = _mm512_castpd_si512(_mm512_add_pd(k, _mm512_set1_pd(ROUND_MAGIC)));
+    __mmask8 odd = _mm512_test_epi64_mask(kBits, _mm512_set1_epi64(1));
+    sin2 = _mm512_mask_blend_pd(odd, _mm512_mul_pd(s, s), _mm512_mul_pd(c, c));
+    cosAbs = _mm512_abs_pd(_mm512_mask_blend_pd(odd, c, s));
+}
+
+GEO_AVX512 size_t filter_avx512(const GeoFilter& f, const double* scores, size_t n, uint32_t* matched){
+    const __m512d magic = _mm512_set1_pd(TWO_52);
+    size_t found = 0;
+    for (size_t i = 0; i < n; i += 8) {
+        __mmask8 lanes = i + 8 <= n ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+        __m512d score = _mm512_maskz_loadu_pd(lanes, scores + i);
+        __m512i bits = _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(score, magic)), _mm512_castpd_si512(magic));
+        __m512d lat = _mm512_fmadd_pd(compact8(bits), _mm512_set1_pd(LAT_STEP), _mm512_set1_pd(LAT_BASE));
+        __m512d lon = _mm512_fmadd_pd(compact8(_mm512_srli_epi64(bits, 1)), _mm512_set1_pd(LON_STEP), _mm512_set1_pd(LON_BASE));
+        __m512d dLat = _mm512_sub_pd(lat, _mm512_set1_pd(f.lat));
+        __m512d dLon = _mm512_sub_pd(lon, _mm512_set1_pd(f.lon));
+        __m512d absDLon = _mm512_abs_pd(dLon);
+        absDLon = _mm512_min_pd(absDLon, _mm512_sub_pd(_mm512_set1_pd(360), absDLon));
+        lanes = _mm512_mask_cmp_pd_mask(lanes, _mm512_abs_pd(dLat), _mm512_set1_pd(f.maxDLat), _CMP_LE_OQ);
+        lanes = _mm512_mask_cmp_pd_mask(lanes, absDLon, _mm512_set1_pd(f.maxDLon), _CMP_LE_OQ);
+        if (!lanes) continue;
+
+        __m512d latSin2, lonSin2, cosLat, unused;
+        sin2_cos8(_mm512_mul_pd(dLat, _mm512_set1_pd(DEG_HALF_RAD)), latSin2, unused);
+        sin2_cos8(_mm512_mul_pd(dLon, _mm512_set1_pd(DEG_HALF_RAD)), lonSin2, unused);
+        sin2_cos8(_mm512_mul_pd(lat, _mm512_set1_pd(DEG_RAD)), unused, cosLat);
+        __m512d h = _mm512_fmadd_pd(_mm512_mul_pd(_mm512_set1_pd(f.cosLat), cosLat), lonSin2, latSin2);
+        lanes = f.box ? _mm512_mask_cmp_pd_mask(lanes, _mm512_mul_pd(_mm512_mul_pd(cosLat, cosLat), lonSin2), _mm512_set1_pd(f.maxLonHav), _CMP_LE_OQ)
+                      : _mm512_mask_cmp_pd_mask(lanes, h, _mm512_set1_pd(f.maxHav), _CMP_LE_OQ);
+        for (unsigned left = lanes; left; left &= left - 1) matched[found++] = static_cast<uint32_t>(i + __builtin_ctz(left));
+    }
+    return found;
+}
+
+using Kernel = size_t (*)(const GeoFilter&, const double*, size_t, uint32_t*);
+
+struct KernelInfo {
+    const char* name;
+    Kernel run;
+};
+
+constexpr KernelInfo KERNELS[] = {{"avx512", filter_avx512}, {"avx2", filter_avx2}, {"scalar", filter_scalar}};
+
+bool supported(const KernelInfo& kernel){
+    __builtin_cpu_init(); // may run before other static constructors
+    if (kernel.run == filter_avx512) return __builtin_cpu_supports("avx512f");
+    if (kernel.run == filter_avx2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return true;
+}
+
+const KernelInfo* best_kernel(){
+    for (const KernelInfo& kernel : KERNELS) {
+        if (supported(kernel)) return &kernel;
+    }
+    return nullptr;
+}
+
+std::atomic<const KernelInfo*> active{best_kernel()};
+
+} // namespace
+
+GeoFilter geo_prepare(const GeoShape& shape){
+    // Bounding boxes get this much room for rounding, they must never drop a point
+    // the exact test keeps
+    constexpr double SLACK = 1e-9;
+    GeoFilter f{};
+    f.lon = shape.lon;
+    f.lat = shape.lat;
+    f.cosLat = std::cos(shape.lat * DEG_RAD);
+    f.box = shape.box;
+    if (!shape.box) {
+        double angle = shape.radius / EARTH_RADIUS;
+        double half = std::min(angle / 2, PI / 2);
+        f.maxHav = std::sin(half) * std::sin(half);
+        // An arc is at least as long as its change in latitude
+        f.maxDLat = angle / DEG_RAD + SLACK;
+        // A circle that doesn't reach a pole spans asin(sin δ / cos φ0) either way
+        if (std::fabs(shape.lat) + angle / DEG_RAD >= 90) f.maxDLon = 180;
+        else f.maxDLon = std::asin(std::min(1.0, std::sin(angle) / f.cosLat)) / DEG_RAD + SLACK;
+    } else {
+        f.maxDLat = shape.height / 2 / EARTH_RADIUS / DEG_RAD;
+        double half = std::min(shape.width / 4 / EARTH_RADIUS, PI / 2);
+        f.maxLonHav = std::sin(half) * std::sin(half);
+        // cos φ is smallest on the box's edge farther from the equator
+        double edge = std::fabs(shape.lat) + f.maxDLat;
+        double cosEdge = edge >= 90 ? 0 : std::cos(edge * DEG_RAD);
+        if (cosEdge <= std::sin(half)) f.maxDLon = 180;
+        else f.maxDLon = 2 * std::asin(std::sin(half) / cosEdge) / DEG_RAD + SLACK;
+    }
+    return f;
+}
+
+size_t geo_filter(const GeoFilter& filter, const double* scores, size_t n, uint32_t* matched){
+    return active.load(std::memory_order_relaxed)->run(filter, scores, n, matched);
+}
+
+double geo_distance(double lon1, double lat1, double lon2, double lat2){
+    double v = std::sin((lon2 * DEG_RAD - lon1 * DEG_RAD) / 2);
+    // Same longitude: the arc is the change in latitude, no trigonometry needed
+    if (v == 0) return EARTH_RADIUS * std::fabs(lat2 * DEG_RAD - lat1 * DEG_RAD);
+    double u = std::sin((lat2 * DEG_RAD - lat1 * DEG_RAD) / 2);
+    double a = u * u + std::cos(lat1 * DEG_RAD) * std::cos(lat2 * DEG_RAD) * v * v;
+    return 2 * EARTH_RADIUS * std::asin(std::sqrt(a));
+}
+
+const char* geo_kernel_name(){
+    return active.load(std::memory_order_relaxed)->name;
+}
+
+bool geo_use_kernel(const char* name){
+    for (const KernelInfo& kernel : KERNELS) {
+        if (std::strcmp(kernel.name, name) == 0 && supported(kernel)) {
+            active.store(&kernel, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
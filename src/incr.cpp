@@ -1,38 +1,103 @@
 #include "incr.h"
-#include "clear.h"
-#include "bulkString.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
-
-std::string incr_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict){
-    if (items == 1){
-        std::string item = parsebulkString(items,client_fd, read_buffer);
-        //tries to find key in  dictionary
-        auto tuple = dict.find(item);
-        // val not found
-        if (tuple == dict.end()){
-            std::chrono::system_clock::time_point ttl;
-            dict[item] = make_tuple("1",ttl);
-            std::string response = ":1\r\n";
-            return response;
-        }
-        //val is found
-        auto [val, ttl] = tuple->second;
-        try{
-            long long itemINT = std::stoi(val);
-            dict[item] = make_tuple(std::to_string(itemINT+1), ttl);
-            std::string response = ":"+ std::to_string(itemINT+1) +"\r\n";
-            return response;
-        } catch(...){
-            std::string response = "-ERR value is not an integer or out of range\r\n";
-            return response;
-        }
-        
+#include "replication.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static std::string integer_reply(int64_t value){
+    char buf[24];
+    std::string response = ":";
+    response += format_int64(value, buf);
+    response += "\r\n";
+    return response;
+}
+
+static std::string incrby(Keyspace& db, std::string_view key, int64_t delta){
+    RedisObject* obj = db.find(key);
+    if (!obj){
+        db.set_int(key, delta);
+        return integer_reply(delta);
+    }
+    if (obj->type != ObjType::String) return WRONGTYPE;
+    int64_t value;
+    if (obj->is_int()) value = obj->as<int64_t>();
+    else if (!parse_int64(obj->as<std::string>(), value)){
+        return "-ERR value is not an integer or out of range\r\n";
     }
-    else{
-        std::string response = "-ERR wrong number of arguments for incr command\r\n";
-        return response;
+    if (__builtin_add_overflow(value, delta, &value)){
+        return "-ERR increment or decrement would overflow\r\n";
+    }
+    obj->assign_int(value); // in place, keeps the key's ttl
+    db.mark_dirty();
+    return integer_reply(value);
+}
+
+static bool parse_delta(std::string_view arg, int64_t& delta){
+    auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), delta);
+    return ec == std::errc() && end == arg.data() + arg.size();
+}
+
+std::string incr_command(const Argv& argv, Keyspace& db){
+    if (argv.size() != 2) return "-ERR wrong number of arguments for incr command\r\n";
+    return incrby(db, argv[1], 1);
+}
+
+std::string decr_command(const Argv& argv, Keyspace& db){
+    if (argv.size() != 2) return "-ERR wrong number of arguments for decr command\r\n";
+    return incrby(db, argv[1], -1);
+}
+
+std::string incrby_command(const Argv& argv, Keyspace& db){
+    if (argv.size() != 3) return "-ERR wrong number of arguments for incrby command\r\n";
+    int64_t delta;
+    if (!parse_delta(argv[2], delta)) return "-ERR value is not an integer or out of range\r\n";
+    return incrby(db, argv[1], delta);
+}
+
+std::string decrby_command(const Argv& argv, Keyspace& db){
+    if (argv.size() != 3) return "-ERR wrong number of arguments for decrby command\r\n";
+    int64_t delta;
+    if (!parse_delta(argv[2], delta) || delta == INT64_MIN) return "-ERR value is not an integer or out of range\r\n";
+    return incrby(db, argv[1], -delta);
+}
+
+// Whole string must be a finite number, like Redis' string2ld
+static bool parse_long_double(std::string_view arg, long double& value){
+    if (arg.empty() || arg.size() > 5000 || std::isspace(static_cast<unsigned char>(arg[0]))) return false;
+    std::string s(arg);
+    char* end;
+    value = std::strtold(s.c_str(), &end);
+    return end == s.c_str() + s.size() && !std::isnan(value) && !std::isinf(value);
+}
+
+std::string incrbyfloat_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() != 3) return "-ERR wrong number of arguments for incrbyfloat command\r\n";
+    long double delta;
+    if (!parse_long_double(argv[2], delta)) return "-ERR value is not a valid float\r\n";
+    RedisObject* obj = db.find(argv[1]);
+    if (obj && obj->type != ObjType::String) return WRONGTYPE;
+    long double value = 0;
+    if (obj && obj->is_int()) value = obj->as<int64_t>();
+    else if (obj && !parse_long_double(obj->as<std::string>(), value)) return "-ERR value is not a valid float\r\n";
+    value += delta;
+    if (std::isnan(value) || std::isinf(value)) return "-ERR increment would produce NaN or Infinity\r\n";
+
+    // Redis' human friendly form: 17 decimals, trailing zeros dropped
+    char buf[5200];
+    int len = std::snprintf(buf, sizeof(buf), "%.17Lf", value);
+    while (len > 1 && buf[len - 1] == '0') len--;
+    if (buf[len - 1] == '.') len--;
+    std::string result(buf, len);
+    if (result == "-0") result = "0";
+
+    if (obj) {
+        obj->assign_string(result); // in place, keeps the key's ttl
+        db.mark_dirty();
     }
-}
\ No newline at end of file
+    else db.set_string(argv[1], result);
+    rewrite_command(client, {"SET", std::string(argv[1]), result, "KEEPTTL"});
+    return "$" + std::to_string(result.size()) + "\r\n" + result + "\r\n";
+}
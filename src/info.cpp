@@ -1,32 +1,140 @@
 #include "info.h"
-#include "bulkString.h"
-#include "clear.h"
-#include <sys/types.h>    
-#include <sys/socket.h>
-#include <unistd.h> 
-
-std::string info_command(int& items, int client_fd, std::string& read_buffer, Config config){
-    if (items == 0){
-
-    }
-    if (items == 1){
-        if (read_buffer[0] != '$'){
-            std::string response = "-ERR argument must be bulk string for info command\r\n";
-            return response;
-        }
-        std::string bulkString = parsebulkString(items, client_fd, read_buffer);
-        if (bulkString != "replication"){
-            std::string response = "-ERR invalid argument for info command\r\n";
-            return response;
-        }
-        std::string roles = "role:" + config.replica + "\n";
-        roles += "master_replid:8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb\n";
-        roles += "master_repl_offset:0\n";
-        std::string response = "$" + std::to_string(roles.length()) + "\r\n" + roles + "\r\n";
+#include "lowerCMD.h"
+#include "memoryUsage.h"
+#include "slab.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+static std::string replication_section(const Config& config){
+    std::string roles = "role:" + config.replica + "\n";
+    roles += "master_replid:8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb\n";
+    roles += "master_repl_offset:0\n";
+    return roles;
+}
+
+static std::string human_bytes(size_t bytes){
+    const char* units[] = {"B", "K", "M", "G", "T"};
+    double value = bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 4){
+        value /= 1024;
+        unit++;
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.2f%s", value, units[unit]);
+    return buf;
+}
+
+static std::string memory_section(const EvictionConfig& eviction){
+    size_t used = used_memory();
+    std::string section = "used_memory:" + std::to_string(used) + "\n";
+    section += "used_memory_human:" + human_bytes(used) + "\n";
+    section += "maxmemory:" + std::to_string(eviction.maxmemory) + "\n";
+    section += "maxmemory_human:" + human_bytes(eviction.maxmemory) + "\n";
+    section += "maxmemory_policy:" + std::string(policy_name(eviction.policy)) + "\n";
+    return section;
+}
+
+static std::string stats_section(Keyspace& db){
+    ExpireStats& stats = db.expire_stats();
+    std::string section = "expired_keys:" + std::to_string(stats.expiredKeys.load()) + "\n";
+    section += "expire_cycles:" + std::to_string(stats.cycles.load()) + "\n";
+    section += "expired_time_cap_reached_count:" + std::to_string(stats.timeCapReached.load()) + "\n";
+    section += "expire_cycle_cpu_milliseconds:" + std::to_string(stats.cycleMicros.load() / 1000) + "\n";
+    section += "evicted_keys:" + std::to_string(eviction_stats().evictedKeys.load()) + "\n";
+    section += "rejected_oom_commands:" + std::to_string(eviction_stats().rejectedCommands.load()) + "\n";
+    return section;
+}
+
+// Needs every stripe locked, INFO is an all keys command for this
+static std::string keyspace_section(Keyspace& db){
+    size_t keys = 0, expires = 0;
+    db.for_each([&](const std::string&, RedisObject& obj){
+        keys++;
+        if (obj.expiry != std::chrono::system_clock::time_point{}) expires++;
+    });
+    if (!keys) return "";
+    return "db0:keys=" + std::to_string(keys) + ",expires=" + std::to_string(expires) + "\n";
+}
+
+std::string info_command(const Argv& argv, const Config& config, const EvictionConfig& eviction, Keyspace& db){
+    if (argv.size() > 2){
+        std::string response = "-ERR wrong number of arguments for info command\r\n";
         return response;
     }
+    std::string section = argv.size() == 2 ? lowercase_command(argv[1]) : "default";
+    std::string body;
+    if (section == "replication"){
+        body = replication_section(config);
+    }
+    else if (section == "memory"){
+        body = memory_section(eviction);
+    }
+    else if (section == "stats"){
+        body = stats_section(db);
+    }
+    else if (section == "keyspace"){
+        body = keyspace_section(db);
+    }
+    else if (section == "default" || section == "all" || section == "everything"){
+        body = "# Replication\n" + replication_section(config) + "\n";
+        body += "# Memory\n" + memory_section(eviction) + "\n";
+        body += "# Stats\n" + stats_section(db) + "\n";
+        body += "# Keyspace\n" + keyspace_section(db);
+    }
     else{
-        std::string response = "-ERR wrong number of arguments for info command\r\n";
+        std::string response = "-ERR invalid argument for info command\r\n";
         return response;
     }
-}
\ No newline at end of file
+    std::string response = "$" + std::to_string(body.length()) + "\r\n" + body + "\r\n";
+    return response;
+}
+
+static size_t resident_bytes(){
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static std::string ratio(size_t a, size_t b){
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.2f", b ? double(a) / b : 0.0);
+    return buf;
+}
+
+static void add_field(std::string& out, const std::string& name, const std::string& value){
+    out += "$" + std::to_string(name.size()) + "\r\n" + name + "\r\n";
+    out += value;
+}
+
+static std::string integer(size_t n){ return ":" + std::to_string(n) + "\r\n"; }
+static std::string bulk(const std::string& s){ return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n"; }
+
+std::string memory_command(const Argv& argv){
+    if (argv.size() != 2 || lowercase_command(argv[1]) != "stats"){
+        std::string response = "-ERR unknown subcommand, try MEMORY STATS\r\n";
+        return response;
+    }
+    size_t used = used_memory();
+    size_t rss = resident_bytes();
+    SlabStats slabs = slab_stats();
+    std::string fields;
+    size_t count = 0;
+    add_field(fields, "used_memory", integer(used)); count++;
+    add_field(fields, "rss", integer(rss)); count++;
+    add_field(fields, "fragmentation.ratio", bulk(ratio(rss, used))); count++;
+    add_field(fields, "slab.reserved", integer(slabs.reserved)); count++;
+    add_field(fields, "slab.used", integer(slabs.used)); count++;
+    add_field(fields, "slab.fragmentation.ratio", bulk(ratio(slabs.reserved, slabs.used))); count++;
+    for (const SlabClassStats& cls : slabs.classes){
+        if (!cls.slabs) continue;
+        std::string value = "*4\r\n" + bulk("slabs") + integer(cls.slabs) + bulk("used") + integer(cls.used);
+        add_field(fields, "slab.class." + std::to_string(cls.size), value);
+        count++;
+    }
+    return "*" + std::to_string(count * 2) + "\r\n" + fields;
+}
@@ -1,21 +1,17 @@
 #include "keys.h"
-#include "clear.h"
-#include "bulkString.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
-std::string key_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict){
-    if (items == 1){
-        std::string pattern = parsebulkString(items, client_fd, read_buffer);
-        if (pattern == "*"){
-            std::string response = "*" + std::to_string(dict.size()) + "\r\n";
-            for (const auto& pair : dict) {
-                std::string key = pair.first;
+std::string key_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 2){
+        if (argv[1] == "*"){
+            std::string body = "";
+            size_t count = 0;
+            db.for_each([&](const std::string& key, RedisObject&) { // every type, expired keys skipped
                 int keyLen = key.length();
-                response += "$" + std::to_string(keyLen) + "\r\n";
-                response += key + "\r\n";
-            }
+                body += "$" + std::to_string(keyLen) + "\r\n";
+                body += key + "\r\n";
+                count++;
+            });
+            std::string response = "*" + std::to_string(count) + "\r\n" + body;
             return response;
         }
         else {
@@ -27,6 +23,4 @@ std::string key_command(int& items, int client_fd, std::string& read_buffer, std
         std::string response = "-ERR wrong number of arguments for keys command\r\n";
         return response;
     }
-    std::string response = "-ERR error\r\n";
-    return response;
-}
\ No newline at end of file
+}
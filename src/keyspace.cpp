@@ -0,0 +1,183 @@
+#include "keyspace.h"
+#include "shard.h"
+
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <random>
+#include <atomic>
+
+uint64_t access_clock(){
+  using namespace std::chrono;
+  uint64_t ms = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+  return (ms % 1000) << 32 | ((ms / 1000) & ACCESS_CLOCK_MASK);
+}
+
+// Stamps the access time and maybe bumps Redis' logarithmic LFU counter: the higher it
+// is the less likely an access bumps it. Readers do this under a shared stripe lock,
+// hence the relaxed load and store of the whole word (a lost update is fine)
+static void touch(RedisObject& obj){
+  std::atomic_ref<uint64_t> access(obj.access);
+  uint64_t clock = access_clock();
+  uint32_t counter = access_frequency(access.load(std::memory_order_relaxed), clock);
+  if (counter < 255){
+    static thread_local std::minstd_rand rng{std::random_device{}()};
+    double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+    double p = 1.0 / (base * 10 + 1); // lfu-log-factor 10
+    if (std::uniform_real_distribution<double>(0, 1)(rng) < p) counter++;
+  }
+  access.store(uint64_t(counter) << 24 | clock, std::memory_order_relaxed);
+}
+
+thread_local uint64_t Keyspace::dirtyCount = 0;
+thread_local uint64_t KeyLock::heldRead = 0;
+thread_local uint64_t KeyLock::heldWrite = 0;
+
+void KeyLock::lock(){
+  if (locked || heldRead || heldWrite) return; // already inside another KeyLock on this thread
+  uint64_t all = readMask | writeMask;
+  if (db.shardEngine){
+    // Owner threads need no lock, anyone else borrows the stripes from their shards
+    parked = all && db.shardEngine->acquire(all);
+  }
+  else {
+    for (size_t i = 0; i < Keyspace::STRIPES; i++){
+      if (!(all >> i & 1)) continue;
+      if (writeMask >> i & 1) db.stripes[i].lock.lock();
+      else db.stripes[i].lock.lock_shared();
+    }
+  }
+  heldWrite = writeMask;
+  heldRead = readMask & ~writeMask;
+  locked = true;
+}
+
+void KeyLock::unlock(){
+  if (!locked) return;
+  if (db.shardEngine){
+    if (parked) db.shardEngine->release();
+    parked = false;
+  }
+  else {
+    for (size_t i = Keyspace::STRIPES; i-- > 0;){
+      if (heldWrite >> i & 1) db.stripes[i].lock.unlock();
+      else if (heldRead >> i & 1) db.stripes[i].lock.unlock_shared();
+    }
+  }
+  heldRead = heldWrite = 0;
+  locked = false;
+}
+
+const char* type_name(ObjType type){
+  switch (type){
+    case ObjType::String: return "string";
+    case ObjType::List: return "list";
+    case ObjType::ZSet: return "zset";
+    case ObjType::Stream: return "stream";
+  }
+  return "none";
+}
+
+const char* encoding_name(const RedisObject& obj){
+  if (obj.type == ObjType::ZSet) return std::get<ZSet>(obj.value).encoding_name();
+  switch (obj.encoding){
+    case Encoding::Raw: return "raw";
+    case Encoding::Int: return "int";
+    case Encoding::QuickList: return "quicklist";
+    case Encoding::Listpack: return "listpack";
+    case Encoding::SkipList: return "skiplist";
+    case Encoding::Map: return "stream";
+  }
+  return "unknown";
+}
+
+RedisObject* Keyspace::find(std::string_view key){
+  size_t stripe = stripe_of(key);
+  RedisObject* found = stripes[stripe].entries.find(key);
+  if (!found) return nullptr;
+  RedisObject& obj = *found;
+  if (obj.expired(std::chrono::system_clock::now())){
+    if (KeyLock::write_held(stripe) && stripes[stripe].entries.erase(key)){
+      stats.expiredKeys.fetch_add(1, std::memory_order_relaxed);
+    }
+    return nullptr;
+  }
+  touch(obj);
+  return &obj;
+}
+
+bool parse_int64(std::string_view s, int64_t& value){
+  if (s.empty() || s.size() > 20) return false;
+  if (s.size() > 1 && (s[0] == '0' || (s[0] == '-' && s[1] == '0'))) return false;
+  if (s[0] == '-' && s.size() == 1) return false;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  return ec == std::errc() && end == s.data() + s.size();
+}
+
+std::string_view format_int64(int64_t value, char* buf){
+  char* end = std::to_chars(buf, buf + 21, value).ptr;
+  return std::string_view(buf, end - buf);
+}
+
+RedisObject& Keyspace::set_string(std::string_view key, std::string value, std::chrono::system_clock::time_point ttl){
+  int64_t n;
+  RedisObject& obj = parse_int64(value, n) ? insert(key, n) : insert(key, std::move(value));
+  set_expiry(key, obj, ttl);
+  return obj;
+}
+
+RedisObject& Keyspace::set_int(std::string_view key, int64_t value){
+  return insert(key, value);
+}
+
+void Keyspace::set_expiry(std::string_view key, RedisObject& obj, std::chrono::system_clock::time_point when){
+  obj.expiry = when;
+  dirtyCount++;
+  if (when != Clock::time_point{}) index_expiry(stripes[stripe_of(key)], key, when);
+}
+
+void Keyspace::index_expiry(Stripe& stripe, std::string_view key, Clock::time_point when){
+  auto& heap = stripe.expires;
+  if (heap.size() >= 2 * stripe.entries.size() + 64){
+    // Mostly stale entries (keys rewritten or persisted before their deadline):
+    // rebuild from the keys' actual expiries, which already include this one
+    heap.clear();
+    stripe.entries.for_each([&](const std::string& k, RedisObject& obj){
+      if (obj.expiry != Clock::time_point{}) heap.push_back({obj.expiry, k});
+    });
+    std::make_heap(heap.begin(), heap.end(), std::greater<>{});
+  }
+  else {
+    heap.push_back({when, std::string(key)});
+    std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+  }
+  update_next_due(stripe);
+}
+
+void Keyspace::update_next_due(Stripe& stripe){
+  Clock::time_point next = stripe.expires.empty() ? Clock::time_point::max() : stripe.expires.front().when;
+  stripe.nextDue.store(next.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+bool Keyspace::expire_due(size_t s, std::chrono::system_clock::time_point now, size_t limit){
+  Stripe& stripe = stripes[s];
+  auto& heap = stripe.expires;
+  for (size_t n = 0; n < limit && !heap.empty() && heap.front().when <= now; n++){
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+    Deadline due = std::move(heap.back());
+    heap.pop_back();
+    // Skip entries whose key was deleted, rewritten or given another expiry since
+    RedisObject* obj = stripe.entries.find(due.key);
+    if (!obj || obj->expiry != due.when) continue;
+    stripe.entries.erase(due.key);
+    stats.expiredKeys.fetch_add(1, std::memory_order_relaxed);
+  }
+  update_next_due(stripe);
+  return !heap.empty() && heap.front().when <= now;
+}
+
+bool Keyspace::erase(std::string_view key){
+  if (!stripes[stripe_of(key)].entries.erase(key)) return false;
+  dirtyCount++;
+  return true;
+}
@@ -1,183 +1,369 @@
 #include "list.h"
-#include <chrono>
-#include <thread>
-#include "bulkString.h"
-#include <iostream>
-
-std::string rpush_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict){
-    if (items >= 2){
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        std::cout << key << std::endl;
-        auto tuple = lDict.find(key);
-        int itemsCopy = items;
-        for (int i = 0; i < itemsCopy; i++){
-            std::string element = parsebulkString(items, client_fd, read_buffer);
-            std::cout << element << std::endl;
-            lDict[key].push_back(element);
-        }
-        size_t vecSize = lDict[key].size();
-        std::string response = ":"+std::to_string(vecSize)+"\r\n";
+#include "lowerCMD.h"
+#include "blocking.h"
+#include "replication.h"
+
+static const std::string NOT_INTEGER = "-ERR value is not an integer or out of range\r\n";
+
+static std::string bulk(std::string_view element){
+    std::string response = "$" + std::to_string(element.size()) + "\r\n";
+    response.append(element);
+    response += "\r\n";
+    return response;
+}
+
+// Turns a Redis start/stop pair (negative counts from the end) into indexes inside the
+// list, false if the range is empty
+static bool clamp_range(int64_t& start, int64_t& stop, int64_t len){
+    if (start < 0) start = len + start;
+    if (stop < 0) stop = len + stop;
+    if (start < 0) start = 0;
+    if (start > stop || start >= len) return false;
+    if (stop >= len) stop = len - 1;
+    return true;
+}
+
+static std::string push(ClientState& client, const Argv& argv, Keyspace& db, bool left){
+    bool wrongType;
+    List* found = db.lookup_or_create<List>(argv[1], wrongType);
+    if (wrongType) return WRONGTYPE;
+    List& list = *found;
+    for (size_t i = 2; i < argv.size(); i++){
+        if (left) list.push_front(argv[i]);
+        else list.push_back(argv[i]);
+    }
+    db.mark_dirty();
+    std::string response = ":" + std::to_string(list.size()) + "\r\n"; // counting what parked clients take next, like Redis
+    serve_parked(client, db, argv[1]);
+    return response;
+}
+
+// LMOVE and a BLMOVE that found an element, the source exists. Checks the destination
+// before anything moves. BLMOVE isn't propagated as is, so it goes out as the LMOVE it was
+static std::string move_element(ClientState& client, Keyspace& db, const Argv& argv, List* source,
+                                bool popLeft, bool pushLeft, bool propagate){
+    std::string_view from = argv[1], to = argv[2];
+    bool wrongType;
+    db.lookup<List>(to, wrongType);
+    if (wrongType) return WRONGTYPE;
+    if (propagate) also_propagate(client, Argv{"LMOVE", from, to, argv[3], argv[4]});
+
+    std::string element = popLeft ? source->pop_front() : source->pop_back();
+    db.mark_dirty();
+    if (source->empty()) db.erase(from);
+    // Looked up again: creating the destination may move the source's entry
+    List* destination = db.lookup_or_create<List>(to, wrongType);
+    if (pushLeft) destination->push_front(element);
+    else destination->push_back(element);
+    serve_parked(client, db, to);
+    return bulk(element);
+}
+
+static bool parse_where(std::string_view arg, bool& left){
+    std::string where = lowercase_command(arg);
+    left = where == "left";
+    return left || where == "right";
+}
+
+// BLPOP / BRPOP key [key ...] timeout: the first non-empty key in order, or park on all of them
+static std::string blocking_pop(ClientState& client, const Argv& argv, Keyspace& db, bool left){
+    std::chrono::steady_clock::time_point deadline;
+    std::string error = parse_block_timeout(argv.back(), deadline);
+    if (!error.empty()) return error;
+    for (size_t i = 1; i + 1 < argv.size(); i++){
+        bool wrongType;
+        List* list = db.lookup<List>(argv[i], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (!list) continue; // empty lists don't exist
+        std::string element = left ? list->pop_front() : list->pop_back();
+        if (list->empty()) db.erase(argv[i]);
+        also_propagate(client, Argv{left ? "LPOP" : "RPOP", argv[i]});
+        return "*2\r\n" + bulk(argv[i]) + bulk(element);
+    }
+    if (client.execing) return "*-1\r\n"; // inside EXEC it answers right away, like Redis
+    auto pop = std::make_shared<ParkedPop>();
+    pop->argv.assign(argv.begin(), argv.end());
+    pop->keys.assign(argv.begin() + 1, argv.end() - 1);
+    pop->popLeft = left;
+    pop->deadline = deadline;
+    park(client, db, std::move(pop));
+    return "";
+}
+
+static std::string pop(const Argv& argv, Keyspace& db, bool left){
+    int64_t num = 1;
+    if (argv.size() == 3 && (!parse_int64(argv[2], num) || num < 0)){
+        return "-ERR value is out of range, must be positive\r\n";
+    }
+    bool wrongType;
+    List* found = db.lookup<List>(argv[1], wrongType);
+    if (wrongType) return WRONGTYPE;
+    if (!found) return argv.size() == 2 ? "$-1\r\n" : "*-1\r\n"; // empty lists don't exist
+    List& list = *found;
+    db.mark_dirty();
+    if (argv.size() == 2){
+        std::string response = bulk(left ? list.pop_front() : list.pop_back());
+        if (list.empty()) db.erase(argv[1]);
         return response;
     }
+    if (size_t(num) > list.size()) num = list.size();
+    std::string response = "*" + std::to_string(num) + "\r\n";
+    for (int64_t i = 0; i < num; i++){
+        response += bulk(left ? list.pop_front() : list.pop_back());
+    }
+    if (list.empty()) db.erase(argv[1]);
+    return response;
+}
+
+std::string rpush_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() >= 3){
+        return push(client, argv, db, false);
+    }
     else{
         std::string response = "-ERR wrong number of arguments for rpush command\r\n";
         return response;
     }
 }
 
-std::string lrange_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict){
-    if (items == 3){
-        int len = 0; 
-        std::string response = "";
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        int startIndex = std::stoi(parsebulkString(items, client_fd, read_buffer));
-        int endIndex = std::stoi(parsebulkString(items, client_fd, read_buffer));
-        auto tuple = lDict.find(key);
+std::string lrange_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 4){
+        int64_t startIndex, endIndex;
+        if (!parse_int64(argv[2], startIndex) || !parse_int64(argv[3], endIndex)) return NOT_INTEGER;
+        bool wrongType;
+        List* found = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
 
-        // List doesnt exist
-        if (tuple == lDict.end()){ 
-            response = "*0\r\n";
+        // List doesnt exist, or the range is empty
+        if (!found || !clamp_range(startIndex, endIndex, found->size())){
+            std::string response = "*0\r\n";
             return response;
         }
 
-        len = lDict[key].size();
-
-        //convert negative indexes;
-        if (startIndex < 0){
-            startIndex = len + startIndex;
-            startIndex = (startIndex > 0) ? startIndex : 0;
-        }
-        if (endIndex < 0){
-            endIndex = len + endIndex;
-            endIndex = (endIndex > 0) ? endIndex : 0;
-        }
-        // Start greater than end /  start greater than size
-        if ((startIndex > endIndex) || (startIndex >= len)){ 
-            response = "*0\r\n";
-            return response;
-        }
+        size_t count = endIndex - startIndex + 1;
+        std::string response = "*" + std::to_string(count) + "\r\n";
+        found->for_range(startIndex, count, [&](std::string_view element){ response += bulk(element); });
+        return response;
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for lrange command\r\n";
+        return response;
+    }
+}
 
-        // default end to last index if too big
-        endIndex = (endIndex < len-1) ? endIndex : len-1;
+std::string lpush_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() >= 3){
+        return push(client, argv, db, true);
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for lpush command\r\n";
+        return response;
+    }
+}
 
-        response = "*" + std::to_string(endIndex-startIndex+1) + "\r\n";
+std::string llen_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 2){
+        size_t len = 0;
+        bool wrongType;
+        List* found = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (found) len = found->size(); // If doesnt exist return 0
+        std::string response = ":" + std::to_string(len) + "\r\n";
+        return response;
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for llen command\r\n";
+        return response;
+    }
+}
 
-        for (int i = startIndex; i <= endIndex; i++){
-            std::string element = lDict[key][i];
-            response += "$"+ std::to_string(element.size()) + "\r\n";
-            response += element + "\r\n";
-        }
+std::string lpop_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 2 || argv.size() == 3){
+        return pop(argv, db, true);
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for lpop command\r\n";
         return response;
     }
+}
+
+std::string rpop_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 2 || argv.size() == 3){
+        return pop(argv, db, false);
+    }
     else{
-        std::string response = "-ERR wrong number of arguments for lrange command\r\n";
+        std::string response = "-ERR wrong number of arguments for rpop command\r\n";
         return response;
     }
 }
 
-std::string lpush_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict){
-    if (items >= 2){
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        auto tuple = lDict.find(key);
-        int itemsCopy = items;
-        for (int i = 0; i < itemsCopy; i++){
-            std::string element = parsebulkString(items, client_fd, read_buffer);
-            std::cout << element << std::endl;
-            lDict[key].insert(lDict[key].begin(),element);
+std::string lindex_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 3){
+        int64_t index;
+        if (!parse_int64(argv[2], index)) return NOT_INTEGER;
+        bool wrongType;
+        List* found = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (found && index < 0) index += found->size();
+        if (!found || index < 0 || size_t(index) >= found->size()){
+            std::string response = "$-1\r\n";
+            return response;
         }
-        size_t vecSize = lDict[key].size();
-        std::string response = ":"+std::to_string(vecSize)+"\r\n";
-        return response;
+        return bulk(found->at(index));
     }
     else{
-        std::string response = "-ERR wrong number of arguments for lpush command\r\n";
+        std::string response = "-ERR wrong number of arguments for lindex command\r\n";
         return response;
     }
 }
 
-std::string llen_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict){
-    if (items == 1){
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        int len = 0; 
-        std::string response = "";
-        auto tuple = lDict.find(key);
-        if (tuple == lDict.end()){  // If doesnt exist return 0
-            response = ":" + std::to_string(len) + "\r\n";
+std::string lset_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 4){
+        int64_t index;
+        if (!parse_int64(argv[2], index)) return NOT_INTEGER;
+        bool wrongType;
+        List* found = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (!found){
+            std::string response = "-ERR no such key\r\n";
+            return response;
+        }
+        if (index < 0) index += found->size();
+        if (index < 0 || size_t(index) >= found->size()){
+            std::string response = "-ERR index out of range\r\n";
             return response;
         }
-        len = lDict[key].size();
-        response = ":" + std::to_string(len) + "\r\n";
+        found->set(index, argv[3]);
+        db.mark_dirty();
+        std::string response = "+OK\r\n";
         return response;
     }
     else{
-        std::string response = "-ERR wrong number of arguments for llen command\r\n";
+        std::string response = "-ERR wrong number of arguments for lset command\r\n";
         return response;
     }
 }
 
-std::string lpop_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict){
-    if (items == 1 || items == 2){
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        int len = 0; 
-        std::string response = "";
-        auto tuple = lDict.find(key);
-        if (tuple == lDict.end() || lDict[key].size()==0){  // If doesnt exist or empty 
-            response = "$-1\r\n";
+std::string linsert_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() == 5){
+        std::string where = lowercase_command(argv[2]);
+        if (where != "before" && where != "after"){
+            std::string response = "-ERR syntax error\r\n";
             return response;
         }
-        if(items == 0){
-            std::string erased = lDict[key].front();
-            lDict[key].erase(lDict[key].begin());
-            response += "$"+ std::to_string(erased.size()) + "\r\n";
-            response += erased + "\r\n";
+        bool wrongType;
+        List* found = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (!found){
+            std::string response = ":0\r\n";
             return response;
         }
-        int num = std::stoi(parsebulkString(items, client_fd, read_buffer));
-        if (num > lDict[key].size() ) num = lDict[key].size();
-        response += "*" + std::to_string(num) + "\r\n";
-        for (int i = 0; i<num;i++) {
-            std::string erased = lDict[key].front();
-            lDict[key].erase(lDict[key].begin());
-            response += "$"+ std::to_string(erased.size()) + "\r\n";
-            response += erased + "\r\n";
+        if (!found->insert(argv[3], argv[4], where == "after")){
+            std::string response = ":-1\r\n";
+            return response;
         }
+        db.mark_dirty();
+        std::string response = ":" + std::to_string(found->size()) + "\r\n";
+        serve_parked(client, db, argv[1]);
         return response;
     }
     else{
-        std::string response = "-ERR wrong number of arguments for lpop command\r\n";
+        std::string response = "-ERR wrong number of arguments for linsert command\r\n";
         return response;
     }
 }
 
-std::string blpop_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::vector<std::string>>&lDict){
-    if (items == 2){
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        float waitTime = std::stof(parsebulkString(items, client_fd, read_buffer));
-        std::string response = "";
-        bool infiniteTime = false;
+std::string ltrim_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 4){
+        int64_t start, stop;
+        if (!parse_int64(argv[2], start) || !parse_int64(argv[3], stop)) return NOT_INTEGER;
+        bool wrongType;
+        List* found = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (found){
+            size_t len = found->size();
+            if (!clamp_range(start, stop, len)) db.erase(argv[1]);
+            else if (start > 0 || size_t(stop) + 1 < len) {
+                found->erase_back(len - 1 - stop);
+                found->erase_front(start);
+                db.mark_dirty();
+            }
+        }
+        std::string response = "+OK\r\n";
+        return response;
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for ltrim command\r\n";
+        return response;
+    }
+}
 
-        if(waitTime == 0){
-            infiniteTime = true;
+std::string lmove_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() == 5){
+        bool popLeft, pushLeft;
+        if (!parse_where(argv[3], popLeft) || !parse_where(argv[4], pushLeft)){
+            std::string response = "-ERR syntax error\r\n";
+            return response;
         }
-        auto end = std::chrono::steady_clock::now() + std::chrono::duration<float>(waitTime); 
-        do{
-            if(lDict[key].size() != 0){
-                std::string erased = lDict[key].front();
-                lDict[key].erase(lDict[key].begin());
-                response += "*2\r\n";
-                response += "$"+ std::to_string(key.size()) + "\r\n";
-                response += key + "\r\n";
-                response += "$"+ std::to_string(erased.size()) + "\r\n";
-                response += erased + "\r\n";
-                return response;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
-        } while( response == "" && (std::chrono::steady_clock::now() < end || infiniteTime));
-        response = "*-1\r\n";
+        bool wrongType;
+        List* source = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (!source){
+            std::string response = "$-1\r\n";
+            return response;
+        }
+        return move_element(client, db, argv, source, popLeft, pushLeft, false);
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for lmove command\r\n";
         return response;
     }
+}
+
+std::string blpop_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() >= 3){
+        return blocking_pop(client, argv, db, true);
+    }
     else{
         std::string response = "-ERR wrong number of arguments for blpop command\r\n";
         return response;
     }
-}
\ No newline at end of file
+}
+
+std::string brpop_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() >= 3){
+        return blocking_pop(client, argv, db, false);
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for brpop command\r\n";
+        return response;
+    }
+}
+
+std::string blmove_command(ClientState& client, const Argv& argv, Keyspace& db){
+    if (argv.size() == 6){
+        bool popLeft, pushLeft;
+        if (!parse_where(argv[3], popLeft) || !parse_where(argv[4], pushLeft)){
+            std::string response = "-ERR syntax error\r\n";
+            return response;
+        }
+        std::chrono::steady_clock::time_point deadline;
+        std::string error = parse_block_timeout(argv[5], deadline);
+        if (!error.empty()) return error;
+        bool wrongType;
+        List* source = db.lookup<List>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (source) return move_element(client, db, argv, source, popLeft, pushLeft, true);
+        if (client.execing) return "$-1\r\n";
+        auto pop = std::make_shared<ParkedPop>();
+        pop->argv.assign(argv.begin(), argv.end());
+        pop->keys.emplace_back(argv[1]);
+        pop->move = true;
+        pop->deadline = deadline;
+        park(client, db, std::move(pop));
+        return "";
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for blmove command\r\n";
+        return response;
+    }
+}
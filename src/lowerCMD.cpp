@@ -1,7 +1,7 @@
 #include "lowerCMD.h"
 
-std::string lowercase_command(std::string cmd){
-  std::string lowerized;
-  for (char c : cmd) lowerized += std::tolower(c);
+std::string lowercase_command(std::string_view cmd){
+  std::string lowerized(cmd);
+  for (char& c : lowerized) c = std::tolower(static_cast<unsigned char>(c));
   return lowerized;
-}
\ No newline at end of file
+}
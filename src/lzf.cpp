@@ -0,0 +1,109 @@
+#include "lzf.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned HASH_LOG = 13;
+constexpr size_t MAX_LITERAL = 32;
+constexpr size_t MAX_OFFSET = 1 << 13;
+constexpr size_t MAX_MATCH = 7 + 255 + 2;
+
+inline uint32_t hash3(const uint8_t* p){
+  uint32_t v = uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+  return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+} // namespace
+
+size_t lzf_compress(const char* in, size_t inLen, char* out, size_t outLen){
+  if (!inLen || !outLen) return 0;
+  const uint8_t* base = reinterpret_cast<const uint8_t*>(in);
+  const uint8_t* ip = base;
+  const uint8_t* end = base + inLen;
+  uint8_t* op = reinterpret_cast<uint8_t*>(out);
+  uint8_t* opEnd = op + outLen;
+  uint32_t table[1 << HASH_LOG] = {}; // position + 1 of the last 3 bytes with each hash, 0 is none
+
+  size_t literals = 0;
+  op++; // the current literal run's length byte, filled in when the run ends
+
+  while (ip < end){
+    if (ip + 2 < end){
+      uint32_t h = hash3(ip);
+      uint32_t seen = table[h];
+      table[h] = ip - base + 1;
+      const uint8_t* ref = seen ? base + seen - 1 : ip;
+      size_t offset = ip - ref - 1;
+      if (seen && offset < MAX_OFFSET && std::memcmp(ref, ip, 3) == 0){
+        size_t len = 3;
+        size_t maxLen = end - ip < ptrdiff_t(MAX_MATCH) ? end - ip : MAX_MATCH;
+        while (len < maxLen && ref[len] == ip[len]) len++;
+
+        // Close the literal run, or take back its unused length byte
+        if (literals) op[-ptrdiff_t(literals) - 1] = literals - 1;
+        else op--;
+        literals = 0;
+        if (op + 4 > opEnd) return 0;
+        size_t stored = len - 2;
+        if (stored < 7){
+          *op++ = (offset >> 8) + (stored << 5);
+        } else {
+          *op++ = (offset >> 8) + (7 << 5);
+          *op++ = stored - 7;
+        }
+        *op++ = offset & 0xff;
+        op++; // next literal run
+
+        for (size_t k = 1; k < len && ip + k + 2 < end; k++) table[hash3(ip + k)] = ip + k - base + 1;
+        ip += len;
+        continue;
+      }
+    }
+    if (op >= opEnd) return 0;
+    *op++ = *ip++;
+    if (++literals == MAX_LITERAL){
+      op[-ptrdiff_t(literals) - 1] = literals - 1;
+      literals = 0;
+      if (op >= opEnd) return 0;
+      op++;
+    }
+  }
+  if (literals) op[-ptrdiff_t(literals) - 1] = literals - 1;
+  else op--;
+  return op - reinterpret_cast<uint8_t*>(out);
+}
+
+size_t lzf_decompress(const char* in, size_t inLen, char* out, size_t outLen){
+  const uint8_t* ip = reinterpret_cast<const uint8_t*>(in);
+  const uint8_t* end = ip + inLen;
+  uint8_t* start = reinterpret_cast<uint8_t*>(out);
+  uint8_t* op = start;
+  uint8_t* opEnd = op + outLen;
+
+  while (ip < end){
+    size_t ctrl = *ip++;
+    if (ctrl < MAX_LITERAL){
+      size_t n = ctrl + 1;
+      if (size_t(end - ip) < n || size_t(opEnd - op) < n) return 0;
+      std::memcpy(op, ip, n);
+      op += n;
+      ip += n;
+      continue;
+    }
+    size_t len = ctrl >> 5;
+    if (len == 7){
+      if (ip >= end) return 0;
+      len += *ip++;
+    }
+    if (ip >= end) return 0;
+    size_t offset = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+    len += 2;
+    if (size_t(op - start) < offset || size_t(opEnd - op) < len) return 0;
+    const uint8_t* ref = op - offset;
+    for (size_t i = 0; i < len; i++) op[i] = ref[i]; // may overlap, byte by byte on purpose
+    op += len;
+  }
+  return op - start;
+}
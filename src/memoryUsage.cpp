@@ -0,0 +1,90 @@
+#include "memoryUsage.h"
+#include "slab.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+// Global replacements for operator new / delete that keep a running total.
+// Threads add to one of a few counters on their own cache lines instead of all
+// hammering one atomic, used_memory() sums them. Small blocks come from the slab
+// allocator (slab.h), the rest from malloc.
+
+namespace {
+
+constexpr size_t COUNTERS = 16;
+
+struct alignas(64) Counter {
+  std::atomic<int64_t> bytes{0}; // a thread may free what another allocated, so one can go negative
+};
+
+Counter counters[COUNTERS];
+std::atomic<size_t> nextCounter{0};
+
+Counter& my_counter(){
+  thread_local size_t index = nextCounter.fetch_add(1, std::memory_order_relaxed) % COUNTERS;
+  return counters[index];
+}
+
+void* allocate(size_t size, size_t alignment){
+  if (size == 0) size = 1;
+  if (alignment <= alignof(std::max_align_t)){
+    if (void* p = slab_alloc(size)){
+      my_counter().bytes.fetch_add(slab_usable_size(p), std::memory_order_relaxed);
+      return p;
+    }
+  }
+  void* p = alignment > alignof(std::max_align_t) ? std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1))
+                                                  : std::malloc(size);
+  if (p) my_counter().bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+  return p;
+}
+
+void deallocate(void* p){
+  if (!p) return;
+  if (size_t size = slab_usable_size(p)){
+    my_counter().bytes.fetch_sub(size, std::memory_order_relaxed);
+    slab_free(p);
+    return;
+  }
+  my_counter().bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+  std::free(p);
+}
+
+void* allocate_or_throw(size_t size, size_t alignment){
+  void* p = allocate(size, alignment);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+} // namespace
+
+size_t used_memory(){
+  int64_t total = 0;
+  for (const Counter& counter : counters) total += counter.bytes.load(std::memory_order_relaxed);
+  return total > 0 ? static_cast<size_t>(total) : 0;
+}
+
+void* operator new(size_t size){ return allocate_or_throw(size, 0); }
+void* operator new[](size_t size){ return allocate_or_throw(size, 0); }
+void* operator new(size_t size, std::align_val_t al){ return allocate_or_throw(size, static_cast<size_t>(al)); }
+void* operator new[](size_t size, std::align_val_t al){ return allocate_or_throw(size, static_cast<size_t>(al)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return allocate(size, static_cast<size_t>(al)); }
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return allocate(size, static_cast<size_t>(al)); }
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
@@ -0,0 +1,114 @@
+#include "outputBuffer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <sstream>
+#include <stdexcept>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+void OutputBuffer::append(std::string_view data){
+  if (data.empty()) return;
+  bytes += data.size();
+  if (data.size() > CHUNK){ // big replies get a chunk of their own
+    blocks.emplace_back(data);
+    return;
+  }
+  if (blocks.empty() || blocks.back().size() + data.size() > CHUNK){
+    blocks.emplace_back();
+  }
+  blocks.back().append(data);
+}
+
+void OutputBuffer::append(OutputBuffer&& other){
+  if (other.empty()) return;
+  if (empty()){
+    blocks.swap(other.blocks);
+  } else {
+    for (std::string& block : other.blocks){
+      if (!block.empty()) blocks.push_back(std::move(block));
+    }
+  }
+  bytes += other.bytes;
+  other.blocks.clear();
+  other.bytes = 0;
+}
+
+void OutputBuffer::clear(){
+  // keep the first chunk's capacity, most connections never need a second one
+  if (blocks.size() > 1) blocks.resize(1);
+  if (!blocks.empty()) blocks.front().clear();
+  bytes = 0;
+}
+
+bool OutputBuffer::write_to(int fd){
+  size_t block = 0;
+  size_t offset = 0; // into blocks[block]
+  std::vector<iovec> iov;
+  while (block < blocks.size()){
+    iov.clear();
+    for (size_t i = block; i < blocks.size() && iov.size() < IOV_MAX; i++){
+      size_t skip = i == block ? offset : 0;
+      if (blocks[i].size() == skip) continue;
+      iov.push_back({const_cast<char*>(blocks[i].data()) + skip, blocks[i].size() - skip});
+    }
+    if (iov.empty()) break;
+
+    msghdr msg{};
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = iov.size();
+    ssize_t written = sendmsg(fd, &msg, MSG_NOSIGNAL); // writev without SIGPIPE on a dropped peer
+    if (written < 0){
+      if (errno == EINTR) continue;
+      return false;
+    }
+    // advance past what the kernel took, which may end partway through a chunk
+    size_t left = written;
+    while (block < blocks.size() && left >= blocks[block].size() - offset){
+      left -= blocks[block].size() - offset;
+      block++;
+      offset = 0;
+    }
+    offset += left;
+  }
+  clear();
+  return true;
+}
+
+size_t parse_size(const std::string& s){
+  size_t end = 0;
+  unsigned long long n = std::stoull(s, &end);
+  std::string unit = s.substr(end);
+  std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+  if (unit == "kb" || unit == "k") n *= 1024ULL;
+  else if (unit == "mb" || unit == "m") n *= 1024ULL * 1024;
+  else if (unit == "gb" || unit == "g") n *= 1024ULL * 1024 * 1024;
+  else if (!unit.empty()) throw std::invalid_argument("bad size unit: " + unit);
+  return n;
+}
+
+OutputLimit parse_output_limit(const std::string& spec){
+  std::istringstream in(spec);
+  std::string hard, soft;
+  OutputLimit limit;
+  if (!(in >> hard >> soft >> limit.softSeconds)){
+    throw std::invalid_argument("Expected '<hard> <soft> <soft seconds>'");
+  }
+  limit.hard = parse_size(hard);
+  limit.soft = parse_size(soft);
+  return limit;
+}
+
+bool over_output_limit(size_t used, const OutputLimit& limit, std::chrono::steady_clock::time_point& softSince){
+  if (limit.hard > 0 && used > limit.hard) return true;
+  if (limit.soft == 0 || used <= limit.soft){
+    softSince = {};
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (softSince == std::chrono::steady_clock::time_point{}){
+    softSince = now;
+  }
+  return now - softSince >= std::chrono::seconds(limit.softSeconds);
+}
@@ -86,7 +86,7 @@ std::string read_encoded_string(std::ifstream &file)
   return "error";
 }
 
-int parse_rdbFile(std::map<std::string, std::tuple<std::string, std::chrono::system_clock::time_point>> &dict, std::string filepath)
+int parse_rdbFile(Keyspace& db, std::string filepath)
 {
   std::ifstream file(filepath, std::ios::binary);
 
@@ -124,8 +124,7 @@ int parse_rdbFile(std::map<std::string, std::tuple<std::string, std::chrono::sys
     if (type == 0xFE)
     {
       //std::cout << "Database Start found" << std::endl;
-      uint32_t index = read_size_encoded(file);
-      //std::cout << "index of: " << std::to_string(index) << std::endl;
+      read_size_encoded(file); // database index, only db 0 is loaded
       continue;
     }
     else if (type == 0xFA)
@@ -139,9 +138,8 @@ int parse_rdbFile(std::map<std::string, std::tuple<std::string, std::chrono::sys
     // Hash Information
     else if (type == 0xFB)
     {
-      int mainSize = file.get();
-      int expSize = file.get();
-      //std::cout << "Hash information found:  mainsize = " << std::to_string(mainSize) << " expsize = " << std::to_string(expSize) << std::endl;
+      file.get(); // main and expire table sizes, only hints
+      file.get();
       continue;
     }
 
@@ -161,8 +159,6 @@ int parse_rdbFile(std::map<std::string, std::tuple<std::string, std::chrono::sys
         value |= (static_cast<uint64_t>(bytes[i]) << (8 * i));  // Little-endian
       }
       expiry = std::chrono::system_clock::time_point{std::chrono::milliseconds{value}};
-      std::time_t expiry_time = std::chrono::system_clock::to_time_t(expiry);
-      //std::cout << "Expiry: " << std::put_time(std::localtime(&expiry_time), "%Y-%m-%d %H:%M:%S") << '\n';
       type = file.get();
     } else if (type == 0xFD) { // Expire in seconds FD
       //std::cout << "FD (Seconds expiry) FOUND" << std::endl;
@@ -178,8 +174,6 @@ int parse_rdbFile(std::map<std::string, std::tuple<std::string, std::chrono::sys
         value |= (static_cast<uint32_t>(bytes[i]) << (8 * i));  // Little-endian
       }
       expiry = std::chrono::system_clock::time_point{std::chrono::seconds{value}};
-      std::time_t expiry_time = std::chrono::system_clock::to_time_t(expiry);
-      //std::cout << "Expiry: " << std::put_time(std::localtime(&expiry_time), "%Y-%m-%d %H:%M:%S") << '\n';
       type = file.get();
     }
 
@@ -188,7 +182,7 @@ int parse_rdbFile(std::map<std::string, std::tuple<std::string, std::chrono::sys
       std::string key = read_encoded_string(file);
       std::string value = read_encoded_string(file);
       //std::cout << "Found key:" << key << " With value of: " << value << std::endl;
-      dict[key] = make_tuple(value, expiry);
+      db.set_string(key, value, expiry);
     }
   }
   return 0;
@@ -1,20 +1,14 @@
 #include "ping.h"
-#include "bulkString.h"
-#include "clear.h"
 #include <iostream>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
-std::string ping_command(int& items, int client_fd, std::string& read_buffer){
-  if (items == 0){
+std::string ping_command(const Argv& argv){
+  if (argv.size() == 1){
     std::string response = "+PONG\r\n";
     return response;
   } 
-  else if (items == 1){
-    std::string bulkString = parsebulkString(items, client_fd, read_buffer);
+  else if (argv.size() == 2){
     std::string response = "+";
-    response.append(bulkString);
+    response.append(argv[1]);
     response.append("\r\n");
     return response;
   }
@@ -22,4 +16,4 @@ std::string ping_command(int& items, int client_fd, std::string& read_buffer){
     std::string response = "-ERR wrong number of arguments for ping command\r\n";
     return response;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,332 @@
+#include "quicklist.h"
+#include "lzf.h"
+
+#include <atomic>
+#include <utility>
+
+namespace {
+
+constexpr size_t MIN_COMPRESS_BYTES = 48;  // smaller nodes aren't worth it
+constexpr size_t MIN_COMPRESS_IMPROVE = 8; // nor ones that shrink by less
+
+std::atomic<int> compressDepth{0}; // set once at startup
+
+size_t varint_size(size_t v){
+  size_t n = 1;
+  while (v >>= 7) n++;
+  return n;
+}
+
+size_t packed_size(std::string_view value){
+  size_t back = varint_size(value.size()) + value.size();
+  return back + varint_size(back);
+}
+
+// Writes <length varint><bytes><back length> (see quicklist.h) over the
+// packed_size(value) bytes at `at`, which the caller made room for
+void put(std::string& data, size_t at, std::string_view value){
+  size_t back = varint_size(value.size()) + value.size();
+  size_t backBytes = varint_size(back);
+  char* p = data.data() + at;
+  for (size_t v = value.size();; v >>= 7){
+    *p++ = (v & 0x7f) | (v >= 0x80 ? 0x80 : 0);
+    if (v < 0x80) break;
+  }
+  value.copy(p, value.size());
+  // Lowest group last, every group but the first written flagged as having more before it
+  char* end = data.data() + at + back + backBytes;
+  for (size_t i = 0; i < backBytes; i++){
+    end[-1 - ptrdiff_t(i)] = ((back >> (7 * i)) & 0x7f) | (i + 1 < backBytes ? 0x80 : 0);
+  }
+}
+
+void insert_at(std::string& data, size_t at, std::string_view value){
+  data.insert(at, packed_size(value), '\0');
+  put(data, at, value);
+}
+
+// Byte offset of element i of packed data
+size_t offset_of(std::string_view data, size_t i){
+  size_t offset = 0;
+  for (; i; i--){
+    size_t len = 0;
+    size_t header = 0;
+    for (unsigned shift = 0;; shift += 7){
+      uint8_t b = data[offset + header++];
+      len |= size_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) break;
+    }
+    offset += header + len + varint_size(header + len);
+  }
+  return offset;
+}
+
+// Where the element ending at end starts, read through its back length
+size_t start_before(std::string_view data, size_t end){
+  size_t p = end - 1;
+  size_t back = data[p] & 0x7f;
+  for (unsigned shift = 7; data[p] & 0x80; shift += 7){
+    p--;
+    back |= size_t(data[p] & 0x7f) << shift;
+  }
+  return p - back;
+}
+
+} // namespace
+
+void QuickList::set_compress_depth(int depth){
+  compressDepth.store(depth < 0 ? 0 : depth, std::memory_order_relaxed);
+}
+
+QuickList::QuickList(QuickList&& other) noexcept
+  : head(std::exchange(other.head, nullptr)), tail(std::exchange(other.tail, nullptr)),
+    count(std::exchange(other.count, 0)), nodes(std::exchange(other.nodes, 0)) {}
+
+QuickList& QuickList::operator=(QuickList&& other) noexcept {
+  if (this != &other){
+    clear();
+    head = std::exchange(other.head, nullptr);
+    tail = std::exchange(other.tail, nullptr);
+    count = std::exchange(other.count, 0);
+    nodes = std::exchange(other.nodes, 0);
+  }
+  return *this;
+}
+
+void QuickList::push_front(std::string_view value){
+  if (head) decompress(head);
+  if (!head || head->data.size() + packed_size(value) > NODE_BYTES) insert_node(nullptr, head);
+  insert_at(head->data, 0, value);
+  head->count++;
+  count++;
+  settle(nullptr);
+}
+
+void QuickList::push_back(std::string_view value){
+  if (tail) decompress(tail);
+  if (!tail || tail->data.size() + packed_size(value) > NODE_BYTES) insert_node(tail, nullptr);
+  insert_at(tail->data, tail->data.size(), value);
+  tail->count++;
+  count++;
+  settle(nullptr);
+}
+
+std::string QuickList::pop_front(){
+  decompress(head);
+  size_t bytes;
+  std::string value(decode(head->data.data(), bytes));
+  head->data.erase(0, bytes);
+  count--;
+  if (--head->count == 0) unlink(head);
+  settle(nullptr);
+  return value;
+}
+
+std::string QuickList::pop_back(){
+  decompress(tail);
+  size_t start = start_before(tail->data, tail->data.size());
+  size_t bytes;
+  std::string value(decode(tail->data.data() + start, bytes));
+  tail->data.resize(start);
+  count--;
+  if (--tail->count == 0) unlink(tail);
+  settle(nullptr);
+  return value;
+}
+
+std::string QuickList::at(size_t index) const {
+  size_t offset;
+  const Node* node = seek(index, offset);
+  std::string scratch;
+  std::string_view data = packed(node, scratch);
+  size_t bytes;
+  return std::string(decode(data.data() + offset_of(data, offset), bytes));
+}
+
+void QuickList::set(size_t index, std::string_view value){
+  size_t offset;
+  Node* node = seek(index, offset);
+  decompress(node);
+  size_t at = offset_of(node->data, offset);
+  size_t bytes;
+  decode(node->data.data() + at, bytes);
+  node->data.erase(at, bytes);
+  insert_at(node->data, at, value);
+  Node* extra = split_if_needed(node);
+  settle(node);
+  if (extra) settle(extra);
+}
+
+bool QuickList::insert(std::string_view pivot, std::string_view value, bool after){
+  std::string scratch;
+  for (Node* node = head; node; node = node->next){
+    std::string_view data = packed(node, scratch);
+    size_t at = 0;
+    for (uint32_t i = 0; i < node->count; i++){
+      size_t bytes;
+      std::string_view element = decode(data.data() + at, bytes);
+      if (element != pivot){
+        at += bytes;
+        continue;
+      }
+      if (after) at += bytes;
+      decompress(node);
+      insert_at(node->data, at, value);
+      node->count++;
+      count++;
+      Node* extra = split_if_needed(node);
+      settle(node);
+      if (extra) settle(extra);
+      return true;
+    }
+  }
+  return false;
+}
+
+void QuickList::erase_front(size_t n){
+  while (n && head->count <= n){
+    n -= head->count;
+    count -= head->count;
+    unlink(head);
+  }
+  if (n){
+    decompress(head);
+    head->data.erase(0, offset_of(head->data, n));
+    head->count -= n;
+    count -= n;
+  }
+  settle(nullptr);
+}
+
+void QuickList::erase_back(size_t n){
+  while (n && tail->count <= n){
+    n -= tail->count;
+    count -= tail->count;
+    unlink(tail);
+  }
+  if (n){
+    decompress(tail);
+    tail->data.resize(offset_of(tail->data, tail->count - n));
+    tail->count -= n;
+    count -= n;
+  }
+  settle(nullptr);
+}
+
+void QuickList::clear(){
+  while (head){
+    Node* next = head->next;
+    delete head;
+    head = next;
+  }
+  tail = nullptr;
+  count = nodes = 0;
+}
+
+const QuickList::Node* QuickList::seek(size_t index, size_t& offset) const {
+  if (index < count / 2){
+    const Node* node = head;
+    while (index >= node->count){
+      index -= node->count;
+      node = node->next;
+    }
+    offset = index;
+    return node;
+  }
+  size_t fromTail = count - 1 - index;
+  const Node* node = tail;
+  while (fromTail >= node->count){
+    fromTail -= node->count;
+    node = node->prev;
+  }
+  offset = node->count - 1 - fromTail;
+  return node;
+}
+
+QuickList::Node* QuickList::seek(size_t index, size_t& offset){
+  return const_cast<Node*>(std::as_const(*this).seek(index, offset));
+}
+
+std::string_view QuickList::packed(const Node* node, std::string& scratch) const {
+  if (!node->compressed) return node->data;
+  scratch.resize(node->rawSize);
+  lzf_decompress(node->data.data(), node->data.size(), scratch.data(), scratch.size());
+  return scratch;
+}
+
+QuickList::Node* QuickList::insert_node(Node* prev, Node* next){
+  Node* node = new Node;
+  node->prev = prev;
+  node->next = next;
+  if (prev) prev->next = node;
+  else head = node;
+  if (next) next->prev = node;
+  else tail = node;
+  nodes++;
+  return node;
+}
+
+void QuickList::unlink(Node* node){
+  if (node->prev) node->prev->next = node->next;
+  else head = node->next;
+  if (node->next) node->next->prev = node->prev;
+  else tail = node->prev;
+  nodes--;
+  delete node;
+}
+
+// A node that grew past NODE_BYTES in the middle (LSET, LINSERT) is cut in two
+QuickList::Node* QuickList::split_if_needed(Node* node){
+  if (node->data.size() <= NODE_BYTES || node->count < 2) return nullptr;
+  uint32_t keep = node->count / 2;
+  size_t at = offset_of(node->data, keep);
+  Node* rest = insert_node(node, node->next);
+  rest->data = node->data.substr(at);
+  rest->count = node->count - keep;
+  node->data.resize(at);
+  node->data.shrink_to_fit();
+  node->count = keep;
+  return rest;
+}
+
+void QuickList::compress(Node* node){
+  if (node->compressed || node->data.size() < MIN_COMPRESS_BYTES) return;
+  std::string out(node->data.size() - MIN_COMPRESS_IMPROVE, '\0');
+  size_t n = lzf_compress(node->data.data(), node->data.size(), out.data(), out.size());
+  if (!n) return;
+  node->rawSize = node->data.size();
+  node->data = std::string(out.data(), n);
+  node->compressed = true;
+}
+
+void QuickList::decompress(Node* node){
+  if (!node->compressed) return;
+  std::string raw;
+  packed(node, raw);
+  node->data.swap(raw);
+  node->compressed = false;
+}
+
+// The first and last `depth` nodes stay plain, and the ones just past them, which a
+// push or pop may have moved inward, get compressed. So does `touched` if it's interior
+void QuickList::settle(Node* touched){
+  size_t depth = compressDepth.load(std::memory_order_relaxed);
+  if (!depth) return;
+  if (nodes <= depth * 2){ // all of them are near an end
+    for (Node* node = head; node; node = node->next) decompress(node);
+    return;
+  }
+  bool nearEnd = false;
+  Node* fromHead = head;
+  Node* fromTail = tail;
+  for (size_t i = 0; i < depth; i++){
+    decompress(fromHead);
+    decompress(fromTail);
+    nearEnd = nearEnd || touched == fromHead || touched == fromTail;
+    fromHead = fromHead->next;
+    fromTail = fromTail->prev;
+  }
+  compress(fromHead);
+  compress(fromTail);
+  if (touched && !nearEnd) compress(touched);
+}
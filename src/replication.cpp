@@ -0,0 +1,154 @@
+#include "replication.h"
+#include "lowerCMD.h"
+
+#include <mutex>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <map>
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+std::vector<int> slaves;
+std::map<int,int> replicaOffsets;
+std::mutex replicaMutex; // guards slaves and replicaOffsets
+
+// Writes all of message to a replica. The asio and uring backends keep their sockets
+// non-blocking, so a replica that falls behind fills its socket buffer and send comes
+// back short or with EAGAIN; wait for room like a blocking socket would rather than drop
+// the rest of the stream. Gives up only when the connection is gone
+static void send_to_replica(int fd, const std::string& message){
+  size_t sent = 0;
+  while (sent < message.size()){
+    ssize_t n = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+    if (n > 0){
+      sent += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      pollfd pfd{fd, POLLOUT, 0};
+      if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return;
+      if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) return;
+      continue;
+    }
+    return;
+  }
+}
+
+void rewrite_command(ClientState& client, std::vector<std::string> argv){
+  client.propagateAs = std::move(argv);
+}
+
+void also_propagate(ClientState& client, const Argv& argv){
+  client.alsoPropagate += encode_command(argv);
+}
+
+void propagate_command(ClientState& client, const Argv& argv, bool changed){
+  std::string sMessage;
+  if (changed && !client.propagateAs.empty()) sMessage = encode_command(Argv(client.propagateAs.begin(), client.propagateAs.end()));
+  else if (changed) sMessage = encode_command(argv);
+  sMessage += client.alsoPropagate;
+  client.propagateAs.clear();
+  client.alsoPropagate.clear();
+  if (sMessage.empty()) return;
+  std::lock_guard<std::mutex> lock(replicaMutex);
+  for (int s : slaves){
+    send_to_replica(s, sMessage);
+  }
+  client.replOffset += sMessage.size();
+}
+
+std::string replconf_command(ClientState& client, const Argv& argv){
+  std::string response = "";
+  std::string next = argv.size() > 1 ? lowercase_command(argv[1]) : "";
+  if (next == "getack"){
+    std::cout << "getack called from client" << std::endl;
+    std::string sMessage = "*3\r\n$8\r\nreplconf\r\n$6\r\ngetack\r\n$1\r\n*\r\n";
+    std::lock_guard<std::mutex> lock(replicaMutex);
+    for (int s : slaves){
+      send_to_replica(s, sMessage);
+    }
+    response += "+\r\n";
+  }
+  else if (next == "ack" && argv.size() > 2){
+    int offset = std::stoi(std::string(argv[2]));
+    {
+        std::lock_guard<std::mutex> lock(replicaMutex);
+        replicaOffsets[client.fd] = offset;
+    }
+  }
+  else{
+    response += "+OK\r\n";
+  }
+  return response;
+}
+
+std::string psync_command(ClientState& client, const Argv&){
+  std::string response = "+FULLRESYNC 8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb 0\r\n";
+
+  std::string emptyRDB = "524544495330303131fa0972656469732d76657205372e322e30fa0a72656469732d62697473c040fa056374696d65c26d08bc65fa08757365642d6d656dc2b0c41000fa08616f662d62617365c000fff06e3bfec0ff5aa2";
+  int length = emptyRDB.length() / 2;
+  response += "$" + std::to_string(length) + "\r\n";
+  std::vector<uint8_t> bytes;
+  bytes.reserve(length);
+  for (size_t i = 0; i < emptyRDB.length(); i += 2) {
+    std::string byteStr = emptyRDB.substr(i, 2);
+    uint8_t byte = static_cast<uint8_t>(std::stoul(byteStr, nullptr, 16));
+    bytes.push_back(byte);
+  }
+  response.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  {
+      std::lock_guard<std::mutex> lock(replicaMutex);
+      replicaOffsets[client.fd] = 0;
+      slaves.push_back(client.fd);
+  }
+  return response;
+}
+
+std::string wait_command(ClientState& client, const Argv& argv){
+  int replicaCount = std::stoi(std::string(argv[1]));
+  int timeout = std::stoi(std::string(argv[2]));
+  size_t connectedReplicas = 0;
+  size_t wanted = replicaCount > 0 ? replicaCount : 0;
+  auto start = std::chrono::steady_clock::now();
+
+  std::string sMessage = "*3\r\n$8\r\nREPLCONF\r\n$6\r\nGETACK\r\n$1\r\n*\r\n";
+  size_t replicas;
+  {
+    std::lock_guard<std::mutex> lock(replicaMutex);
+    for (int s : slaves){
+      send_to_replica(s, sMessage);
+    }
+    replicas = slaves.size();
+  }
+
+  while(true){
+
+    connectedReplicas = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(replicaMutex);
+      for (int s : slaves) {
+          if (replicaOffsets[s] >= client.replOffset) connectedReplicas++;
+      }
+    }
+
+    if (timeout > 0){
+      auto now = std::chrono::steady_clock::now();
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+      if (elapsed >= timeout) {
+        break; // timeout
+      }
+    }
+    if (connectedReplicas >= wanted || connectedReplicas == replicas){
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  return ":" + std::to_string(connectedReplicas) + "\r\n";
+}
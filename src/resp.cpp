@@ -0,0 +1,113 @@
+#include "resp.h"
+
+const long long MAX_ARGS = 1024 * 1024;
+const long long MAX_BULK_LEN = 512LL * 1024 * 1024;
+const size_t MAX_INLINE_LEN = 64 * 1024;
+
+// Reads the integer that ends at the next \r\n starting at pos. Advances pos past the \r\n
+static ParseStatus read_int(const std::string& buffer, size_t& pos, long long& value){
+  size_t end = buffer.find("\r\n", pos);
+  if (end == std::string::npos) return ParseStatus::Incomplete;
+  if (end == pos) return ParseStatus::Error;
+  bool negative = buffer[pos] == '-';
+  size_t i = negative ? pos + 1 : pos;
+  if (i == end) return ParseStatus::Error;
+  value = 0;
+  for (; i < end; i++){
+    char c = buffer[i];
+    if (c < '0' || c > '9') return ParseStatus::Error;
+    value = value * 10 + (c - '0');
+    if (value > MAX_BULK_LEN) return ParseStatus::Error;
+  }
+  if (negative) value = -value;
+  pos = end + 2;
+  return ParseStatus::Ok;
+}
+
+ParseStatus RespParser::next(const std::string& buffer, Argv& argv){
+  argv.clear();
+  size_t pos = cursor;
+
+  // Inline commands like "PING\r\n", as typed into telnet
+  while (pos < buffer.size() && buffer[pos] != '*'){
+    size_t eol = buffer.find('\n', pos);
+    if (eol == std::string::npos){
+      if (buffer.size() - pos > MAX_INLINE_LEN){
+        error = "too big inline request";
+        return ParseStatus::Error;
+      }
+      return ParseStatus::Incomplete;
+    }
+    size_t lineEnd = (eol > pos && buffer[eol - 1] == '\r') ? eol - 1 : eol;
+    std::string_view line(buffer.data() + pos, lineEnd - pos);
+    size_t start = 0;
+    while (start < line.size()){
+      size_t space = line.find(' ', start);
+      if (space == std::string_view::npos) space = line.size();
+      if (space > start) argv.push_back(line.substr(start, space - start));
+      start = space + 1;
+    }
+    pos = eol + 1;
+    cursor = pos;
+    if (!argv.empty()) return ParseStatus::Ok; // blank lines are skipped
+  }
+  if (pos >= buffer.size()) return ParseStatus::Incomplete;
+
+  pos += 1;
+  long long count = 0;
+  ParseStatus status = read_int(buffer, pos, count);
+  if (status != ParseStatus::Ok || count > MAX_ARGS){
+    if (status != ParseStatus::Incomplete) error = "invalid multibulk length";
+    return status == ParseStatus::Ok ? ParseStatus::Error : status;
+  }
+
+  for (long long i = 0; i < count; i++){
+    if (pos >= buffer.size()){
+      argv.clear();
+      return ParseStatus::Incomplete;
+    }
+    if (buffer[pos] != '$'){
+      error = std::string("expected '$', got '") + buffer[pos] + "'";
+      argv.clear();
+      return ParseStatus::Error;
+    }
+    pos += 1;
+    long long len = 0;
+    status = read_int(buffer, pos, len);
+    if (status != ParseStatus::Ok || len < 0){
+      if (status != ParseStatus::Incomplete) error = "invalid bulk length";
+      argv.clear();
+      return status == ParseStatus::Ok ? ParseStatus::Error : status;
+    }
+    if (pos + len + 2 > buffer.size()){
+      argv.clear();
+      return ParseStatus::Incomplete;
+    }
+    if (buffer[pos + len] != '\r' || buffer[pos + len + 1] != '\n'){
+      error = "missing CRLF after bulk string";
+      argv.clear();
+      return ParseStatus::Error;
+    }
+    argv.emplace_back(buffer.data() + pos, len);
+    pos += len + 2;
+  }
+
+  cursor = pos;
+  return ParseStatus::Ok;
+}
+
+void RespParser::compact(std::string& buffer){
+  if (cursor == 0) return;
+  buffer.erase(0, cursor);
+  cursor = 0;
+}
+
+std::string encode_command(const Argv& argv){
+  std::string message = "*" + std::to_string(argv.size()) + "\r\n";
+  for (std::string_view arg : argv){
+    message += "$" + std::to_string(arg.size()) + "\r\n";
+    message.append(arg);
+    message += "\r\n";
+  }
+  return message;
+}
@@ -1,268 +1,831 @@
 #include "set.h"
-#include "bulkString.h"
+#include "keyspace.h"
+#include "lowerCMD.h"
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+
+static const std::string NOT_INTEGER = "-ERR value is not an integer or out of range\r\n";
+static const std::string NOT_FLOAT = "-ERR value is not a valid float\r\n";
+static const std::string NOT_FLOAT_RANGE = "-ERR min or max is not a float\r\n";
+static const std::string NOT_LEX_RANGE = "-ERR min or max not valid string range item\r\n";
+static const std::string SYNTAX_ERROR = "-ERR syntax error\r\n";
+
+// Each level past the first with probability 1/4: two more trailing zero bits per level
+static int randomLevel(int maxLevel) {
+    static thread_local std::mt19937_64 rng{std::random_device{}()};
+    int level = 1 + std::countr_zero(rng() | (uint64_t(1) << 62)) / 2;
+    return level < maxLevel ? level : maxLevel;
+}
 
-#include <iostream>
-#include <iomanip>
-#include <sstream>
+// About log4(size) + 2 levels, enough that the top one holds a few nodes
+static int levels_for(size_t size){
+    int height = (std::bit_width(size) + 1) / 2 + 2;
+    return height < 4 ? 4 : height < SkipList::LEVEL_LIMIT ? height : SkipList::LEVEL_LIMIT;
+}
 
-static int randomLevel(float p, int maxLevel) {
-    int level = 0;
-    while (((float) rand() / RAND_MAX) < p && level < maxLevel) {
-        level++;
-    }
-    return level;
+Node* Node::create(int height, double score, std::string_view member){
+    void* block = ::operator new(sizeof(Node) + height * sizeof(Level) + member.size());
+    Node* node = new (block) Node{score, nullptr, static_cast<uint32_t>(member.size()), static_cast<uint8_t>(height)};
+    for (int i = 0; i < height; i++) node->level(i) = Level{nullptr, 0};
+    std::memcpy(&node->level(height), member.data(), member.size());
+    return node;
 }
 
-std::string zadd_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets){
-        if (items == 3){
+void Node::destroy(Node* node){
+    ::operator delete(node);
+}
 
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            std::string strScore = parsebulkString(items, client_fd, read_buffer);\
-            double score = std::stod(strScore);
-            std::string key = parsebulkString(items, client_fd, read_buffer);
-            std::string response = ":1\r\n";
+SkipList::SkipList() : maxLevel(levels_for(0)), head(Node::create(maxLevel, 0, "")) {}
 
-            SkipList& sl = sets[listName];
+// Only the head's links change, no node points back at it
+void SkipList::grow_head(int height){
+    Node* bigger = Node::create(height, 0, "");
+    for (int i = 0; i < maxLevel; i++) bigger->level(i) = head->level(i);
+    Node::destroy(head);
+    head = bigger;
+    maxLevel = height;
+}
 
-            std::vector<Node*> update(sl.maxLevel + 1, nullptr);
-            Node* x = sl.head;
+// Sorted by score, ties by member bytes
+static bool less(double score, std::string_view member, double otherScore, std::string_view other){
+    return score < otherScore || (score == otherScore && member < other);
+}
 
-            // Now scan level 0 from head to find existing node with the same key
-            Node* prev = sl.head;
-            Node* nodeToRemove = nullptr;
-            for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                if (n->key == key) {
-                    nodeToRemove = n;
-                    break;
-                }
-            }
-            if (nodeToRemove) {
-                std::vector<Node*> update(sl.maxLevel + 1, nullptr);
-                Node* curr = sl.head;
-                for (int i = sl.currentLevel; i >= 0; i--) {
-                    Node* node = curr;
-                    while (node->forward[i] != nullptr && node->forward[i]->key != key) {
-                        node = node->forward[i];
-                    }
-                    update[i] = node;
-                }
-                Node* target = update[0]->forward[0];
-                for (int i = 0; i <= sl.currentLevel; i++) {
-                    if (update[i]->forward[i] != target) break;
-                    update[i]->forward[i] = target->forward[i];
-                }
-                delete target;
-                response = ":0\r\n";
-            }
+static bool before(const Node* node, double score, std::string_view member){
+    return less(node->score, node->key(), score, member);
+}
 
-            // Step 1: Search top-down to find insertion positions
-            for (int i = sl.currentLevel; i >= 0; i--) {
-                while (x->forward[i] != nullptr && 
-                    (x->forward[i]->score < score || (x->forward[i]->score == score && x->forward[i]->key < key))) 
-                {
-                    x = x->forward[i];
-                }
-                update[i] = x; // remember where we dropped down
-            }
+// Like Redis: the whole argument, inf and -inf allowed, nan not
+static bool parse_score(std::string_view arg, double& score){
+    std::string text(arg);
+    char* end = nullptr;
+    score = std::strtod(text.c_str(), &end);
+    return !text.empty() && !std::isspace(static_cast<unsigned char>(text[0])) &&
+           end == text.c_str() + text.size() && !std::isnan(score);
+}
 
-            // 2 : assign a random level, make new ones as necessary
-            int lvl = randomLevel(sl.p, sl.maxLevel);
-            if (lvl > sl.currentLevel) {
-                for (int i = sl.currentLevel + 1; i <= lvl; i++) {
-                    update[i] = sl.head;
-                }
-                sl.currentLevel = lvl;
-            }
+static std::string bulk(std::string_view s){
+    std::string response = "$" + std::to_string(s.size()) + "\r\n";
+    response.append(s);
+    response += "\r\n";
+    return response;
+}
 
-            // 3 : Make new node and fill in 
-            Node* newNode = new Node(score, key, lvl + 1);
-            for (int i = 0; i <= lvl; i++) {
-                newNode->forward[i] = update[i]->forward[i];
-                update[i]->forward[i] = newNode;
-            }
+static std::string format_score(double score){
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%.17g", score);
+    return std::string(buf, n);
+}
 
-            if (response != ":0\r\n"){
-                sl.size +=1;
-            }
+void SkipList::find_update(double score, std::string_view member, Node** update, size_t* rank) const {
+    Node* x = head;
+    for (int i = levels - 1; i >= 0; i--) {
+        rank[i] = i == levels - 1 ? 0 : rank[i + 1];
+        while (x->level(i).forward && before(x->level(i).forward, score, member)) {
+            rank[i] += x->level(i).span;
+            x = x->level(i).forward;
+        }
+        update[i] = x; // remember where we dropped down
+    }
+}
 
-            return response;
+// Links node, whose levels are already sized, after update[]. Levels new to the list start at the head
+void SkipList::link(Node* node, Node** update, size_t* rank){
+    int lvl = node->height;
+    if (lvl > levels) {
+        for (int i = levels; i < lvl; i++) {
+            rank[i] = 0;
+            update[i] = head;
+            head->level(i).span = length;
         }
-        else{
-            std::string response = "-ERR wrong number of arguments for zadd command\r\n";
-            return response;
+        levels = lvl;
+    }
+    for (int i = 0; i < lvl; i++) {
+        node->level(i).forward = update[i]->level(i).forward;
+        update[i]->level(i).forward = node;
+        // update[i] was rank[i], the new node is rank[0] + 1
+        node->level(i).span = update[i]->level(i).span - (rank[0] - rank[i]);
+        update[i]->level(i).span = rank[0] - rank[i] + 1;
+    }
+    for (int i = lvl; i < levels; i++) update[i]->level(i).span++; // links passing over it
+    node->backward = update[0] == head ? nullptr : update[0];
+    if (node->next()) node->next()->backward = node;
+    else tail = node;
+    length++;
+}
+
+void SkipList::unlink(Node* node, Node** update){
+    for (int i = 0; i < levels; i++) {
+        if (update[i]->level(i).forward == node) {
+            update[i]->level(i).span += node->level(i).span - 1;
+            update[i]->level(i).forward = node->level(i).forward;
+        } else {
+            update[i]->level(i).span--;
         }
     }
+    if (node->next()) node->next()->backward = node->backward;
+    else tail = node->backward;
+    while (levels > 1 && head->level(levels - 1).forward == nullptr) levels--;
+    length--;
+}
 
-std::string zrank_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets){
-        if (items == 2){
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            std::string key = parsebulkString(items, client_fd, read_buffer);
+Node* SkipList::insert(double score, std::string_view member){
+    Node* update[LEVEL_LIMIT];
+    size_t rank[LEVEL_LIMIT];
+    if (levels_for(length + 1) > maxLevel) grow_head(levels_for(length + 1));
+    find_update(score, member, update, rank);
+    Node* node = Node::create(randomLevel(maxLevel), score, member);
+    link(node, update, rank);
+    members.insert_or_assign(node->key(), node);
+    return node;
+}
 
-            std::string response = "";
-            int rank = -1;
+void SkipList::update_score(Node* node, double score){
+    Node* update[LEVEL_LIMIT];
+    size_t rank[LEVEL_LIMIT];
+    find_update(node->score, node->key(), update, rank);
+    Node* prev = update[0];
+    Node* next = node->next();
+    // Still between its neighbours: nothing to relink
+    if ((prev == head || before(prev, score, node->key())) && (!next || less(score, node->key(), next->score, next->key()))) {
+        node->score = score;
+        return;
+    }
+    unlink(node, update);
+    node->score = score;
+    find_update(score, node->key(), update, rank);
+    link(node, update, rank);
+}
 
-            SkipList& sl = sets[listName];
+bool SkipList::erase(std::string_view member){
+    Node* node = find(member);
+    if (!node) return false;
+    Node* update[LEVEL_LIMIT];
+    size_t rank[LEVEL_LIMIT];
+    find_update(node->score, node->key(), update, rank);
+    unlink(node, update);
+    members.erase(member); // before the node, the index keys on its bytes
+    Node::destroy(node);
+    return true;
+}
 
-            Node* prev = sl.head;
-            for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                rank +=1;
-                if (n->key == key) {
-                    break;
-                }
-                if (n->forward[0] == nullptr){
-                    rank = -1;
-                }
-            }
+size_t SkipList::rank_of(const Node* node) const {
+    size_t rank = 0;
+    Node* x = head;
+    for (int i = levels - 1; i >= 0; i--) {
+        while (x->level(i).forward && !before(node, x->level(i).forward->score, x->level(i).forward->key())) {
+            rank += x->level(i).span;
+            x = x->level(i).forward;
+        }
+        if (x == node) break;
+    }
+    return rank - 1; // spans count the head as rank 0
+}
 
-            if (rank == -1){
-                response = "$-1\r\n";
-            }
-            else{
-                response += ":" + std::to_string(rank) + "\r\n";
-            }
+Node* SkipList::at_rank(size_t rank) const {
+    rank++; // spans count the head as rank 0
+    size_t traversed = 0;
+    Node* x = head;
+    for (int i = levels - 1; i >= 0; i--) {
+        while (x->level(i).forward && traversed + x->level(i).span <= rank) {
+            traversed += x->level(i).span;
+            x = x->level(i).forward;
+        }
+        if (traversed == rank) return x;
+    }
+    return nullptr;
+}
 
-            return response;
+void SkipList::erase_ranks(size_t first, size_t last){
+    // Spans count the head as rank 0, so the run is ranks first + 1 .. last + 1 here
+    size_t count = last - first + 1;
+    Node* update[LEVEL_LIMIT] = {}; // levels is at least 1, which GCC can't tell
+    size_t rank[LEVEL_LIMIT];
+    Node* x = head;
+    size_t traversed = 0;
+    for (int i = levels - 1; i >= 0; i--) {
+        while (x->level(i).forward && traversed + x->level(i).span <= first) {
+            traversed += x->level(i).span;
+            x = x->level(i).forward;
         }
-        else{
-            std::string response = "-ERR wrong number of arguments for zrank command\r\n";
-            return response;
+        update[i] = x; // the last node before the run on this level
+        rank[i] = traversed;
+    }
+    Node* gone = update[0]->next();
+
+    for (int i = 0; i < levels; i++) {
+        Node* y = update[i]->level(i).forward;
+        size_t yRank = rank[i] + update[i]->level(i).span; // the length when y is null
+        while (y && yRank <= last + 1) {
+            yRank += y->level(i).span;
+            y = y->level(i).forward;
         }
+        update[i]->level(i).forward = y;
+        update[i]->level(i).span = yRank - rank[i] - count;
+    }
+    Node* after = update[0]->next();
+    Node* before = update[0] == head ? nullptr : update[0];
+    if (after) after->backward = before;
+    else tail = before;
+    while (levels > 1 && head->level(levels - 1).forward == nullptr) levels--;
+    length -= count;
+
+    for (size_t i = 0; i < count; i++) {
+        Node* next = gone->next();
+        members.erase(gone->key()); // before the node, the index keys on its bytes
+        Node::destroy(gone);
+        gone = next;
+    }
+}
+
+void SkipList::clear() {
+    members.clear();
+    Node* n = head;
+    while (n){
+        Node* next = n->level(0).forward;
+        Node::destroy(n);
+        n = next;
+    }
+    head = tail = nullptr;
+    length = 0;
+}
+
+// Member lengths are LEB128 varints, one byte up to 127
+static char* put_varint(char* p, size_t n){
+    while (n >= 0x80) {
+        *p++ = static_cast<char>((n & 0x7f) | 0x80);
+        n >>= 7;
     }
+    *p++ = static_cast<char>(n);
+    return p;
+}
 
-std::string zrange_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets){
-        if (items == 3){
+ZSetPack::Entry ZSetPack::entry(size_t offset) const {
+    const char* p = data.data() + offset;
+    double score;
+    std::memcpy(&score, p, sizeof(score));
+    p += sizeof(score);
+    size_t length = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        unsigned char byte = *p++;
+        length |= size_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    size_t member = p - data.data();
+    return Entry{score, std::string_view(p, length), member + length};
+}
 
-            std::string response = "";
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            int startIndex = std::stoi(parsebulkString(items, client_fd, read_buffer));
-            int endIndex = std::stoi(parsebulkString(items, client_fd, read_buffer));
+size_t ZSetPack::find(std::string_view member) const {
+    for (size_t at = 0; at < data.size();) {
+        Entry e = entry(at);
+        if (e.member == member) return at;
+        at = e.next;
+    }
+    return npos;
+}
 
-            auto it = sets.find(listName);
+size_t ZSetPack::seek(size_t rank) const {
+    size_t at = 0;
+    while (rank--) at = entry(at).next;
+    return at;
+}
 
-            if (it == sets.end()){ 
-                response = "*0\r\n";
-                return response;
-            }
+void ZSetPack::insert(double score, std::string_view member){
+    size_t at = 0;
+    while (at < data.size()) {
+        Entry e = entry(at);
+        if (!less(e.score, e.member, score, member)) break;
+        at = e.next;
+    }
+    char header[sizeof(double) + 10];
+    std::memcpy(header, &score, sizeof(score));
+    char* end = put_varint(header + sizeof(score), member.size());
+    data.reserve(data.size() + (end - header) + member.size()); // exactly, not doubled
+    data.insert(data.begin() + at, member.begin(), member.end());
+    data.insert(data.begin() + at, header, end);
+    count++;
+}
 
-            SkipList& sl = it->second;
-            int len = sl.size;
+void ZSetPack::erase_at(size_t offset){
+    data.erase(data.begin() + offset, data.begin() + entry(offset).next);
+    count--;
+}
 
-            if (startIndex < 0){
-                startIndex = len + startIndex;
-                startIndex = (startIndex > 0) ? startIndex : 0;
+void ZSetPack::erase_ranks(size_t first, size_t last){
+    size_t from = seek(first);
+    size_t to = from;
+    for (size_t i = first; i <= last; i++) to = entry(to).next;
+    data.erase(data.begin() + from, data.begin() + to);
+    count -= last - first + 1;
+}
+
+// Redis' defaults for zset-max-listpack-entries / zset-max-listpack-value
+static std::atomic<size_t> maxPackedEntries{128};
+static std::atomic<size_t> maxPackedValue{64};
+
+void ZSet::set_packed_limits(size_t entries, size_t value){
+    maxPackedEntries.store(entries, std::memory_order_relaxed);
+    maxPackedValue.store(value, std::memory_order_relaxed);
+}
+
+bool ZSet::score(std::string_view member, double& score) const {
+    if (list) {
+        Node* node = list->find(member);
+        if (node) score = node->score;
+        return node;
+    }
+    size_t at = pack.find(member);
+    if (at == ZSetPack::npos) return false;
+    score = pack.entry(at).score;
+    return true;
+}
+
+bool ZSet::rank(std::string_view member, size_t& rank) const {
+    if (list) {
+        Node* node = list->find(member);
+        if (node) rank = list->rank_of(node);
+        return node;
+    }
+    rank = 0;
+    for (size_t at = 0; at < pack.bytes(); rank++) {
+        ZSetPack::Entry e = pack.entry(at);
+        if (e.member == member) return true;
+        at = e.next;
+    }
+    return false;
+}
+
+void ZSet::insert(double score, std::string_view member){
+    if (!list && (pack.size() >= maxPackedEntries.load(std::memory_order_relaxed) ||
+                  member.size() > maxPackedValue.load(std::memory_order_relaxed))) {
+        convert();
+    }
+    if (list) list->insert(score, member);
+    else pack.insert(score, member);
+}
+
+void ZSet::update(std::string_view member, double score){
+    if (list) {
+        list->update_score(list->find(member), score);
+        return;
+    }
+    // The erase leaves the slack the insert needs, nothing is reallocated
+    pack.erase_at(pack.find(member));
+    pack.insert(score, member);
+}
+
+bool ZSet::erase(std::string_view member){
+    if (list) return list->erase(member);
+    size_t at = pack.find(member);
+    if (at == ZSetPack::npos) return false;
+    pack.erase_at(at);
+    return true;
+}
+
+void ZSet::erase_ranks(size_t first, size_t last){
+    if (list) list->erase_ranks(first, last);
+    else pack.erase_ranks(first, last);
+}
+
+// One way, like Redis: a set that grew past the limits once is likely to again
+void ZSet::convert(){
+    auto converted = std::make_unique<SkipList>();
+    for (size_t at = 0; at < pack.bytes();) {
+        ZSetPack::Entry e = pack.entry(at);
+        converted->insert(e.score, e.member);
+        at = e.next;
+    }
+    list = std::move(converted);
+    pack = ZSetPack();
+}
+
+// ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+std::string zadd_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 4){
+            bool nx = false, xx = false, gt = false, lt = false, ch = false, incr = false;
+            size_t first = 2;
+            for (; first < argv.size(); first++) {
+                std::string flag = lowercase_command(argv[first]);
+                if (flag == "nx") nx = true;
+                else if (flag == "xx") xx = true;
+                else if (flag == "gt") gt = true;
+                else if (flag == "lt") lt = true;
+                else if (flag == "ch") ch = true;
+                else if (flag == "incr") incr = true;
+                else break;
             }
-            if (endIndex < 0){
-                endIndex = len + endIndex;
-                endIndex = (endIndex > 0) ? endIndex : 0;
+            size_t pairs = (argv.size() - first) / 2;
+            if (pairs == 0 || (argv.size() - first) % 2) return SYNTAX_ERROR;
+            if (nx && xx) return "-ERR XX and NX options at the same time are not compatible\r\n";
+            if ((gt && lt) || (nx && (gt || lt))) {
+                return "-ERR GT, LT, and/or NX options at the same time are not compatible\r\n";
             }
+            if (incr && pairs > 1) return "-ERR INCR option supports a single increment-element pair\r\n";
 
-            if ((startIndex > endIndex) || (startIndex >= len)){ 
-                response = "*0\r\n";
-                return response;
+            // Every score is checked before anything changes
+            std::vector<double> scores(pairs);
+            for (size_t i = 0; i < pairs; i++) {
+                if (!parse_score(argv[first + 2 * i], scores[i])) return NOT_FLOAT;
             }
 
-            endIndex = (endIndex < len-1) ? endIndex : len-1;
-            
-            response = "*" + std::to_string(endIndex-startIndex+1) + "\r\n";
-            Node* curr = sl.head;
-            for(int i = 0; i < startIndex; i++){
-                curr = curr->forward[0];
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found) {
+                if (xx) return incr ? "$-1\r\n" : ":0\r\n"; // nothing to update, and no empty set left behind
+                found = db.lookup_or_create<ZSet>(argv[1], wrongType);
             }
-            for(int i = startIndex; i <= endIndex; i++){
-                std::string element = curr->forward[0]->key;
-                response += "$"+ std::to_string(element.size()) + "\r\n";
-                response += element + "\r\n";
-                curr = curr->forward[0];
+            ZSet& zs = *found;
+
+            size_t added = 0, changed = 0;
+            double score = 0;
+            bool skipped = false; // INCR's reply is nil when the flags left the member alone
+            for (size_t i = 0; i < pairs; i++) {
+                score = scores[i];
+                std::string_view member = argv[first + 2 * i + 1];
+                double current;
+                if (!zs.score(member, current)) {
+                    if (xx) { skipped = true; continue; }
+                    zs.insert(score, member);
+                    db.mark_dirty();
+                    added++;
+                    continue;
+                }
+                if (nx) { skipped = true; continue; }
+                if (incr) {
+                    score += current;
+                    if (std::isnan(score)) return "-ERR resulting score is not a number (NaN)\r\n";
+                }
+                if ((gt && score <= current) || (lt && score >= current)) { skipped = true; continue; }
+                if (score != current) {
+                    zs.update(member, score);
+                    db.mark_dirty();
+                    changed++;
+                }
             }
 
+            if (incr) return skipped ? "$-1\r\n" : bulk(format_score(score));
+            return ":" + std::to_string(ch ? added + changed : added) + "\r\n";
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zadd command\r\n";
             return response;
         }
+    }
+
+std::string zrank_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 3){
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            size_t rank;
+            if (!found || !found->rank(argv[2], rank)) return "$-1\r\n";
+            return ":" + std::to_string(rank) + "\r\n";
+        }
         else{
-            std::string response = "-ERR wrong number of arguments for zrange command\r\n";
+            std::string response = "-ERR wrong number of arguments for zrank command\r\n";
             return response;
         }
     }
 
-std::string zcard_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets){
-        if(items == 1){
-            std::string key = parsebulkString(items, client_fd, read_buffer);
-            SkipList& sl = sets[key];
+// A ZRANGEBYSCORE / ZRANGEBYLEX bound
+struct Bound {
+    double score = 0;
+    std::string_view member;
+    bool exclusive = false;
+    bool lowest = false;  // "-", below every member
+    bool highest = false; // "+", above every member
+};
+
+// "1.5", "(1.5" exclusive, "-inf", "+inf"
+static bool parse_score_bound(std::string_view arg, Bound& bound){
+    if (!arg.empty() && arg[0] == '(') {
+        bound.exclusive = true;
+        arg.remove_prefix(1);
+    }
+    return parse_score(arg, bound.score);
+}
+
+// "[a" inclusive, "(a" exclusive, "-", "+"
+static bool parse_lex_bound(std::string_view arg, Bound& bound){
+    if (arg == "-") bound.lowest = true;
+    else if (arg == "+") bound.highest = true;
+    else if (!arg.empty() && (arg[0] == '[' || arg[0] == '(')) {
+        bound.exclusive = arg[0] == '(';
+        bound.member = arg.substr(1);
+    }
+    else return false;
+    return true;
+}
+
+// The ranks [lo, hi) of the members between min and max, two walks down the levels
+static void score_window(const ZSet& zs, const Bound& min, const Bound& max, size_t& lo, size_t& hi){
+    lo = zs.count_while([&](double score, std::string_view){ return min.exclusive ? score <= min.score : score < min.score; });
+    hi = zs.count_while([&](double score, std::string_view){ return max.exclusive ? score < max.score : score <= max.score; });
+    if (hi < lo) hi = lo;
+}
+
+// Like Redis, only meaningful when every member has the same score
+static void lex_window(const ZSet& zs, const Bound& min, const Bound& max, size_t& lo, size_t& hi){
+    if (min.lowest) lo = 0;
+    else if (min.highest) lo = zs.size();
+    else lo = zs.count_while([&](double, std::string_view m){ return min.exclusive ? m <= min.member : m < min.member; });
+    if (max.highest) hi = zs.size();
+    else if (max.lowest) hi = 0;
+    else hi = zs.count_while([&](double, std::string_view m){ return max.exclusive ? m < max.member : m <= max.member; });
+    if (hi < lo) hi = lo;
+}
 
-            std::string response = ":"+std::to_string(sl.size)+"\r\n";
+// ZRANGE's start / stop: negative from the end, clamped. False if nothing is in range
+static bool index_window(int64_t start, int64_t stop, int64_t len, size_t& lo, size_t& hi){
+    if (start < 0) start = len + start > 0 ? len + start : 0;
+    if (stop < 0) stop = len + stop;
+    if (start > stop || start >= len) return false;
+    if (stop >= len) stop = len - 1;
+    lo = start;
+    hi = stop + 1;
+    return true;
+}
+
+struct RangeOptions {
+    bool byScore = false;
+    bool byLex = false;
+    bool rev = false;
+    bool withScores = false;
+    bool limit = false;
+    int64_t offset = 0;
+    int64_t count = -1; // all
+};
+
+// Options after ZRANGE's key and bounds. BYSCORE / BYLEX / REV are ZRANGE's own, the
+// ZRANGEBY* commands set them in options beforehand
+static std::string parse_range_options(const Argv& argv, bool zrange, RangeOptions& options){
+    for (size_t i = 4; i < argv.size(); i++) {
+        std::string option = lowercase_command(argv[i]);
+        if (option == "withscores") options.withScores = true;
+        else if (option == "limit" && i + 2 < argv.size()) {
+            if (!parse_int64(argv[i + 1], options.offset) || !parse_int64(argv[i + 2], options.count)) return NOT_INTEGER;
+            options.limit = true;
+            i += 2;
+        }
+        else if (zrange && option == "byscore") options.byScore = true;
+        else if (zrange && option == "bylex") options.byLex = true;
+        else if (zrange && option == "rev") options.rev = true;
+        else return SYNTAX_ERROR;
+    }
+    if (options.byScore && options.byLex) return SYNTAX_ERROR;
+    if (options.limit && !options.byScore && !options.byLex) {
+        return "-ERR syntax error, LIMIT is only supported in combination with either BYSCORE or BYLEX\r\n";
+    }
+    if (options.byLex && options.withScores) {
+        return "-ERR syntax error, WITHSCORES not supported in combination with BYLEX\r\n";
+    }
+    return "";
+}
+
+// Ranks [lo, hi) after LIMIT's offset and count, from the top with REV: a seek, then
+// a walk along level 0 (backwards with REV)
+static std::string range_reply(const ZSet& zs, size_t lo, size_t hi, const RangeOptions& options){
+    size_t n = hi - lo;
+    if (options.offset < 0 || static_cast<uint64_t>(options.offset) >= n) return "*0\r\n";
+    n -= options.offset;
+    if (options.count >= 0 && static_cast<uint64_t>(options.count) < n) n = options.count;
+
+    std::string response = "*" + std::to_string(options.withScores ? n * 2 : n) + "\r\n";
+    zs.for_range(options.rev ? hi - 1 - options.offset : lo + options.offset, n, options.rev,
+                 [&](double score, std::string_view member){
+        response += bulk(member);
+        if (options.withScores) response += bulk(format_score(score));
+    });
+    return response;
+}
+
+// Every ZRANGE form. first / last are the bounds as given: with REV they go from high to low
+static std::string zrange_generic(const Argv& argv, Keyspace& db, std::string_view first, std::string_view last,
+                                  const RangeOptions& options){
+    std::string_view from = options.rev && (options.byScore || options.byLex) ? last : first;
+    std::string_view to = options.rev && (options.byScore || options.byLex) ? first : last;
+    Bound min, max;
+    int64_t start = 0, stop = 0;
+    if (options.byScore) {
+        if (!parse_score_bound(from, min) || !parse_score_bound(to, max)) return NOT_FLOAT_RANGE;
+    }
+    else if (options.byLex) {
+        if (!parse_lex_bound(from, min) || !parse_lex_bound(to, max)) return NOT_LEX_RANGE;
+    }
+    else if (!parse_int64(first, start) || !parse_int64(last, stop)) return NOT_INTEGER;
+
+    bool wrongType;
+    ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+    if (wrongType) return WRONGTYPE;
+    if (!found) return "*0\r\n";
+
+    size_t lo, hi;
+    if (options.byScore) score_window(*found, min, max, lo, hi);
+    else if (options.byLex) lex_window(*found, min, max, lo, hi);
+    else {
+        if (!index_window(start, stop, found->size(), lo, hi)) return "*0\r\n";
+        if (options.rev) { // counted from the top
+            size_t len = found->size();
+            std::swap(lo, hi);
+            lo = len - lo;
+            hi = len - hi;
+        }
+    }
+    return range_reply(*found, lo, hi, options);
+}
+
+// ZRANGE key start stop [BYSCORE | BYLEX] [REV] [LIMIT offset count] [WITHSCORES]
+std::string zrange_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 4){
+            RangeOptions options;
+            std::string error = parse_range_options(argv, true, options);
+            if (!error.empty()) return error;
+            return zrange_generic(argv, db, argv[2], argv[3], options);
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zrange command\r\n";
             return response;
         }
+    }
+
+// ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+std::string zrangebyscore_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 4){
+            RangeOptions options;
+            options.byScore = true;
+            std::string error = parse_range_options(argv, false, options);
+            if (!error.empty()) return error;
+            return zrange_generic(argv, db, argv[2], argv[3], options);
+        }
         else{
-            std::string response = "-ERR wrong number of arguments for zcard command\r\n";
+            std::string response = "-ERR wrong number of arguments for zrangebyscore command\r\n";
             return response;
         }
     }
 
-std::string zscore_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets){
-        if (items == 2){
-            std::string response = "$-1\r\n";
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            std::string key = parsebulkString(items, client_fd, read_buffer);
+// ZREVRANGEBYSCORE key max min [WITHSCORES] [LIMIT offset count]
+std::string zrevrangebyscore_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 4){
+            RangeOptions options;
+            options.byScore = true;
+            options.rev = true;
+            std::string error = parse_range_options(argv, false, options);
+            if (!error.empty()) return error;
+            return zrange_generic(argv, db, argv[2], argv[3], options);
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zrevrangebyscore command\r\n";
+            return response;
+        }
+    }
 
-            SkipList& sl = sets[listName];
+// ZRANGEBYLEX key min max [LIMIT offset count]
+std::string zrangebylex_command(const Argv& argv, Keyspace& db){
+        if (argv.size() >= 4){
+            RangeOptions options;
+            options.byLex = true;
+            std::string error = parse_range_options(argv, false, options);
+            if (!error.empty()) return error;
+            return zrange_generic(argv, db, argv[2], argv[3], options);
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zrangebylex command\r\n";
+            return response;
+        }
+    }
 
-            Node* prev = sl.head;
-            for (Node* n = sl.head->forward[0]; n != nullptr; n = n->forward[0]) {
-                if (n->key == key) {
-                    std::ostringstream oss;
-                    oss << std::setprecision(17) << n->score;
-                    std::string preciseScore = oss.str();
-                    std::cout << preciseScore << std::endl;
-                    response = "$"+ std::to_string(preciseScore.size())+ "\r\n" + preciseScore + "\r\n";
-                }
-            }
+std::string zcount_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 4){
+            Bound min, max;
+            if (!parse_score_bound(argv[2], min) || !parse_score_bound(argv[3], max)) return NOT_FLOAT_RANGE;
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found) return ":0\r\n";
+            size_t lo, hi;
+            score_window(*found, min, max, lo, hi);
+            return ":" + std::to_string(hi - lo) + "\r\n";
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zcount command\r\n";
             return response;
         }
+    }
+
+std::string zlexcount_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 4){
+            Bound min, max;
+            if (!parse_lex_bound(argv[2], min) || !parse_lex_bound(argv[3], max)) return NOT_LEX_RANGE;
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found) return ":0\r\n";
+            size_t lo, hi;
+            lex_window(*found, min, max, lo, hi);
+            return ":" + std::to_string(hi - lo) + "\r\n";
+        }
         else{
-            std::string response = "-ERR wrong number of arguments for zscore command\r\n";
+            std::string response = "-ERR wrong number of arguments for zlexcount command\r\n";
             return response;
         }
     }
 
-std::string zrem_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, SkipList>& sets){
-        if (items == 2){
-            std::string response = ":1\r\n";
-            std::string listName = parsebulkString(items, client_fd, read_buffer);
-            std::string key = parsebulkString(items, client_fd, read_buffer);
+// Ranks [lo, hi) unlinked in one splice, the key goes with its last member
+static std::string remove_window(Keyspace& db, std::string_view key, ZSet& zs, size_t lo, size_t hi){
+    if (hi > lo) {
+        zs.erase_ranks(lo, hi - 1);
+        db.mark_dirty();
+    }
+    if (zs.size() == 0) db.erase(key); // empty sorted sets don't exist
+    return ":" + std::to_string(hi - lo) + "\r\n";
+}
 
-            SkipList& sl = sets[listName];
-            std::cout << sl.head->forward[0]->key << std::endl;
-            std::vector<Node*> update(sl.maxLevel + 1, nullptr);
-            Node* curr = sl.head;
-            for (int i = sl.currentLevel; i >= 0; i--) {
-                Node* node = curr;
-                while (node->forward[i] != nullptr && node->forward[i]->key != key) {
-                    node = node->forward[i];
-                }
-                std::cout << "update" << std::to_string(i) << " is " << node->key << std::endl;
-                update[i] = node;
-            }
+std::string zremrangebyscore_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 4){
+            Bound min, max;
+            if (!parse_score_bound(argv[2], min) || !parse_score_bound(argv[3], max)) return NOT_FLOAT_RANGE;
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found) return ":0\r\n";
+            size_t lo, hi;
+            score_window(*found, min, max, lo, hi);
+            return remove_window(db, argv[1], *found, lo, hi);
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zremrangebyscore command\r\n";
+            return response;
+        }
+    }
 
-            Node* target = update[0]->forward[0];
-            if (target == nullptr || target->key != key) {
-                response = ":0\r\n";
-                return response;
-            }
+std::string zremrangebyrank_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 4){
+            int64_t start, stop;
+            if (!parse_int64(argv[2], start) || !parse_int64(argv[3], stop)) return NOT_INTEGER;
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found) return ":0\r\n";
+            size_t lo, hi;
+            if (!index_window(start, stop, found->size(), lo, hi)) return ":0\r\n";
+            return remove_window(db, argv[1], *found, lo, hi);
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zremrangebyrank command\r\n";
+            return response;
+        }
+    }
 
-            for (int i = 0; i <= sl.currentLevel; i++) {
-                if (update[i]->forward[i] != target) break;
-                update[i]->forward[i] = target->forward[i];
-            }
+std::string zcard_command(const Argv& argv, Keyspace& db){
+        if(argv.size() == 2){
+            bool wrongType;
+            ZSet* zs = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
 
-            delete target;
-            sl.size-=1;
-            while (sl.currentLevel > 0 && sl.head->forward[sl.currentLevel] == nullptr) {
-                sl.currentLevel--;
-            }
+            std::string response = ":"+std::to_string(zs ? zs->size() : 0)+"\r\n";
+            return response;
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zcard command\r\n";
+            return response;
+        }
+    }
 
+std::string zscore_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 3){
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            double score;
+            if (!found || !found->score(argv[2], score)) return "$-1\r\n";
+            return bulk(format_score(score));
+        }
+        else{
+            std::string response = "-ERR wrong number of arguments for zscore command\r\n";
             return response;
         }
+    }
+
+std::string zrem_command(const Argv& argv, Keyspace& db){
+        if (argv.size() == 3){
+            bool wrongType;
+            ZSet* found = db.lookup<ZSet>(argv[1], wrongType);
+            if (wrongType) return WRONGTYPE;
+            if (!found || !found->erase(argv[2])) return ":0\r\n";
+            db.mark_dirty();
+            if (found->size() == 0) db.erase(argv[1]); // empty sorted sets don't exist
+            return ":1\r\n";
+        }
         else{
             std::string response = "-ERR wrong number of arguments for zrem command\r\n";
             return response;
         }
-    }
\ No newline at end of file
+    }
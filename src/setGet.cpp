@@ -1,36 +1,47 @@
 #include "setGet.h"
-#include "bulkString.h"
 #include "lowerCMD.h"
+#include "replication.h"
 #include <iostream>
-#include "clear.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
-std::string set_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict){
-  if (items == 2 || items == 4){
+std::string set_command(ClientState& client, const Argv& argv, Keyspace& db){
+  using namespace std::chrono;
+  if (argv.size() >= 3){
     // read key
-    std::string key = parsebulkString(items, client_fd, read_buffer);
-    std::string val = parsebulkString(items, client_fd, read_buffer);
+    std::string_view key = argv[1];
+    std::string val(argv[2]);
     // sets to epoch if no expiry given
-    std::chrono::system_clock::time_point ttl;
-    // if expiry given
-    if (items == 2){
-      //check if ex after set key val
-      std::string ttlCaller = parsebulkString(items, client_fd, read_buffer);
-      ttlCaller = lowercase_command(ttlCaller);
-      if (ttlCaller != "ex" && ttlCaller != "px"){
-        std::string response = "-ERR incorrect arguments for set command\r\n";
-        return response;
+    system_clock::time_point ttl;
+    bool keepTTL = false, relative = false;
+    for (size_t i = 3; i < argv.size(); i++){
+      std::string option = lowercase_command(argv[i]);
+      bool expiry = option == "ex" || option == "px" || option == "exat" || option == "pxat";
+      if (ttl != system_clock::time_point{} || keepTTL || (expiry && i + 1 == argv.size())) return "-ERR syntax error\r\n";
+      if (option == "keepttl"){
+        keepTTL = true;
+        continue;
       }
-      // read ttl blkstring
-      int ttlINT = std::stoi(parsebulkString(items, client_fd, read_buffer));
-      if (ttlCaller == "ex"){
-         ttlINT *= 1000;
+      if (!expiry) return "-ERR syntax error\r\n";
+      // read ttl blkstring, in ms from now (EX, PX) or from the epoch (EXAT, PXAT)
+      int64_t amount;
+      milliseconds unit(option[0] == 'e' ? 1000 : 1);
+      relative = option.size() == 2;
+      system_clock::time_point from = relative ? system_clock::now() : system_clock::time_point{};
+      // system_clock counts nanoseconds, so deadlines past ~2262 don't fit
+      long long limit = duration_cast<milliseconds>(system_clock::time_point::max() - from).count() / unit.count();
+      if (!parse_int64(argv[++i], amount) || amount <= 0 || amount > limit){
+        return "-ERR invalid expire time in 'set' command\r\n";
       }
-      ttl = std::chrono::system_clock::now() + std::chrono::milliseconds(ttlINT);
+      ttl = time_point_cast<milliseconds>(from) + amount * unit;
     }
-    dict[key] = make_tuple(val, ttl);
+    if (keepTTL){
+      RedisObject* old = db.find(key);
+      if (old) ttl = old->expiry;
+    }
+    if (relative){
+      rewrite_command(client, {"SET", std::string(key), val, "PXAT",
+                               std::to_string(duration_cast<milliseconds>(ttl.time_since_epoch()).count())});
+    }
+    db.set_string(key, std::move(val), ttl);
     std::string response = "+OK\r\n";
     return response;
   }
@@ -40,34 +51,23 @@ std::string set_command(int& items, int client_fd, std::string& read_buffer, std
   }
 }
 
-std::string get_command(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict){
-  if (items == 1){
-    std::string key = parsebulkString(items, client_fd, read_buffer);
-    //tries to find val
-    auto tuple = dict.find(key);
-    // val found
-    if (tuple != dict.end()){
-      auto [val, ttl] = tuple->second;
-      // check if an expiry was given 
-      if (ttl != std::chrono::system_clock::time_point{}){
-        //time expired
-        if (ttl <= std::chrono::system_clock::now()) {
-          dict.erase(key);
-          std::string response = "$-1\r\n";
-          return response;
-        }
-      }
-      int valSize = val.length();
-      std::string response = "$"+ std::to_string(valSize) + "\r\n";
-      response += val;
-      response += "\r\n";
-      return response;
-    }
+std::string get_command(const Argv& argv, Keyspace& db){
+  if (argv.size() == 2){
+    bool wrongType;
+    //tries to find val, expired keys come back as missing
+    RedisObject* obj = db.lookup_string(argv[1], wrongType);
+    if (wrongType) return WRONGTYPE;
     // val not found
-    else{
+    if (!obj){
       std::string response = "$-1\r\n";
       return response;
     }
+    char buf[24];
+    std::string_view val = obj->string_bytes(buf); // int encoded values are formatted here, not stored
+    std::string response = "$"+ std::to_string(val.length()) + "\r\n";
+    response += val;
+    response += "\r\n";
+    return response;
   }
   else{
     std::string response = "-ERR wrong number of arguments for get command\r\n";
@@ -75,33 +75,35 @@ std::string get_command(int& items, int client_fd, std::string& read_buffer, std
   }
 }
 
-void set_propogated(int& items, int client_fd, std::string& read_buffer, std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict){
-  if (items == 2 || items == 4){
-    // read key
-    std::string key = parsebulkString(items, client_fd, read_buffer);
-    std::string val = parsebulkString(items, client_fd, read_buffer);
-    // sets to epoch if no expiry given
-    std::chrono::system_clock::time_point ttl;
-    // if expiry given
-    if (items == 2){
-      //check if ex after set key val
-      std::string ttlCaller = parsebulkString(items, client_fd, read_buffer);
-      ttlCaller = lowercase_command(ttlCaller);
-      if (ttlCaller != "ex" && ttlCaller != "px"){
-        clear_array(items, read_buffer);
-        return;
-      }
-      // read ttl blkstring
-      int ttlINT = std::stoi(parsebulkString(items, client_fd, read_buffer));
-      if (ttlCaller == "ex"){
-         ttlINT *= 1000;
-      }
-      ttl = std::chrono::system_clock::now() + std::chrono::milliseconds(ttlINT);
+std::string mget_command(const Argv& argv, Keyspace& db){
+  std::string response = "*" + std::to_string(argv.size() - 1) + "\r\n";
+  for (size_t i = 1; i < argv.size(); i++){
+    bool wrongType;
+    RedisObject* obj = db.lookup_string(argv[i], wrongType);
+    if (!obj){
+      response += "$-1\r\n";
+      continue;
     }
-    dict[key] = make_tuple(val, ttl);
+    char buf[24];
+    std::string_view val = obj->string_bytes(buf);
+    response += "$" + std::to_string(val.length()) + "\r\n";
+    response += val;
+    response += "\r\n";
   }
-  else{
-    std::string response = "-ERR wrong number of arguments for set command\r\n";
-    clear_array(items, read_buffer);
+  return response;
+}
+
+std::string append_command(const Argv& argv, Keyspace& db){
+  if (argv.size() != 3) return "-ERR wrong number of arguments for append command\r\n";
+  bool wrongType;
+  RedisObject* obj = db.lookup_string(argv[1], wrongType);
+  if (wrongType) return WRONGTYPE;
+  if (!obj){
+    db.set_string(argv[1], std::string(argv[2]));
+    return ":" + std::to_string(argv[2].size()) + "\r\n";
   }
-}
\ No newline at end of file
+  std::string& val = obj->raw_string(); // an int encoded value becomes bytes from here on
+  val.append(argv[2]);
+  db.mark_dirty();
+  return ":" + std::to_string(val.length()) + "\r\n";
+}
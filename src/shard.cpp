@@ -0,0 +1,195 @@
+#include "shard.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+constexpr uint32_t TASK_PENDING = 0;
+constexpr uint32_t TASK_DONE = 1;     // a call finished (or a barrier parked its shard)
+constexpr uint32_t TASK_RELEASED = 2; // the coordinator is done with a parked shard
+
+constexpr int SPIN_ROUNDS = 256; // idle polls before a shard (or a waiting sender) goes to sleep
+
+} // namespace
+
+thread_local int ShardEngine::currentShard = -1;
+
+ShardEngine::ShardEngine(size_t count) : barriers(count), parked() {
+  for (size_t i = 0; i < count; i++) shards.push_back(std::make_unique<Shard>());
+}
+
+void ShardEngine::start(){
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t s = 0; s < shards.size(); s++){
+    shards[s]->thread = std::thread([this, s, cores]{
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(s % cores, &cpus);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      run_shard(s);
+    });
+    shards[s]->thread.detach();
+  }
+  std::cout << "running " << shards.size() << " shards\n";
+}
+
+int ShardEngine::single_owner(uint64_t stripes) const {
+  int owner = -1;
+  for (size_t i = 0; stripes; i++, stripes >>= 1){
+    if (!(stripes & 1)) continue;
+    int s = owner_of_stripe(i);
+    if (owner != -1 && owner != s) return -1;
+    owner = s;
+  }
+  return owner;
+}
+
+ShardEngine::Ring& ShardEngine::ring_to(size_t s){
+  // This thread's ring to every shard, made the first time it sends to one and
+  // unregistered when the thread exits (connection threads come and go)
+  struct Producer {
+    ShardEngine* engine = nullptr;
+    std::vector<std::shared_ptr<Ring>> rings;
+    ~Producer(){
+      if (!engine) return;
+      for (size_t s = 0; s < rings.size(); s++){
+        if (!rings[s]) continue;
+        Shard& shard = *engine->shards[s];
+        std::lock_guard<std::mutex> lock(shard.producersMutex);
+        std::erase(shard.producers, rings[s]);
+        shard.producersVersion.fetch_add(1, std::memory_order_release);
+      }
+    }
+  };
+  thread_local Producer producer;
+  if (producer.engine != this){
+    producer.engine = this;
+    producer.rings.assign(shards.size(), nullptr);
+  }
+  if (!producer.rings[s]){
+    producer.rings[s] = std::make_shared<Ring>();
+    Shard& shard = *shards[s];
+    std::lock_guard<std::mutex> lock(shard.producersMutex);
+    shard.producers.push_back(producer.rings[s]);
+    shard.producersVersion.fetch_add(1, std::memory_order_release);
+  }
+  return *producer.rings[s];
+}
+
+void ShardEngine::submit(size_t s, Task& task){
+  Ring& ring = ring_to(s);
+  while (!ring.push(&task)) std::this_thread::yield();
+  // Pairs with the fence in run_shard: either the shard sees the task before it
+  // sleeps, or we see it sleeping and ring the doorbell
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  Shard& shard = *shards[s];
+  if (shard.sleeping.load(std::memory_order_relaxed)){
+    shard.doorbell.fetch_add(1, std::memory_order_relaxed);
+    shard.doorbell.notify_one();
+  }
+}
+
+void ShardEngine::wait(Task& task){
+  for (int i = 0; i < SPIN_ROUNDS; i++){
+    if (task.state.load(std::memory_order_acquire) != TASK_PENDING) break;
+    std::this_thread::yield();
+  }
+  task.state.wait(TASK_PENDING, std::memory_order_acquire);
+  if (task.error) std::rethrow_exception(task.error);
+}
+
+bool ShardEngine::acquire(uint64_t stripes){
+  std::vector<bool> involved(shards.size(), false);
+  for (size_t i = 0; i < 64; i++){
+    if (stripes >> i & 1) involved[owner_of_stripe(i)] = true;
+  }
+  if (currentShard >= 0){
+    for (size_t s = 0; s < shards.size(); s++){
+      if (involved[s] && static_cast<int>(s) != currentShard){
+        throw std::logic_error("a shard thread can't coordinate other shards");
+      }
+    }
+    return false; // its own stripes, nobody else touches them
+  }
+
+  coordinator.lock();
+  parked.clear();
+  for (size_t s = 0; s < shards.size(); s++){ // scatter
+    if (!involved[s]) continue;
+    barriers[s].state.store(TASK_PENDING, std::memory_order_relaxed);
+    submit(s, barriers[s]);
+    parked.push_back(s);
+  }
+  for (size_t s : parked) wait(barriers[s]); // gather
+  return true;
+}
+
+void ShardEngine::release(){
+  for (size_t s : parked){
+    barriers[s].state.store(TASK_RELEASED, std::memory_order_release);
+    barriers[s].state.notify_one();
+  }
+  parked.clear();
+  coordinator.unlock();
+}
+
+void ShardEngine::run_shard(size_t s){
+  currentShard = static_cast<int>(s);
+  Shard& shard = *shards[s];
+  std::vector<std::shared_ptr<Ring>> rings;
+  uint64_t version = ~uint64_t(0);
+  int idle = 0;
+
+  while (true){
+    uint64_t current = shard.producersVersion.load(std::memory_order_acquire);
+    if (current != version){
+      std::lock_guard<std::mutex> lock(shard.producersMutex);
+      rings = shard.producers;
+      version = shard.producersVersion.load(std::memory_order_relaxed);
+    }
+
+    bool worked = false;
+    for (auto& ring : rings){
+      Task* task;
+      for (int n = 0; n < 16 && ring->pop(task); n++){ // a few per ring so one busy sender can't starve the rest
+        worked = true;
+        if (!task->call){
+          // Barrier: hand our stripes to the coordinator until it is done with them
+          task->state.store(TASK_DONE, std::memory_order_release);
+          task->state.notify_one();
+          task->state.wait(TASK_DONE, std::memory_order_acquire);
+          continue;
+        }
+        try {
+          task->call(task->arg);
+        } catch (...) {
+          task->error = std::current_exception();
+        }
+        task->state.store(TASK_DONE, std::memory_order_release);
+        task->state.notify_one();
+      }
+    }
+    if (worked){
+      idle = 0;
+      continue;
+    }
+    if (++idle < SPIN_ROUNDS){
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Nothing to do for a while: sleep until a sender rings
+    uint32_t bell = shard.doorbell.load(std::memory_order_relaxed);
+    shard.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool pending = shard.producersVersion.load(std::memory_order_relaxed) != version;
+    for (auto& ring : rings) pending = pending || !ring->empty();
+    if (!pending) shard.doorbell.wait(bell, std::memory_order_relaxed);
+    shard.sleeping.store(false, std::memory_order_relaxed);
+    idle = 0;
+  }
+}
@@ -0,0 +1,178 @@
+#include "slab.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+
+namespace {
+
+constexpr size_t RANGE_BYTES = size_t(64) << 30; // address space reserved for slabs, touched only as used
+constexpr size_t CACHE_SIZE = 64;                // per thread and class
+constexpr size_t BATCH = CACHE_SIZE / 2;         // moved between a thread cache and its class at once
+
+constexpr std::array<uint32_t, SLAB_CLASSES> CLASS_SIZES = {
+  16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+
+// Class index by (size + 15) / 16
+constexpr std::array<uint8_t, SLAB_MAX_SIZE / 16 + 1> build_class_index(){
+  std::array<uint8_t, SLAB_MAX_SIZE / 16 + 1> index{};
+  size_t c = 0;
+  for (size_t units = 0; units < index.size(); units++){
+    while (CLASS_SIZES[c] < units * 16) c++;
+    index[units] = c;
+  }
+  return index;
+}
+constexpr auto CLASS_INDEX = build_class_index();
+
+struct FreeObject { FreeObject* next; };
+
+struct alignas(64) SizeClass {
+  std::mutex lock;
+  FreeObject* free = nullptr; // freed objects, plus the rest of the slab being carved
+  size_t slabs = 0;
+  size_t out = 0; // objects not on the free list: live, or sitting in a thread cache
+};
+
+struct Range {
+  char* base = nullptr;
+  std::atomic<size_t> next{0};       // bump pointer over slabs
+  uint8_t* slabClass = nullptr;      // class of each slab, indexed by offset / SLAB_BYTES
+  SizeClass classes[SLAB_CLASSES];
+
+  Range(){
+    void* p = mmap(nullptr, RANGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void* meta = mmap(nullptr, RANGE_BYTES / SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED || meta == MAP_FAILED) return; // slab_alloc always says no, everything goes to malloc
+    base = static_cast<char*>(p);
+    slabClass = static_cast<uint8_t*>(meta);
+  }
+
+  bool owns(const void* p) const {
+    auto c = static_cast<const char*>(p);
+    return base && c >= base && c < base + RANGE_BYTES;
+  }
+};
+
+// Constructed on first use, before main when static constructors allocate, and never destroyed
+Range& range(){
+  static Range* r = new (mmap(nullptr, sizeof(Range), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) Range();
+  return *r;
+}
+
+// Carves a new slab into the class's free list, class lock held
+bool grow(Range& r, size_t c){
+  size_t offset = r.next.fetch_add(SLAB_BYTES, std::memory_order_relaxed);
+  if (offset + SLAB_BYTES > RANGE_BYTES) return false;
+  r.slabClass[offset / SLAB_BYTES] = c;
+  SizeClass& cls = r.classes[c];
+  size_t size = CLASS_SIZES[c];
+  char* slab = r.base + offset;
+  for (size_t at = SLAB_BYTES / size * size; at >= size; at -= size){
+    auto obj = reinterpret_cast<FreeObject*>(slab + at - size);
+    obj->next = cls.free;
+    cls.free = obj;
+  }
+  cls.slabs++;
+  return true;
+}
+
+struct ThreadCache {
+  void* objects[SLAB_CLASSES][CACHE_SIZE];
+  uint32_t count[SLAB_CLASSES] = {};
+
+  ~ThreadCache(); // hands everything back, threads come and go with connections
+};
+
+thread_local bool cacheGone = false; // set once this thread's cache was destroyed, frees go straight to the class then
+
+ThreadCache& cache(){
+  thread_local ThreadCache c;
+  return c;
+}
+
+void release_batch(Range& r, size_t c, void** objects, size_t n){
+  SizeClass& cls = r.classes[c];
+  std::lock_guard<std::mutex> guard(cls.lock);
+  for (size_t i = 0; i < n; i++){
+    auto obj = static_cast<FreeObject*>(objects[i]);
+    obj->next = cls.free;
+    cls.free = obj;
+  }
+  cls.out -= n;
+}
+
+ThreadCache::~ThreadCache(){
+  Range& r = range();
+  for (size_t c = 0; c < SLAB_CLASSES; c++) release_batch(r, c, objects[c], count[c]);
+  cacheGone = true;
+}
+
+} // namespace
+
+void* slab_alloc(size_t size){
+  if (size > SLAB_MAX_SIZE) return nullptr;
+  Range& r = range();
+  if (!r.base) return nullptr;
+  size_t c = CLASS_INDEX[(size + 15) / 16];
+  SizeClass& cls = r.classes[c];
+
+  if (!cacheGone){
+    ThreadCache& tc = cache();
+    if (tc.count[c] == 0){
+      std::lock_guard<std::mutex> guard(cls.lock);
+      while (tc.count[c] < BATCH){
+        if (!cls.free && !grow(r, c)) break;
+        tc.objects[c][tc.count[c]++] = cls.free;
+        cls.free = cls.free->next;
+        cls.out++;
+      }
+    }
+    if (tc.count[c]) return tc.objects[c][--tc.count[c]];
+    return nullptr; // range exhausted
+  }
+  std::lock_guard<std::mutex> guard(cls.lock);
+  if (!cls.free && !grow(r, c)) return nullptr;
+  FreeObject* obj = cls.free;
+  cls.free = obj->next;
+  cls.out++;
+  return obj;
+}
+
+bool slab_free(void* p){
+  Range& r = range();
+  if (!r.owns(p)) return false;
+  size_t c = r.slabClass[(static_cast<char*>(p) - r.base) / SLAB_BYTES];
+  if (cacheGone){
+    release_batch(r, c, &p, 1);
+    return true;
+  }
+  ThreadCache& tc = cache();
+  if (tc.count[c] == CACHE_SIZE){
+    tc.count[c] -= BATCH;
+    release_batch(r, c, tc.objects[c] + tc.count[c], BATCH);
+  }
+  tc.objects[c][tc.count[c]++] = p;
+  return true;
+}
+
+size_t slab_usable_size(const void* p){
+  Range& r = range();
+  if (!r.owns(p)) return 0;
+  return CLASS_SIZES[r.slabClass[(static_cast<const char*>(p) - r.base) / SLAB_BYTES]];
+}
+
+SlabStats slab_stats(){
+  Range& r = range();
+  SlabStats stats{};
+  for (size_t c = 0; c < SLAB_CLASSES; c++){
+    SizeClass& cls = r.classes[c];
+    std::lock_guard<std::mutex> guard(cls.lock);
+    stats.classes[c] = {CLASS_SIZES[c], cls.slabs, cls.out};
+    stats.reserved += cls.slabs * SLAB_BYTES;
+    stats.used += stats.classes[c].used * CLASS_SIZES[c];
+  }
+  return stats;
+}
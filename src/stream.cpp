@@ -1,292 +1,262 @@
 #include "stream.h"
-#include "bulkString.h"
+#include "keyspace.h"
 #include "lowerCMD.h"
-#include <iostream>
+#include "replication.h"
+#include <charconv>
 #include <chrono>
-#include "clear.h"
-#include <sys/types.h>
 #include <thread>
-#include <sys/socket.h>
-#include <unistd.h>
 #include <cstdint>
 
-std::string xadd_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict,
-    std::map<std::string, Stream>& sDict){
-    
-        if (items >= 4 && (items % 2 == 0)){
-            std::string key = parsebulkString(items, client_fd, read_buffer);
-            //tries to find val dictionary
-            auto tuple = dict.find(key);
-            // val found... error
-            if (tuple != dict.end()){
-                std::string response = "-ERR key already in use\r\n";
-                return response;
-            }   
+static const std::string INVALID_ID = "-ERR Invalid stream ID specified as stream command argument\r\n";
+static const std::string NOT_GREATER = "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n";
+static const std::string SYNTAX_ERROR = "-ERR syntax error\r\n";
 
-            long long lastMili = 0;
-            long long lastSequence = 0;
-            // val found inside stream dictionary
-            if (sDict.find(key) != sDict.end()){
-                std::string lastKey = sDict[key].lastID;
-                size_t div = lastKey.find("-");
-                lastMili = std::stoll(lastKey.substr(0,div));
-                lastSequence = std::stoll(lastKey.substr(div+1)); // Save the last key for comparison purposes
-            }
+static bool parse_u64(std::string_view text, uint64_t& value){
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && ec == std::errc() && end == text.data() + text.size();
+}
+
+bool parse_stream_id(std::string_view text, StreamID& id, uint64_t missingSeq){
+    size_t div = text.find('-');
+    if (div == std::string_view::npos) {
+        id.seq = missingSeq;
+        return parse_u64(text, id.ms);
+    }
+    return parse_u64(text.substr(0, div), id.ms) && parse_u64(text.substr(div + 1), id.seq);
+}
+
+static std::string bulk(std::string_view s){
+    std::string response = "$" + std::to_string(s.size()) + "\r\n";
+    response.append(s);
+    response += "\r\n";
+    return response;
+}
+
+static void append_entry(std::string& response, const StreamEntry& entry){
+    response += "*2\r\n";
+    response += bulk(entry.id.str());
+    response += "*" + std::to_string(entry.fields.size() * 2) + "\r\n";
+    for (const auto& [field, value] : entry.fields) {
+        response += bulk(field);
+        response += bulk(value);
+    }
+}
+
+std::string xadd_command(ClientState& client, const Argv& argv, Keyspace& db){
 
-            std::string ID = parsebulkString(items, client_fd, read_buffer);
-            if (ID == "*"){
+        if (argv.size() >= 5 && (argv.size() % 2 == 1)){
+            bool wrongType;
+            Stream* stream = db.lookup<Stream>(argv[1], wrongType);
+            // key holds something else... error
+            if (wrongType) return WRONGTYPE;
+
+            StreamID last = stream ? stream->last_id() : StreamID{};
+            StreamID id;
+            std::string_view given = argv[2];
+            if (given == "*"){
                 auto now = std::chrono::system_clock::now();
-                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                             now.time_since_epoch()
                         ).count();
-                ID = std::to_string(ms)+ "-0";
+                // The clock may not have moved past the last entry
+                if (ms > last.ms) id = StreamID{ms, 0};
+                else if (last.seq == UINT64_MAX) return NOT_GREATER;
+                else id = StreamID{last.ms, last.seq + 1};
             }
-            else{
-                int div = ID.find("-");
-                long long miliseconds = std::stoll(ID.substr(0,div));
-                std::string sequence = ID.substr(div+1);
-                if (sequence == "*"){
-                    if (miliseconds == 0){
-                        sequence = "1";
-                    }
-                    else if (miliseconds < lastMili){
-                        std::string response = "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n";
-                        return response;
-                    }
-                    else if (lastMili == miliseconds){
-                        sequence = std::to_string(lastSequence + 1);
-                    }
-                    else{
-                        sequence = "0";
-                    }
+            else if (given.size() > 2 && given.substr(given.size() - 2) == "-*"){
+                if (!parse_u64(given.substr(0, given.size() - 2), id.ms)) return INVALID_ID;
+                if (id.ms < last.ms) return NOT_GREATER;
+                if (id.ms == last.ms){
+                    if (last.seq == UINT64_MAX) return NOT_GREATER;
+                    id.seq = last.seq + 1;
                 }
                 else{
-                    int isequence = std::stoll(sequence);
-                    if( miliseconds == 0 && isequence == 0){
-                        std::string response = "-ERR The ID specified in XADD must be greater than 0-0\r\n";
-                        return response;
-                    }
-                    if (miliseconds < lastMili){
-                        std::string response = "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n";
-                        return response;
-                    }
-                    if ((miliseconds == lastMili) && (isequence < lastSequence)){
-                        std::string response = "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n";
-                        return response;
-                    }
-                    if ((miliseconds == lastMili) && (isequence == lastSequence)){
-                        std::string response = "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n";
-                        return response;
-                    }
-                    
-
+                    id.seq = id.ms == 0 ? 1 : 0;
                 }
-                ID =  std::to_string(miliseconds) + "-" + sequence;
             }
-            while (items > 0){
-                std::string field = parsebulkString(items, client_fd, read_buffer);
-                std::string val = parsebulkString(items, client_fd, read_buffer);
-                sDict[key].entries[ID].push_back({field,val});
+            else{
+                if (!parse_stream_id(given, id, 0)) return INVALID_ID;
+                if (id == StreamID{}){
+                    std::string response = "-ERR The ID specified in XADD must be greater than 0-0\r\n";
+                    return response;
+                }
+                if (id <= last) return NOT_GREATER;
             }
-            sDict[key].lastID = ID;
-            int idLen = ID.length();
-            std::string response = "$" + std::to_string(idLen) + "\r\n";
-            response += ID + "\r\n";
-            return response;
+            if (!stream) stream = db.lookup_or_create<Stream>(argv[1], wrongType);
+            stream->append(id, argv.data() + 3, (argv.size() - 3) / 2);
+            db.mark_dirty();
+            std::vector<std::string> propagated(argv.begin(), argv.end());
+            propagated[2] = id.str();
+            rewrite_command(client, std::move(propagated));
+            return bulk(id.str());
         }
         else{
-            std::cout << "given " << std::to_string(items) << " items" << std::endl;
             std::string response = "-ERR wrong number of arguments for xadd command\r\n";
             return response;
         }
 
 }
 
-std::string xrange_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, Stream>& sDict){
-        std::string response = "";
-        if (items == 3){
-            std::string key = parsebulkString(items, client_fd, read_buffer);
-            std::string start = parsebulkString(items, client_fd, read_buffer);
-            uint64_t startmili = 0;
-            uint64_t startSeq = 0;
-            int div = 0;
-            if( start != "-"){
-                div = start.find("-");
-                if (div == -1){
-                    startmili = std::stoll(start);
-                    startSeq = 0;
-                }
-                else{
-                    startmili = std::stoll(start.substr(0,div));
-                    startSeq = std::stoll(start.substr(div+1));
-                }
-            }
-            std::string end = parsebulkString(items, client_fd, read_buffer);
-            uint64_t endmili = 0;
-            uint64_t endSeq = 0;
-            if( end == "+"){
-                endmili = UINT64_MAX;
-                endSeq = UINT64_MAX;
-            }
-            else{
-                div = end.find("-");
-                if (div == -1){
-                    endmili = std::stoll(start);
-                    endSeq = UINT64_MAX;
-                }
-                else{
-                    endmili = std::stoll(end.substr(0,div));
-                    endSeq = std::stoll(end.substr(div+1));
-                }
-            }
-
-            int count = 0;
-            auto it = sDict.find(key);
-            if (it != sDict.end()) {
-                for (const auto& [id, fields] : it->second.entries) {
-                    int div = id.find("-");
-                    int miliID = std::stoi(id.substr(0,div));
-                    int seqID = std::stoi(id.substr(div+1));
-                    if ((miliID > startmili && miliID < endmili) || ((miliID == startmili || miliID == endmili) && ((seqID >= startSeq) && (seqID <= endSeq))) ){
-                        count+=1;
-                        response += "*2\r\n";
-                        response += "$" + std::to_string(id.length()) + "\r\n" + id + "\r\n";
-                        response += "*" + std::to_string(fields.size()*2) + "\r\n";
-                        for (const auto& [field, value] : fields) {
-                            response += "$" + std::to_string(field.length()) + "\r\n" + field + "\r\n";
-                            response += "$" + std::to_string(value.length()) + "\r\n" + value + "\r\n";
-                        }
-                    }
-                }
-                response = "*" + std::to_string(count) + "\r\n" + response;
-                return response;
-            }
-            else{
-                std::string response = "-ERR invalid keyname for xrange command\r\n";
-                return response;
-            }
-        }
-        else if (items == 1){
-            std::string key = parsebulkString(items, client_fd, read_buffer);
-            int count = 0;
-            auto it = sDict.find(key);
-            // if key found in stream dict
-            if (it != sDict.end()) {
-                for (const auto& [id, fields] : it->second.entries) {
-                    count+=1;
-                    response += "*2\r\n";
-                    response += "$" + std::to_string(id.length()) + "\r\n" + id + "\r\n";
-                    response += "*" + std::to_string(fields.size()) + "\r\n";
-                    for (const auto& [field, value] : fields) {
-                        response += "$" + std::to_string(field.length()) + "\r\n" + field + "\r\n";
-                        response += "$" + std::to_string(value.length()) + "\r\n" + value + "\r\n";
-                    }
-                }
-                response = "*" + std::to_string(count) + "\r\n" + response;
-                return response;
-            }
-            else{ // if key not found in stream dict
-                std::string response = "-ERR invalid keyname for xrange command\r\n";
-                return response;
-            }
+// A range bound: "-" and "+" are the ends, "(" excludes the ID, and a bare "<ms>"
+// covers the whole millisecond. False if malformed or past the end
+static bool parse_range_bound(std::string_view text, bool start, StreamID& id, std::string& error){
+    error = INVALID_ID;
+    if (text == "-"){
+        id = StreamID{};
+        return true;
+    }
+    if (text == "+"){
+        id = StreamID{UINT64_MAX, UINT64_MAX};
+        return true;
+    }
+    bool exclusive = !text.empty() && text[0] == '(';
+    if (exclusive) text.remove_prefix(1);
+    if (!parse_stream_id(text, id, start ? 0 : UINT64_MAX)) return false;
+    if (!exclusive) return true;
+    if (start){
+        if (id == StreamID{UINT64_MAX, UINT64_MAX}){
+            error = "-ERR invalid start ID for the interval\r\n";
+            return false;
         }
-        else {
-            std::string response = "-ERR wrong number of arguments for xrange command\r\n";
-            return response;
+        if (id.seq++ == UINT64_MAX) id.ms++;
+    }
+    else{
+        if (id == StreamID{}){
+            error = "-ERR invalid end ID for the interval\r\n";
+            return false;
         }
+        if (id.seq-- == 0) id.ms--;
+    }
+    return true;
 }
 
-std::string xread_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, Stream>& sDict){
-        if (items >= 3 && ( (items % 2) == 1)){
-            std::string firstWord = parsebulkString(items, client_fd, read_buffer);
-            firstWord = lowercase_command(firstWord);
-            bool infiniteTime = false;
-            uint64_t waitTime = 0;
-            if (firstWord == "block"){
-                std::string timeGiven = parsebulkString(items, client_fd, read_buffer);
-                uint64_t timeTemp = std::stoll(timeGiven);
-                
-                if (timeTemp == 0){
-                    infiniteTime = true;
-                }
-                else{
-                    waitTime = timeTemp;
-                }
-                parsebulkString(items,client_fd, read_buffer);
-            }
-            else if ( firstWord != "streams"){
-                std::string response = "-ERR wrong arguments for xread command\r\n";
-                return response;
-            }
+static std::string xrange_generic(const Argv& argv, Keyspace& db, bool rev){
+        if (argv.size() != 4 && argv.size() != 6) return SYNTAX_ERROR;
+        StreamID start, end;
+        std::string error;
+        if (!parse_range_bound(argv[rev ? 3 : 2], true, start, error)) return error;
+        if (!parse_range_bound(argv[rev ? 2 : 3], false, end, error)) return error;
+        size_t limit = SIZE_MAX;
+        if (argv.size() == 6){
+            if (lowercase_command(argv[4]) != "count") return SYNTAX_ERROR;
+            int64_t count;
+            if (!parse_int64(argv[5], count)) return "-ERR value is not an integer or out of range\r\n";
+            limit = count < 0 ? 0 : static_cast<size_t>(count);
+        }
 
-            std::vector<std::string> streams;
-            std::vector<std::string> ids;
-            int givenStreams = items / 2;
-            for (int i = 0; i < givenStreams; i++){
-                streams.push_back(parsebulkString(items, client_fd, read_buffer));
-            }
-            for (int i = 0; i < givenStreams; i++){
-                std::string givenID = parsebulkString(items, client_fd, read_buffer);
-                if (givenID == "$"){
-                    givenID = sDict[streams[i]].lastID;
-                }
-                ids.push_back(givenID);
-            }
-            
-            auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitTime); 
+        bool wrongType;
+        Stream* stream = db.lookup<Stream>(argv[1], wrongType);
+        if (wrongType) return WRONGTYPE;
+        if (!stream || start > end || limit == 0) return "*0\r\n";
 
-            std::string response = ""; 
-            do{
-                for (int i = 0; i < givenStreams; i++){
-                    std::string tempResponse = "";
-                    tempResponse += "*2\r\n";
-                    tempResponse += "$" + std::to_string(streams[i].length()) + "\r\n" + streams[i] + "\r\n";
+        std::string response;
+        size_t count = 0;
+        stream->walk(rev ? end : start, rev, [&](const StreamEntry& entry){
+            if (rev ? entry.id < start : entry.id > end) return false;
+            append_entry(response, entry);
+            return ++count < limit;
+        });
+        return "*" + std::to_string(count) + "\r\n" + response;
+}
 
-                    std::string entryID = ids[i];
-                    int div = entryID.find("-");
-                    long long startmili = std::stoi(entryID.substr(0,div));
-                    long long startSeq = std::stoi(entryID.substr(div+1));
+std::string xrange_command(const Argv& argv, Keyspace& db){
+        return xrange_generic(argv, db, false);
+}
 
-                    int count = 0;
-                    auto it = sDict.find(streams[i]);
-                    std::string innerArray = "";
-                    if (it != sDict.end()) {
-                        for (const auto& [id, fields] : it->second.entries) {
-                            div = id.find("-");
-                            long long miliID = std::stoi(id.substr(0,div));
-                            long long seqID = std::stoi(id.substr(div+1));
-                            if ( (miliID > startmili) || ( (miliID == startmili) && (seqID > startSeq) ) ){
-                                count+=1;
-                                innerArray += "*2\r\n";
-                                innerArray += "$" + std::to_string(id.length()) + "\r\n" + id + "\r\n";
-                                innerArray += "*" + std::to_string(fields.size()*2) + "\r\n";
-                                for (const auto& [field, value] : fields) {
-                                    innerArray += "$" + std::to_string(field.length()) + "\r\n" + field + "\r\n";
-                                    innerArray += "$" + std::to_string(value.length()) + "\r\n" + value + "\r\n";
-                                }
-                            }
-                        }
-                    }
-                    tempResponse += "*" + std::to_string(count) + "\r\n" + innerArray;
-                    if(innerArray != ""){
-                        response += tempResponse;
-                    }
-                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+std::string xrevrange_command(const Argv& argv, Keyspace& db){
+        return xrange_generic(argv, db, true);
+}
+
+std::string xread_command(const Argv& argv, Keyspace& db){
+        size_t next = 1;
+        bool block = false;
+        bool infiniteTime = false;
+        uint64_t waitTime = 0;
+        size_t limit = SIZE_MAX;
+        for (; next < argv.size(); next++){
+            std::string option = lowercase_command(argv[next]);
+            if (option == "streams") break;
+            if (next + 1 >= argv.size()) return SYNTAX_ERROR;
+            int64_t value;
+            if (!parse_int64(argv[++next], value)) return "-ERR value is not an integer or out of range\r\n";
+            if (option == "count"){
+                limit = value <= 0 ? SIZE_MAX : static_cast<size_t>(value);
             }
-            } while( response == "" && (std::chrono::steady_clock::now() < end || infiniteTime));
-            if (response == ""){
-                response = "*-1\r\n";
+            else if (option == "block"){
+                if (value < 0) return "-ERR timeout is negative\r\n";
+                block = true;
+                infiniteTime = value == 0;
+                waitTime = value;
             }
             else{
-                response = "*" + std::to_string(givenStreams) + "\r\n" + response;
+                return SYNTAX_ERROR;
             }
+        }
+        next++; // streams
+        if (next >= argv.size() || (argv.size() - next) % 2){
+            std::string response = "-ERR Unbalanced 'xread' list of streams: for each stream key an ID or '$' must be specified.\r\n";
             return response;
         }
+
+        std::vector<std::string> streams;
+        std::vector<StreamID> ids;
+        int givenStreams = (argv.size() - next) / 2;
+        for (int i = 0; i < givenStreams; i++){
+            streams.emplace_back(argv[next++]);
+        }
+        for (int i = 0; i < givenStreams; i++){
+            std::string_view givenID = argv[next++];
+            StreamID id;
+            if (givenID == "$"){
+                KeyLock lock(db); // no-op unless XREAD BLOCK, which locks per poll
+                lock.add(streams[i], false);
+                lock.lock();
+                bool wrongType;
+                Stream* stream = db.lookup<Stream>(streams[i], wrongType);
+                if (wrongType) return WRONGTYPE;
+                if (stream) id = stream->last_id();
+            }
+            else if (!parse_stream_id(givenID, id, 0)){
+                return INVALID_ID;
+            }
+            ids.push_back(id);
+        }
+
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitTime);
+
+        std::string response = "";
+        int answered = 0;
+        bool wait = block && !KeyLock::any_held(); // inside EXEC it answers right away, like Redis
+        while (true){
+            for (int i = 0; i < givenStreams; i++){
+                KeyLock lock(db);
+                lock.add(streams[i], false);
+                lock.lock();
+                bool wrongType;
+                Stream* stream = db.lookup<Stream>(streams[i], wrongType);
+                if (wrongType) return WRONGTYPE;
+                if (!stream || !(ids[i] < stream->last_id())) continue;
+                // Only entries after the given ID, found with one seek
+                std::string innerArray = "";
+                size_t count = 0;
+                StreamID after = ids[i].seq == UINT64_MAX ? StreamID{ids[i].ms + 1, 0} : StreamID{ids[i].ms, ids[i].seq + 1};
+                stream->walk(after, false, [&](const StreamEntry& entry){
+                    append_entry(innerArray, entry);
+                    return ++count < limit;
+                });
+                if (count == 0) continue;
+                response += "*2\r\n" + bulk(streams[i]);
+                response += "*" + std::to_string(count) + "\r\n" + innerArray;
+                answered++;
+            }
+            if (answered || !wait || (!infiniteTime && std::chrono::steady_clock::now() >= end)) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (answered == 0){
+            response = "*-1\r\n";
+        }
         else{
-            std::string response = "-ERR ewrong number of arguments for xread command\r\n";
-            return response;
+            response = "*" + std::to_string(answered) + "\r\n" + response;
         }
-}
\ No newline at end of file
+        return response;
+}
@@ -0,0 +1,113 @@
+#include "stream.h"
+#include <atomic>
+
+static std::atomic<size_t> nodeMaxBytes{4096};
+static std::atomic<size_t> nodeMaxEntries{100};
+
+void Stream::set_node_limits(size_t bytes, size_t entries){
+    nodeMaxBytes.store(bytes, std::memory_order_relaxed);
+    nodeMaxEntries.store(entries, std::memory_order_relaxed);
+}
+
+static void put_varint(std::vector<char>& out, uint64_t n){
+    while (n >= 0x80) {
+        out.push_back(static_cast<char>((n & 0x7f) | 0x80));
+        n >>= 7;
+    }
+    out.push_back(static_cast<char>(n));
+}
+
+static void put_string(std::vector<char>& out, std::string_view s){
+    put_varint(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+static uint64_t get_varint(const char*& p){
+    uint64_t n = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        unsigned char byte = *p++;
+        n |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return n;
+    }
+}
+
+static std::string_view get_string(const char*& p){
+    size_t length = get_varint(p);
+    std::string_view s(p, length);
+    p += length;
+    return s;
+}
+
+constexpr uint64_t SAME_FIELDS = 1;
+
+StreamNode::StreamNode(StreamID id, const std::string_view* fields, size_t n) : master(id), last(id), masterFields(n){
+    put_varint(data, n);
+    for (size_t i = 0; i < n; i++) put_string(data, fields[2 * i]);
+    entriesAt = data.size();
+    encode(id, fields, n, data);
+    count = 1;
+}
+
+void StreamNode::encode(StreamID id, const std::string_view* fields, size_t n, std::vector<char>& out) const {
+    bool same = n == masterFields;
+    const char* names = data.data();
+    get_varint(names);
+    for (size_t i = 0; same && i < n; i++) same = get_string(names) == fields[2 * i];
+
+    uint64_t msDelta = id.ms - master.ms;
+    put_varint(out, same ? SAME_FIELDS : 0);
+    put_varint(out, msDelta);
+    put_varint(out, msDelta ? id.seq : id.seq - master.seq);
+    if (same) {
+        for (size_t i = 0; i < n; i++) put_string(out, fields[2 * i + 1]);
+        return;
+    }
+    put_varint(out, n);
+    for (size_t i = 0; i < 2 * n; i++) put_string(out, fields[i]);
+}
+
+bool StreamNode::append(StreamID id, const std::string_view* fields, size_t n, size_t maxBytes, size_t maxEntries){
+    if (maxEntries && count >= maxEntries) return false;
+    thread_local std::vector<char> entry;
+    entry.clear();
+    encode(id, fields, n, entry);
+    if (maxBytes && data.size() + entry.size() > maxBytes) return false;
+    data.insert(data.end(), entry.begin(), entry.end());
+    count++;
+    last = id;
+    return true;
+}
+
+size_t StreamNode::read(size_t offset, StreamEntry& entry) const {
+    const char* p = data.data() + offset;
+    uint64_t flags = get_varint(p);
+    uint64_t msDelta = get_varint(p);
+    uint64_t seq = get_varint(p);
+    entry.id = StreamID{master.ms + msDelta, msDelta ? seq : master.seq + seq};
+    entry.fields.clear();
+    if (flags & SAME_FIELDS) {
+        const char* names = data.data();
+        get_varint(names);
+        for (uint32_t i = 0; i < masterFields; i++) {
+            std::string_view name = get_string(names);
+            entry.fields.emplace_back(name, get_string(p));
+        }
+    } else {
+        size_t n = get_varint(p);
+        for (size_t i = 0; i < n; i++) {
+            std::string_view name = get_string(p);
+            entry.fields.emplace_back(name, get_string(p));
+        }
+    }
+    return p - data.data();
+}
+
+void Stream::append(StreamID id, const std::string_view* fields, size_t n){
+    if (nodes.empty() || !nodes.back().append(id, fields, n, nodeMaxBytes.load(std::memory_order_relaxed),
+                                             nodeMaxEntries.load(std::memory_order_relaxed))) {
+        if (!nodes.empty()) nodes.back().seal();
+        nodes.emplace_back(id, fields, n);
+    }
+    length++;
+    lastID = id;
+}
@@ -1,17 +1,28 @@
 #include "subscribe.h"
-#include "bulkString.h"
+#include "client.h"
 
-#include <iostream>
+#include <mutex>
 #include <sys/types.h>    
 #include <sys/socket.h>
 #include <unistd.h> 
 
-std::string subscribe_command(int& items, int client_fd, std::string& read_buffer,
+static std::mutex channelsMutex; // channels is shared by every connection
+
+// Channels without subscribers are dropped, so the map only holds live ones
+static void drop_subscriber(std::map<std::string, std::set<int>>& channels, const std::string& channel, int client_fd){
+    auto it = channels.find(channel);
+    if (it == channels.end()) return;
+    it->second.erase(client_fd);
+    if (it->second.empty()) channels.erase(it);
+}
+
+std::string subscribe_command(const Argv& argv, int client_fd,
     std::map<std::string, std::set<int>>& channels, std::set<std::string>& subbed){
 
-        if (items == 1){
+        if (argv.size() == 2){
             
-            std::string key = parsebulkString(items, client_fd, read_buffer);
+            std::string key(argv[1]);
+            std::lock_guard<std::mutex> lock(channelsMutex);
             channels[key].insert(client_fd);
             subbed.insert(key);
 
@@ -19,16 +30,6 @@ std::string subscribe_command(int& items, int client_fd, std::string& read_buffe
             response += "$" + std::to_string(key.size()) + "\r\n";
             response += key + "\r\n";
             response += ":" + std::to_string(subbed.size()) + "\r\n";
-
-            std::cout << "client_fd: " << std::to_string(client_fd)<< std::endl;
-            for (const auto& [key, s] : channels) {
-                std::cout << key << ": { ";
-                for (const int val : s) {
-                    std::cout << val << " ";
-                }
-                std::cout << "}" << std::endl;
-            }
-
             return response;
 
         }
@@ -38,12 +39,15 @@ std::string subscribe_command(int& items, int client_fd, std::string& read_buffe
         }
 }
 
-std::string unsubscribe_command(int& items, int client_fd, std::string& read_buffer,
+std::string unsubscribe_command(const Argv& argv, int client_fd,
     std::map<std::string, std::set<int>>& channels, std::set<std::string>& subbed){
-        if (items == 1){
+        if (argv.size() == 2){
             
-            std::string key = parsebulkString(items, client_fd, read_buffer);
-            channels[key].erase(client_fd);
+            std::string key(argv[1]);
+            {
+                std::lock_guard<std::mutex> lock(channelsMutex);
+                drop_subscriber(channels, key, client_fd);
+            }
             subbed.erase(key);
 
             std::string response = "*3\r\n$11\r\nunsubscribe\r\n";
@@ -59,34 +63,44 @@ std::string unsubscribe_command(int& items, int client_fd, std::string& read_buf
         }
     }
 
-std::string publish_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::set<int>>& channels){
-        if (items == 2){
-            for (const auto& [key, s] : channels) {
-                std::cout << key << ": { ";
-                for (const int val : s) {
-                    std::cout << val << " ";
-                }
-                std::cout << "}" << std::endl;
+std::string publish_command(const Argv& argv,
+    std::map<std::string, std::set<int>>& channels, const OutputLimit& limit){
+        if (argv.size() == 3){
+            std::string channel(argv[1]);
+            std::string_view message = argv[2];
+            std::set<int> subscribers;
+            {
+                std::lock_guard<std::mutex> lock(channelsMutex); // push_message takes the push queue lock, never hold both
+                auto it = channels.find(channel);
+                if (it == channels.end()) return ":0\r\n";
+                subscribers = it->second;
             }
-            std::string channel = parsebulkString(items, client_fd, read_buffer);
-            std::string message = parsebulkString(items, client_fd, read_buffer);
 
-            for (int client: channels[channel]){
-                std::string clientMessage = "*3\r\n";
-                clientMessage += "$7\r\nmessage\r\n";
-                clientMessage += "$" + std::to_string(channel.size()) + "\r\n";
-                clientMessage += channel + "\r\n";
-                clientMessage += "$" + std::to_string(message.size()) + "\r\n";
-                clientMessage += message + "\r\n";
-                send(client, clientMessage.c_str(), clientMessage.size(), 0);
+            std::string clientMessage = "*3\r\n";
+            clientMessage += "$7\r\nmessage\r\n";
+            clientMessage += "$" + std::to_string(channel.size()) + "\r\n";
+            clientMessage += channel + "\r\n";
+            clientMessage += "$" + std::to_string(message.size()) + "\r\n";
+            clientMessage.append(message);
+            clientMessage += "\r\n";
+            // Goes through each subscriber's own output buffer, a slow one can't stall this connection
+            for (int client: subscribers){
+                push_message(client, clientMessage, limit);
             }
 
-            std::string response = ":" + std::to_string(channels[channel].size()) + "\r\n";
+            std::string response = ":" + std::to_string(subscribers.size()) + "\r\n";
             return response;
         }
         else{
             std::string response = "-ERR wrong number of arguments for publish command\r\n";
             return response;
         }
-    }
\ No newline at end of file
+    }
+
+void remove_subscriber(int client_fd,
+    std::map<std::string, std::set<int>>& channels, const std::set<std::string>& subbed){
+        std::lock_guard<std::mutex> lock(channelsMutex);
+        for (const std::string& channel : subbed){
+            drop_subscriber(channels, channel, client_fd);
+        }
+    }
@@ -1,48 +1,40 @@
 #include "type.h"
-#include "bulkString.h"
 #include "lowerCMD.h"
 #include <iostream>
-#include "clear.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
 
-std::string type_command(int& items, int client_fd, std::string& read_buffer, 
-    std::map<std::string, std::tuple<std::string,std::chrono::system_clock::time_point>>& dict,
-    std::map<std::string, Stream>& sDict){
-    if (items == 1){
-        std::string key = parsebulkString(items, client_fd, read_buffer);
-        //tries to find val
-        auto tuple = dict.find(key);
-        // val found
-        if (tuple != dict.end()){
-            auto [val, ttl] = tuple->second;
-            // check if an expiry was given 
-            if (ttl != std::chrono::system_clock::time_point{}){
-                //time expired
-                if (ttl <= std::chrono::system_clock::now()) {
-                    dict.erase(key);
-                    std::string response = "+none\r\n";
-                    return response;
-                }
-            }
-            int valSize = val.length();
-            std::string response = "+string\r\n";
-            return response;
-        }
-        // val not found
-        else if (sDict.find(key) != sDict.end()){
-            std::string response = "+stream\r\n";
-            return response;
-        }
-        else{
+std::string type_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 2){
+        // one lookup answers for every type, expired keys come back as missing
+        RedisObject* obj = db.find(argv[1]);
+        if (!obj){
             std::string response = "+none\r\n";
             return response;
         }
+        std::string response = "+" + std::string(type_name(obj->type)) + "\r\n";
+        return response;
     }
     else{
         std::string response = "-ERR wrong number of arguments for type command\r\n";
         return response;
     }
-}
\ No newline at end of file
+}
+
+// OBJECT ENCODING key, the only subcommand so far
+std::string object_command(const Argv& argv, Keyspace& db){
+    if (argv.size() == 3){
+        if (lowercase_command(argv[1]) != "encoding"){
+            std::string response = "-ERR unknown subcommand '" + std::string(argv[1]) + "'\r\n";
+            return response;
+        }
+        RedisObject* obj = db.find(argv[2]);
+        if (!obj) return "$-1\r\n";
+        std::string encoding = encoding_name(*obj);
+        std::string response = "$" + std::to_string(encoding.size()) + "\r\n" + encoding + "\r\n";
+        return response;
+    }
+    else{
+        std::string response = "-ERR wrong number of arguments for object command\r\n";
+        return response;
+    }
+}
@@ -0,0 +1,668 @@
+#include "uringServer.h"
+#include "blocking.h"
+
+#include <iostream>
+
+#if __has_include(<linux/io_uring.h>)
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const unsigned RING_ENTRIES = 4096;
+const unsigned BUF_COUNT = 1024; // provided receive buffers per reactor, must be a power of 2
+const unsigned BUF_SIZE = 4096;
+const size_t IOV_PER_SEND = 1024; // IOV_MAX, iovecs in one sendmsg
+const uint16_t BUF_GROUP = 0;
+
+enum Op : uint64_t { OP_ACCEPT = 1, OP_RECV, OP_SEND, OP_WAKE, OP_TIMER, OP_TIMER_REMOVE };
+
+// user_data layout: op in the top byte, connection generation, then the fd
+uint64_t pack(Op op, uint32_t gen, int fd){
+  return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(gen & 0xFFFFFF) << 32) | static_cast<uint32_t>(fd);
+}
+Op op_of(uint64_t ud){ return static_cast<Op>(ud >> 56); }
+uint32_t gen_of(uint64_t ud){ return (ud >> 32) & 0xFFFFFF; }
+int fd_of(uint64_t ud){ return static_cast<int>(ud & 0xFFFFFFFF); }
+
+// Just enough of liburing to drive one ring from one thread
+struct Ring {
+  int fd = -1;
+  io_uring_params params{};
+
+  void* sqPtr = nullptr;
+  size_t sqSize = 0;
+  void* cqPtr = nullptr;
+  size_t cqSize = 0;
+  io_uring_sqe* sqes = nullptr;
+  size_t sqesSize = 0;
+
+  unsigned* sqHead = nullptr;
+  unsigned* sqTail = nullptr;
+  unsigned sqMask = 0;
+  unsigned sqLocalTail = 0;
+  unsigned sqSubmitted = 0;
+
+  unsigned* cqHead = nullptr;
+  unsigned* cqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  ~Ring(){
+    if (sqes) munmap(sqes, sqesSize);
+    if (cqPtr && cqPtr != sqPtr) munmap(cqPtr, cqSize);
+    if (sqPtr) munmap(sqPtr, sqSize);
+    if (fd >= 0) close(fd);
+  }
+
+  // Returns -errno on failure
+  int init(unsigned entries, unsigned flags){
+    params.flags = flags;
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return -errno;
+
+    sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP){
+      sqSize = cqSize = std::max(sqSize, cqSize);
+    }
+    sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqPtr == MAP_FAILED){ sqPtr = nullptr; return -errno; }
+    if (params.features & IORING_FEAT_SINGLE_MMAP){
+      cqPtr = sqPtr;
+    } else {
+      cqPtr = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cqPtr == MAP_FAILED){ cqPtr = nullptr; return -errno; }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (s == MAP_FAILED) return -errno;
+    sqes = static_cast<io_uring_sqe*>(s);
+
+    char* sq = static_cast<char*>(sqPtr);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    unsigned* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) array[i] = i; // sqe i always lives in slot i
+    sqLocalTail = *sqTail;
+    sqSubmitted = sqLocalTail;
+
+    char* cq = static_cast<char*>(cqPtr);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return 0;
+  }
+
+  int enter(unsigned toSubmit, unsigned waitNr){
+    unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret = syscall(__NR_io_uring_enter, fd, toSubmit, waitNr, flags, nullptr, 0);
+    return ret < 0 ? -errno : ret;
+  }
+
+  // Publishes every prepared sqe and makes one io_uring_enter for all of them
+  int submit(unsigned waitNr = 0){
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail - sqSubmitted;
+    sqSubmitted = sqLocalTail;
+    if (toSubmit == 0 && waitNr == 0) return 0;
+    int ret;
+    do { ret = enter(toSubmit, waitNr); } while (ret == -EINTR);
+    return ret;
+  }
+
+  io_uring_sqe* get_sqe(){
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= params.sq_entries){
+      submit();
+      head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+      if (sqLocalTail - head >= params.sq_entries) return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqLocalTail++;
+    return sqe;
+  }
+
+  template <typename F>
+  void for_each_cqe(F f){
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail){
+      f(cqes[head & cqMask]);
+      head++;
+      // Hand slots back as we go, the handler may queue enough new work to need them
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+      tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    }
+  }
+};
+
+// Kernel picks one of these for every multishot recv completion, we give it back once copied
+struct BufferRing {
+  io_uring_buf* bufs = nullptr;
+  size_t ringSize = 0;
+  std::vector<char> memory;
+  unsigned short tail = 0;
+  unsigned mask = BUF_COUNT - 1;
+
+  ~BufferRing(){
+    if (bufs) munmap(bufs, ringSize);
+  }
+
+  int init(Ring& ring){
+    ringSize = BUF_COUNT * sizeof(io_uring_buf);
+    void* p = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return -errno;
+    bufs = static_cast<io_uring_buf*>(p);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufs);
+    reg.ring_entries = BUF_COUNT;
+    reg.bgid = BUF_GROUP;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return -errno;
+
+    memory.resize(static_cast<size_t>(BUF_COUNT) * BUF_SIZE);
+    for (unsigned i = 0; i < BUF_COUNT; i++) add(i);
+    publish();
+    return 0;
+  }
+
+  char* data(unsigned bid){ return memory.data() + static_cast<size_t>(bid) * BUF_SIZE; }
+
+  void add(unsigned bid){
+    io_uring_buf& b = bufs[tail & mask];
+    b.addr = reinterpret_cast<uint64_t>(data(bid));
+    b.len = BUF_SIZE;
+    b.bid = bid;
+    tail++;
+  }
+
+  // The ring tail shares its slot with bufs[0].resv
+  void publish(){
+    __atomic_store_n(&bufs[0].resv, tail, __ATOMIC_RELEASE);
+  }
+};
+
+struct Conn {
+  ClientState client;
+  uint32_t gen = 0;
+  bool recvArmed = false;
+  bool closing = false;
+
+  OutputBuffer sending; // bytes owned by the in flight send chain
+  std::vector<iovec> iov;
+  std::vector<msghdr> msgs;
+  int sendsInFlight = 0;
+
+  bool dirty = false; // got input during the current completion batch
+
+  // A blocking command is running on a helper thread and owns `client`, input is parked here
+  bool blocked = false;
+  std::string stash;
+
+  // Deadline of a parked BLPOP, as an absolute io_uring timeout. One per connection,
+  // moved when the client parks again with another deadline
+  bool timerArmed = false;
+  bool timerRemoving = false;
+  std::chrono::steady_clock::time_point timerAt;
+  __kernel_timespec parkTimeout{};
+};
+
+struct Reactor {
+  ServerContext& ctx;
+  Ring ring;
+  BufferRing buffers;
+  int listenFd = -1;
+  int wakeFd = -1;
+  uint64_t wakeValue = 0;
+  uint32_t nextGen = 1;
+  std::vector<std::unique_ptr<Conn>> conns; // indexed by fd
+  std::vector<int> dirty;
+
+  std::mutex unblockedMutex;
+  std::vector<std::pair<int, bool>> unblocked; // fd and whether its blocking command failed
+  std::vector<std::pair<int, uint32_t>> woken; // fd and generation of subscribers with published messages, or unparked clients
+
+  explicit Reactor(ServerContext& c) : ctx(c) {}
+
+  ~Reactor(){
+    if (wakeFd >= 0) close(wakeFd);
+    if (listenFd >= 0) close(listenFd);
+  }
+
+  io_uring_sqe* sqe(){
+    io_uring_sqe* s = ring.get_sqe();
+    if (!s) throw std::runtime_error("io_uring submission queue full");
+    return s;
+  }
+
+  void arm_accept(){
+    io_uring_sqe* s = sqe();
+    s->opcode = IORING_OP_ACCEPT;
+    s->fd = listenFd;
+    s->ioprio = IORING_ACCEPT_MULTISHOT;
+    s->user_data = pack(OP_ACCEPT, 0, listenFd);
+  }
+
+  void arm_recv(int fd, Conn& c){
+    io_uring_sqe* s = sqe();
+    s->opcode = IORING_OP_RECV;
+    s->fd = fd;
+    s->ioprio = IORING_RECV_MULTISHOT;
+    s->flags = IOSQE_BUFFER_SELECT;
+    s->buf_group = BUF_GROUP;
+    s->user_data = pack(OP_RECV, c.gen, fd);
+    c.recvArmed = true;
+  }
+
+  void arm_wake(){
+    io_uring_sqe* s = sqe();
+    s->opcode = IORING_OP_READ;
+    s->fd = wakeFd;
+    s->addr = reinterpret_cast<uint64_t>(&wakeValue);
+    s->len = sizeof(wakeValue);
+    s->user_data = pack(OP_WAKE, 0, wakeFd);
+  }
+
+  // steady_clock is CLOCK_MONOTONIC, which io_uring timeouts count in too
+  void arm_park_timer(int fd, Conn& c){
+    std::chrono::steady_clock::time_point deadline = c.client.parked->deadline;
+    if (deadline == std::chrono::steady_clock::time_point::max()) return;
+    if (c.timerArmed && c.timerAt == deadline) return;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    c.parkTimeout.tv_sec = ns / 1000000000;
+    c.parkTimeout.tv_nsec = ns % 1000000000;
+    io_uring_sqe* s = sqe();
+    if (c.timerArmed){
+      s->opcode = IORING_OP_TIMEOUT_REMOVE;
+      s->addr = pack(OP_TIMER, c.gen, fd);
+      s->addr2 = reinterpret_cast<uint64_t>(&c.parkTimeout);
+      s->timeout_flags = IORING_TIMEOUT_UPDATE | IORING_TIMEOUT_ABS;
+      s->user_data = pack(OP_TIMER_REMOVE, c.gen, fd);
+    } else {
+      s->opcode = IORING_OP_TIMEOUT;
+      s->fd = -1;
+      s->addr = reinterpret_cast<uint64_t>(&c.parkTimeout);
+      s->len = 1;
+      s->timeout_flags = IORING_TIMEOUT_ABS;
+      s->user_data = pack(OP_TIMER, c.gen, fd);
+      c.timerArmed = true;
+    }
+    c.timerAt = deadline;
+  }
+
+  void mark_dirty(int fd, Conn& c){
+    if (c.dirty) return;
+    c.dirty = true;
+    dirty.push_back(fd);
+  }
+
+  // Sends everything in client.out as a chain of linked sendmsg calls (one per IOV_PER_SEND chunks)
+  // so the kernel keeps them in order. Only one chain per connection is in flight,
+  // replies made meanwhile wait in client.out
+  void flush(int fd, Conn& c){
+    if (c.blocked || c.sendsInFlight > 0 || c.closing) return;
+    take_pushed(c.client);
+    if (c.client.out.empty()) return;
+    std::swap(c.sending, c.client.out);
+
+    const std::vector<std::string>& chunks = c.sending.chunks();
+    c.iov.clear();
+    for (const std::string& chunk : chunks){
+      if (!chunk.empty()) c.iov.push_back({const_cast<char*>(chunk.data()), chunk.size()});
+    }
+    c.msgs.assign((c.iov.size() + IOV_PER_SEND - 1) / IOV_PER_SEND, msghdr{});
+    for (size_t i = 0; i < c.msgs.size(); i++){
+      c.msgs[i].msg_iov = c.iov.data() + i * IOV_PER_SEND;
+      c.msgs[i].msg_iovlen = std::min(IOV_PER_SEND, c.iov.size() - i * IOV_PER_SEND);
+
+      io_uring_sqe* s = sqe();
+      s->opcode = IORING_OP_SENDMSG;
+      s->fd = fd;
+      s->addr = reinterpret_cast<uint64_t>(&c.msgs[i]);
+      s->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+      s->user_data = pack(OP_SEND, c.gen, fd);
+      if (i + 1 < c.msgs.size()) s->flags = IOSQE_IO_LINK;
+      c.sendsInFlight++;
+    }
+  }
+
+  void begin_close(int fd, Conn& c){
+    if (!c.closing){
+      c.closing = true;
+      shutdown(fd, SHUT_RDWR); // ends the multishot recv and any send still queued
+    }
+    finish_close(fd, c);
+  }
+
+  // Protocol errors: send what is already in out (the error reply included), then close
+  void close_after_flush(int fd, Conn& c){
+    flush(fd, c);
+    if (!c.closing){
+      c.closing = true;
+      shutdown(fd, SHUT_RD);
+    }
+    finish_close(fd, c);
+  }
+
+  void finish_close(int fd, Conn& c){
+    if (!c.closing) return;
+    if (c.timerArmed && !c.timerRemoving){
+      io_uring_sqe* s = sqe();
+      s->opcode = IORING_OP_TIMEOUT_REMOVE;
+      s->addr = pack(OP_TIMER, c.gen, fd);
+      s->user_data = pack(OP_TIMER_REMOVE, c.gen, fd);
+      c.timerRemoving = true;
+    }
+    if (c.recvArmed || c.sendsInFlight > 0 || c.blocked || c.timerArmed) return;
+    unregister_client(c.client, ctx);
+    close(fd);
+    conns[fd].reset();
+    std::cerr << "client disconnected \n";
+  }
+
+  void run_commands(int fd, Conn& c){
+    ProcessResult result = process_client_buffer(c.client, ctx, false);
+    // A parked BLPOP that was served or timed out finishes here, then the commands behind it run
+    while (result == ProcessResult::Parked && resume_parked(c.client, ctx)){
+      result = process_client_buffer(c.client, ctx, false);
+    }
+    if (result == ProcessResult::Parked) arm_park_timer(fd, c);
+    if (result == ProcessResult::Blocked){
+      // XREAD BLOCK / WAIT sleep until satisfied, give them a thread of their own
+      c.blocked = true;
+      Conn* conn = &c;
+      std::thread([this, conn, fd]{
+        bool failed = false;
+        try {
+          process_client_buffer(conn->client, ctx, true);
+        } catch (const std::exception& e) {
+          failed = true;
+        }
+        {
+          std::lock_guard<std::mutex> lock(unblockedMutex);
+          unblocked.emplace_back(fd, failed);
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+      }).detach();
+    }
+    flush(fd, c);
+  }
+
+  void on_accept(const io_uring_cqe& cqe){
+    if (!(cqe.flags & IORING_CQE_F_MORE)) arm_accept();
+    if (cqe.res < 0) return;
+    int fd = cqe.res;
+    std::cout << "Client connected\n";
+    if (conns.size() <= static_cast<size_t>(fd)) conns.resize(fd + 1);
+    conns[fd] = std::make_unique<Conn>();
+    Conn& c = *conns[fd];
+    c.client.fd = fd;
+    c.gen = nextGen++;
+    c.client.push = std::make_shared<PushQueue>();
+    c.client.unpark = c.client.push->wake = [this, fd, gen = c.gen]{
+      {
+        std::lock_guard<std::mutex> lock(unblockedMutex);
+        woken.emplace_back(fd, gen);
+      }
+      uint64_t one = 1;
+      ssize_t ignored = write(wakeFd, &one, sizeof(one));
+      (void)ignored;
+    };
+    arm_recv(fd, c);
+  }
+
+  Conn* lookup(uint64_t ud){
+    int fd = fd_of(ud);
+    if (fd < 0 || static_cast<size_t>(fd) >= conns.size() || !conns[fd]) return nullptr;
+    Conn* c = conns[fd].get();
+    return (c->gen & 0xFFFFFF) == gen_of(ud) ? c : nullptr;
+  }
+
+  void on_recv(const io_uring_cqe& cqe){
+    int fd = fd_of(cqe.user_data);
+    Conn* c = lookup(cqe.user_data);
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)){
+      unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+      if (c && !c->closing){
+        std::string& dest = c->blocked ? c->stash : c->client.read_buffer;
+        dest.append(buffers.data(bid), cqe.res);
+      }
+      buffers.add(bid);
+      buffers.publish();
+    }
+    if (!c) return;
+    if (!more) c->recvArmed = false;
+
+    if (cqe.res > 0){
+      if (!c->blocked) mark_dirty(fd, *c);
+      if (!more && !c->closing) arm_recv(fd, *c);
+    }
+    else if (cqe.res == -ENOBUFS){
+      // Every provided buffer was in use, they are back in the ring now
+      if (!more && !c->closing) arm_recv(fd, *c);
+    }
+    else {
+      begin_close(fd, *c);
+    }
+  }
+
+  void on_send(const io_uring_cqe& cqe){
+    int fd = fd_of(cqe.user_data);
+    Conn* c = lookup(cqe.user_data);
+    if (!c) return;
+    c->sendsInFlight--;
+    if (cqe.res < 0 && !c->closing){
+      begin_close(fd, *c);
+      return;
+    }
+    if (c->sendsInFlight == 0){
+      c->sending.clear();
+      if (c->closing) finish_close(fd, *c);
+      else flush(fd, *c);
+    }
+  }
+
+  void on_wake(){
+    arm_wake();
+    std::vector<std::pair<int, bool>> ready;
+    std::vector<std::pair<int, uint32_t>> published;
+    {
+      std::lock_guard<std::mutex> lock(unblockedMutex);
+      ready.swap(unblocked);
+      published.swap(woken);
+    }
+    for (auto [fd, gen] : published){
+      if (static_cast<size_t>(fd) >= conns.size() || !conns[fd] || conns[fd]->gen != gen) continue;
+      Conn& c = *conns[fd];
+      if (c.client.parked && !c.blocked && !c.closing) mark_dirty(fd, c); // run_commands resumes it
+      flush(fd, c);
+    }
+    for (auto [fd, failed] : ready){
+      if (static_cast<size_t>(fd) >= conns.size() || !conns[fd]) continue;
+      Conn& c = *conns[fd];
+      c.blocked = false;
+      if (c.closing){
+        begin_close(fd, c);
+        continue;
+      }
+      if (failed){
+        close_after_flush(fd, c);
+        continue;
+      }
+      c.client.read_buffer += c.stash;
+      c.stash.clear();
+      mark_dirty(fd, c);
+    }
+  }
+
+  void on_timer(const io_uring_cqe& cqe){
+    int fd = fd_of(cqe.user_data);
+    Conn* c = lookup(cqe.user_data);
+    if (!c) return;
+    c->timerArmed = false;
+    if (c->closing) finish_close(fd, *c);
+    else if (c->client.parked && !c->blocked) mark_dirty(fd, *c); // timed out, or moved and armed again
+  }
+
+  // Every connection that got input in this batch runs its commands once and queues one send chain
+  void run_dirty(){
+    for (int fd : dirty){
+      if (!conns[fd]) continue;
+      Conn& c = *conns[fd];
+      c.dirty = false;
+      if (c.closing || c.blocked) continue;
+      try {
+        run_commands(fd, c);
+      } catch (const std::exception& e) {
+        close_after_flush(fd, c);
+      }
+    }
+    dirty.clear();
+  }
+
+  void loop(){
+    arm_accept();
+    arm_wake();
+    while (true){
+      // One syscall both submits everything queued by the last batch and waits for more
+      int ret = ring.submit(1);
+      if (ret < 0 && ret != -EBUSY && ret != -EAGAIN){
+        std::cerr << "io_uring_enter failed: " << std::strerror(-ret) << "\n";
+        return;
+      }
+      ring.for_each_cqe([this](const io_uring_cqe& cqe){
+        switch (op_of(cqe.user_data)){
+          case OP_ACCEPT: on_accept(cqe); break;
+          case OP_RECV: on_recv(cqe); break;
+          case OP_SEND: on_send(cqe); break;
+          case OP_WAKE: on_wake(); break;
+          case OP_TIMER: on_timer(cqe); break;
+          case OP_TIMER_REMOVE: break; // the timer's own completion follows
+        }
+      });
+      run_dirty();
+    }
+  }
+};
+
+int open_listener(int port, int backlog){
+  int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    std::cerr << "Failed to create server socket\n";
+    return -1;
+  }
+  int reuse = 1;
+  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+      setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+    std::cerr << "setsockopt failed\n";
+    close(server_fd);
+    return -1;
+  }
+  struct sockaddr_in server_addr{};
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = INADDR_ANY;
+  server_addr.sin_port = htons(port);
+  if (bind(server_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) != 0) {
+    std::cerr << "Failed to bind to port "<< port <<"\n";
+    close(server_fd);
+    return -1;
+  }
+  if (listen(server_fd, backlog) != 0) {
+    std::cerr << "listen failed\n";
+    close(server_fd);
+    return -1;
+  }
+  return server_fd;
+}
+
+// Multishot recv and SINGLE_ISSUER both arrived in 6.0, provided buffer rings in 5.19
+const unsigned RING_FLAGS = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+
+}
+
+bool uring_supported(){
+  Ring ring;
+  if (ring.init(8, RING_FLAGS) < 0) return false;
+  BufferRing probe;
+  return probe.init(ring) == 0;
+}
+
+int run_uring_server(ServerContext& ctx){
+  int port = std::stoi(ctx.config.port);
+  int reactors = std::max(1, std::stoi(ctx.config.ioThreads));
+  int backlog = std::stoi(ctx.config.tcpBacklog);
+
+  std::vector<std::unique_ptr<Reactor>> loops;
+  for (int i = 0; i < reactors; i++){
+    loops.push_back(std::make_unique<Reactor>(ctx));
+    Reactor& r = *loops.back();
+    r.listenFd = open_listener(port, backlog);
+    if (r.listenFd < 0) return 1;
+    r.wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (r.wakeFd < 0) {
+      std::cerr << "eventfd failed\n";
+      return 1;
+    }
+  }
+  std::cout << "Waiting for a client to connect...\n";
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (int i = 0; i < reactors; i++){
+    auto run = [&loops, i, cores]{
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % cores, &cpus);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      // SINGLE_ISSUER ties the ring to the thread that creates it
+      Reactor& r = *loops[i];
+      if (r.ring.init(RING_ENTRIES, RING_FLAGS) < 0 || r.buffers.init(r.ring) < 0){
+        std::cerr << "io_uring setup failed\n";
+        return;
+      }
+      r.loop();
+    };
+    if (i == reactors - 1) run(); // last reactor runs on the main thread
+    else threads.emplace_back(run);
+  }
+  for (auto& t : threads) t.join();
+  return 0;
+}
+
+#else
+
+bool uring_supported(){
+  return false;
+}
+
+int run_uring_server(ServerContext& ctx){
+  std::cerr << "built without io_uring support\n";
+  return 1;
+}
+
+#endif
@@ -0,0 +1,107 @@
+// Master and replica must end up with the same data, including for commands that don't
+// replay the same on their own: XADD * (the replica would pick its own IDs), relative
+// expiries (counted from when the replica got them) and INCRBYFLOAT. Writes that fail
+// or change nothing must not reach the replica either. Given the replica's pid, it also
+// stops the replica while the master streams 30 MB at it, so the master's sends to it
+// come back short: none of that may be lost.
+//
+//   g++ -std=c++20 -O2 -Itests tests/replicationTest.cpp -o replicationTest
+//   ./your_program.sh --port 6379 --io-backend asio &
+//   ./your_program.sh --port 6380 --replicaof "localhost 6379" &
+//   ./replicationTest 6379 6380 $!
+#include "respClient.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what){
+  if (!ok){
+    std::printf("FAIL %s\n", what.c_str());
+    failures++;
+  }
+}
+
+// Replicas are fed asynchronously: poll until the replica's reply matches the master's
+static bool converges(RespClient& master, RespClient& replica, const std::vector<std::string>& argv){
+  std::string expected = master.call(argv);
+  for (int tries = 0; tries < 200; tries++){
+    if (replica.call(argv) == expected) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+// The key's deadline, to the millisecond, is the same on both
+static void check_deadline(RespClient& master, RespClient& replica, const std::string& key){
+  std::string deadline = master.call({"PEXPIRETIME", key});
+  check(!deadline.empty() && deadline[0] == ':' && RespClient::integer(deadline) > 0, key + " has a deadline: " + deadline);
+  check(replica.call({"PEXPIRETIME", key}) == deadline, key + " expires at the same time on both");
+}
+
+int main(int argc, char** argv){
+  if (argc < 3){
+    std::fprintf(stderr, "usage: %s master-port replica-port [replica-pid]\n", argv[0]);
+    return 1;
+  }
+  RespClient master(std::atoi(argv[1]));
+  RespClient replica(std::atoi(argv[2]));
+  std::string suffix = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+  std::string stream = "stream:" + suffix, text = "text:" + suffix, number = "number:" + suffix;
+
+  // 5000 pipelined XADD *: the clock rarely moves between them, so most IDs only differ
+  // in their sequence, which the replica would number on its own clock
+  for (int i = 0; i < 5000; i++) master.send({"XADD", stream, "*", "f", std::to_string(i)});
+  for (int i = 0; i < 5000; i++) master.read();
+  check(converges(master, replica, {"XRANGE", stream, "-", "+"}), "XRANGE matches after 5000 XADD *");
+
+  master.call({"SET", text, "hello", "PX", "600000"});
+  master.call({"EXPIRE", stream, "1000"});
+  master.call({"SET", number, "1.5", "EX", "2000"});
+  master.call({"INCRBYFLOAT", number, "0.1"});
+  check(converges(master, replica, {"GET", number}), "INCRBYFLOAT result matches");
+  check(converges(master, replica, {"GET", text}), "SET PX value matches");
+  check_deadline(master, replica, text);
+  check_deadline(master, replica, stream);
+  check_deadline(master, replica, number); // INCRBYFLOAT kept the ttl on both
+
+  // Neither of these may reach the replica: the replica's own copy must stay as it is
+  replica.call({"SET", "replicaOnly:" + suffix, "kept"}); // writes on the replica aren't refused here
+  master.call({"XADD", stream, "1-1", "f", "v"});         // ID too small, an error
+  master.call({"EXPIRE", "replicaOnly:" + suffix, "0"});  // missing on the master, changes nothing
+  master.call({"SET", text, "last"});
+  check(converges(master, replica, {"GET", text}), "replica caught up");
+  check(replica.call({"GET", "replicaOnly:" + suffix}) == "$4\r\nkept\r\n", "no-op EXPIRE not propagated");
+  check(converges(master, replica, {"XRANGE", stream, "-", "+"}), "failed XADD not propagated");
+
+  if (argc > 3){
+    // The master blocks on the stopped replica and stops reading us in turn, so it is
+    // let go from another thread
+    pid_t pid = std::atoi(argv[3]);
+    std::string big(10000, 'x'), lag = "lag:" + suffix + ":";
+    kill(pid, SIGSTOP);
+    std::thread resume([pid]{
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      kill(pid, SIGCONT);
+    });
+    for (int i = 0; i < 3000; i++) master.send({"SET", lag + std::to_string(i), big + std::to_string(i)});
+    for (int i = 0; i < 3000; i++) master.read();
+    resume.join();
+    master.call({"SET", lag + "after", "1"});
+    check(converges(master, replica, {"GET", lag + "after"}), "replica still replicating after lagging");
+    int lost = 0;
+    for (int i = 0; i < 3000; i++){
+      if (replica.call({"GET", lag + std::to_string(i)}) != master.call({"GET", lag + std::to_string(i)})) lost++;
+    }
+    check(lost == 0, std::to_string(lost) + " of 3000 SETs lost while the replica lagged");
+  }
+
+  if (failures) return 1;
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Blocking RESP client for the tests in this directory: pipelines commands and reads
+// replies back as their raw RESP bytes, so replies from two servers compare exactly.
+#ifndef RESP_CLIENT_H
+#define RESP_CLIENT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class RespClient {
+public:
+  explicit RespClient(int port){
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+      throw std::runtime_error("can't connect to port " + std::to_string(port));
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  RespClient(const RespClient&) = delete;
+  RespClient& operator=(const RespClient&) = delete;
+  ~RespClient(){ close(fd); }
+
+  // Queues a command, sent with the next read
+  void send(const std::vector<std::string>& argv){
+    out += "*" + std::to_string(argv.size()) + "\r\n";
+    for (const std::string& arg : argv) out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+  }
+
+  // The next reply, whole
+  std::string read(){
+    flush();
+    size_t end;
+    while (!reply_end(0, end)) fill();
+    std::string reply = in.substr(0, end);
+    in.erase(0, end);
+    return reply;
+  }
+
+  std::string call(const std::vector<std::string>& argv){
+    send(argv);
+    return read();
+  }
+
+  // The value of an integer reply (":12\r\n")
+  static int64_t integer(const std::string& reply){
+    if (reply.empty() || reply[0] != ':') throw std::runtime_error("not an integer reply: " + reply);
+    return std::strtoll(reply.c_str() + 1, nullptr, 10);
+  }
+
+private:
+  void flush(){
+    for (size_t sent = 0; sent < out.size();){
+      ssize_t n = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) throw std::runtime_error("send failed");
+      sent += n;
+    }
+    out.clear();
+  }
+
+  void fill(){
+    char buf[16384];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) throw std::runtime_error("connection closed");
+    in.append(buf, n);
+  }
+
+  // Whether in holds a whole reply starting at at, end is past it
+  bool reply_end(size_t at, size_t& end) const {
+    size_t line = in.find("\r\n", at);
+    if (line == std::string::npos) return false;
+    char type = in[at];
+    long long n = std::strtoll(in.c_str() + at + 1, nullptr, 10);
+    end = line + 2;
+    if (type == '$' && n >= 0){
+      end += n + 2;
+      return end <= in.size();
+    }
+    if (type == '*'){
+      for (long long i = 0; i < n; i++){
+        if (!reply_end(end, end)) return false;
+      }
+    }
+    return true;
+  }
+
+  int fd;
+  std::string out;
+  std::string in;
+};
+
+#endif
@@ -0,0 +1,130 @@
+// Many clients hammering one server with a mix of reads, writes and multi-key commands,
+// meant to run against a ThreadSanitizer build. Next to the workers, one client loops on
+// BLPOP, one on XREAD BLOCK and one stays subscribed. At the end the counters must add
+// up, and no MGET may ever have seen a MULTI/EXEC half applied.
+//
+//   g++ -std=c++23 -O1 -g -fsanitize=thread -Iinclude src/*.cpp -o server-tsan -pthread
+//   g++ -std=c++20 -O2 -Itests tests/stressTest.cpp -o stressTest -pthread
+//   TSAN_OPTIONS=detect_deadlocks=0 ./server-tsan --port 6379 --io-backend threads &
+//   ./stressTest 6379 8 20000
+//
+// Repeat with --io-backend asio --io-threads 2, --io-backend uring --io-threads 2 and
+// --shards 2. KEYS and INFO lock all 64 stripes at once, more locks than TSan's deadlock
+// detector tracks per thread (it aborts on an internal CHECK), hence detect_deadlocks=0.
+#include "respClient.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<bool> stop{false};
+static std::atomic<int> failures{0};
+static std::atomic<int64_t> incrs{0};
+static std::atomic<int64_t> execs{0};
+static std::atomic<int64_t> pushed{0};
+static std::atomic<int64_t> popped{0};
+
+static void fail(const std::string& what){
+  if (failures.fetch_add(1) < 10) std::printf("FAIL %s\n", what.c_str());
+}
+
+static void worker(int port, int id, int ops){
+  RespClient client(port);
+  std::mt19937 rng(id);
+  std::string own = "own:" + std::to_string(id);
+  for (int i = 0; i < ops; i++){
+    std::string key = "k:" + std::to_string(rng() % 1000);
+    switch (rng() % 16){
+      case 0: client.call({"SET", key, std::to_string(i)}); break;
+      case 1: client.call({"GET", key}); break;
+      case 2: client.call({"INCR", "counter"}); incrs++; break;
+      case 3: {
+        client.call({"MULTI"});
+        client.call({"INCR", "pair:a"});
+        client.call({"INCR", "pair:b"});
+        std::string reply = client.call({"EXEC"});
+        if (reply.compare(0, 4, "*2\r\n") != 0) fail("EXEC: " + reply);
+        execs++;
+        break;
+      }
+      case 4: {
+        // EXEC holds the stripes of both keys while it runs, so they only ever move together
+        std::string reply = client.call({"MGET", "pair:a", "pair:b"});
+        std::string values = reply.substr(4); // "$n\r\na\r\n$n\r\nb\r\n", the halves must match
+        if (values.substr(0, values.size() / 2) != values.substr(values.size() / 2)) fail("MGET saw half an EXEC: " + reply);
+        break;
+      }
+      case 5: client.call({"RPUSH", "list:" + own, std::to_string(i)}); break;
+      case 6: client.call({"LPOP", "list:" + own}); break;
+      case 7: client.call({"ZADD", "zset", std::to_string(rng() % 100), key}); break;
+      case 8: client.call({"ZRANGE", "zset", "0", "10"}); break;
+      case 9: client.call({"XADD", "stream", "*", "worker", std::to_string(id)}); break;
+      case 10: client.call({"XRANGE", "stream", "-", "+", "COUNT", "10"}); break;
+      case 11: if (rng() % 50 == 0) client.call({"KEYS", "k:1*"}); break;
+      case 12: client.call({"PUBLISH", "news", std::to_string(i)}); break;
+      case 13: client.call({"RPUSH", "blocking", std::to_string(i)}); pushed++; break;
+      case 14: client.call({"EXPIRE", key, "100"}); break;
+      case 15: if (rng() % 50 == 0) client.call({"INFO"}); break;
+    }
+  }
+}
+
+static void blocking_popper(int port){
+  RespClient client(port);
+  while (!stop){
+    std::string reply = client.call({"BLPOP", "blocking", "0.05"});
+    if (reply[0] == '*' && reply != "*-1\r\n") popped++;
+  }
+  // Whatever the workers pushed after the last wait
+  while (client.call({"LPOP", "blocking"}) != "$-1\r\n") popped++;
+}
+
+static void stream_reader(int port){
+  RespClient client(port);
+  while (!stop) client.call({"XREAD", "COUNT", "5", "BLOCK", "50", "STREAMS", "stream", "$"});
+}
+
+static void subscriber(int port){
+  RespClient client(port);
+  client.call({"SUBSCRIBE", "news"});
+  while (client.read().find("done") == std::string::npos){}
+}
+
+int main(int argc, char** argv){
+  if (argc < 2){
+    std::fprintf(stderr, "usage: %s port [clients] [ops per client]\n", argv[0]);
+    return 1;
+  }
+  int port = std::atoi(argv[1]);
+  int clients = argc > 2 ? std::atoi(argv[2]) : 8;
+  int ops = argc > 3 ? std::atoi(argv[3]) : 20000;
+
+  RespClient control(port);
+  for (const char* key : {"blocking", "stream", "zset"}) control.call({"PEXPIRE", key, "0"}); // left by an earlier run
+  for (const char* key : {"counter", "pair:a", "pair:b"}) control.call({"SET", key, "0"});
+
+  std::thread popper(blocking_popper, port), reader(stream_reader, port), sub(subscriber, port);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // let the subscriber in
+  std::vector<std::thread> workers;
+  for (int i = 0; i < clients; i++) workers.emplace_back(worker, port, i, ops);
+  for (std::thread& t : workers) t.join();
+  stop = true;
+  control.call({"PUBLISH", "news", "done"});
+  popper.join();
+  reader.join();
+  sub.join();
+
+  auto value = [&](const std::string& key){ return control.call({"GET", key}); };
+  auto bulk = [](int64_t n){ std::string s = std::to_string(n); return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n"; };
+  if (value("counter") != bulk(incrs)) fail("counter is " + value("counter") + " after " + std::to_string(incrs) + " INCRs");
+  if (value("pair:a") != bulk(execs) || value("pair:b") != bulk(execs)) fail("pair after " + std::to_string(execs) + " EXECs");
+  if (pushed != popped) fail(std::to_string(pushed) + " pushed but " + std::to_string(popped) + " popped");
+
+  std::printf("%d clients x %d ops: %lld INCR, %lld EXEC, %lld BLPOP'd, %d failures\n", clients, ops,
+              (long long)incrs, (long long)execs, (long long)popped, failures.load());
+  return failures ? 1 : 0;
+}